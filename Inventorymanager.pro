@@ -7,7 +7,7 @@
 ######################################################################
 
 # Módulos de Qt requeridos
-QT += core gui widgets sql
+QT += core gui widgets sql concurrent network
 
 # Para compatibilidad con Qt5
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
@@ -35,9 +35,21 @@ UI_DIR = $$DESTDIR/.ui
 SOURCES += \
     src/main.cpp \
     src/mainwindow.cpp \
+    src/changefeed.cpp \
+    src/commandjournal.cpp \
     src/component.cpp \
+    src/componentsnapshot.cpp \
     src/databasemanager.cpp \
-    src/inventory_manager.cpp
+    src/httploadgen.cpp \
+    src/httpservice.cpp \
+    src/inventory_manager.cpp \
+    src/maintenancescheduler.cpp \
+    src/lowstockaggregator.cpp \
+    src/reorderforecaster.cpp \
+    src/reservationmanager.cpp \
+    src/tracerecorder.cpp \
+    src/tracereplayer.cpp \
+    src/trigramindex.cpp
 
 ######################################################################
 # ARCHIVOS DE CABECERA (.h)
@@ -45,9 +57,21 @@ SOURCES += \
 
 HEADERS += \
     src/mainwindow.h \
+    src/changefeed.h \
+    src/commandjournal.h \
     src/component.h \
+    src/componentsnapshot.h \
     src/databasemanager.h \
-    src/inventory_manager.h
+    src/httploadgen.h \
+    src/httpservice.h \
+    src/inventory_manager.h \
+    src/maintenancescheduler.h \
+    src/lowstockaggregator.h \
+    src/reorderforecaster.h \
+    src/reservationmanager.h \
+    src/tracerecorder.h \
+    src/tracereplayer.h \
+    src/trigramindex.h
 
 ######################################################################
 # ARCHIVOS DE INTERFAZ (.ui)
@@ -0,0 +1,258 @@
+#include "changefeed.h"
+#include <QJsonDocument>
+#include <QDebug>
+
+ChangeFeedServer::ChangeFeedServer(DatabaseManager* dbManager, QObject* parent)
+    : QObject(parent), dbManager(dbManager), dbPath(dbManager->getDatabasePath()), exportCursor(0) {
+    
+    connect(&server, &QLocalServer::newConnection,
+            this, &ChangeFeedServer::onNewConnection);
+    connect(dbManager, &DatabaseManager::changesAvailable,
+            this, &ChangeFeedServer::onChangesAvailable);
+    
+    pruneTimer.setInterval(60 * 60 * 1000);
+    connect(&pruneTimer, &QTimer::timeout, this, &ChangeFeedServer::prune);
+    pruneTimer.start();
+}
+
+ChangeFeedServer::~ChangeFeedServer() {
+    server.close();
+}
+
+bool ChangeFeedServer::listen(const QString& name) {
+    // Un socket huérfano de una ejecución anterior impediría escuchar, pero si
+    // responde es otra instancia en marcha (p. ej. la GUI durante un --replay)
+    if (!server.listen(name) && server.serverError() == QAbstractSocket::AddressInUseError) {
+        QLocalSocket probe;
+        probe.connectToServer(name);
+        if (probe.waitForConnected(100)) {
+            qWarning() << "Otra instancia ya publica el registro de cambios en" << name;
+            return false;
+        }
+        QLocalServer::removeServer(name);
+        server.listen(name);
+    }
+    if (!server.isListening()) {
+        qWarning() << "No se pudo publicar el registro de cambios:" << server.errorString();
+        return false;
+    }
+    qDebug() << "Registro de cambios publicado en" << server.fullServerName();
+    return true;
+}
+
+bool ChangeFeedServer::setExportFile(const QString& path) {
+    exportFile.close();
+    exportFile.setFileName(path);
+    exportCursor = 0;
+    
+    // Reanudar desde el último seq escrito para no duplicar entradas
+    if (exportFile.exists() && exportFile.open(QIODevice::ReadWrite)) {
+        exportCursor = resumeExport();
+        exportFile.close();
+    }
+    
+    if (!exportFile.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        qWarning() << "No se pudo abrir el archivo de cambios:" << exportFile.errorString();
+        return false;
+    }
+    
+    onChangesAvailable(0);
+    return true;
+}
+
+qint64 ChangeFeedServer::resumeExport() {
+    // Desde el final hacia atrás: la última línea completa da el seq. Lo que sigue
+    // al último salto de línea es una escritura cortada; se recorta para no pegarle
+    // la siguiente línea ni reexportar todo desde 0
+    const qint64 size = exportFile.size();
+    QByteArray tail;                // Bytes desde tailStart hasta el final
+    qint64 tailStart = size;
+    auto readBack = [this, &tail, &tailStart]() {
+        const qint64 chunk = qMin<qint64>(tailStart, 4096);
+        if (chunk == 0) {
+            return false;
+        }
+        tailStart -= chunk;
+        exportFile.seek(tailStart);
+        tail.prepend(exportFile.read(chunk));
+        return true;
+    };
+    
+    qint64 complete = -1;           // Longitud con solo líneas completas
+    qint64 lineEnd = size;          // Fin (exclusivo) de la línea que se examina
+    qint64 seq = 0;
+    forever {
+        // Salto de línea anterior a lineEnd, o -1 si la línea empieza el archivo
+        qint64 newline = -1;
+        forever {
+            const int index = lineEnd > tailStart
+                ? tail.lastIndexOf('\n', int(lineEnd - tailStart - 1)) : -1;
+            if (index >= 0) {
+                newline = tailStart + index;
+                break;
+            }
+            if (!readBack()) {
+                break;
+            }
+        }
+        
+        if (complete < 0) {
+            complete = newline + 1;
+        } else {
+            const QByteArray line = tail.mid(int(newline + 1 - tailStart),
+                                             int(lineEnd - newline - 1));
+            seq = QJsonDocument::fromJson(line).object().value("seq").toVariant().toLongLong();
+        }
+        if (seq > 0 || newline < 0) {
+            break;
+        }
+        lineEnd = newline;
+    }
+    
+    if (complete < size) {
+        qWarning() << "Se descarta una línea incompleta al final del archivo de cambios";
+        exportFile.resize(complete);
+    }
+    return seq;
+}
+
+QByteArray ChangeFeedServer::toJsonLine(const ChangeEvent& change) {
+    QJsonObject json;
+    json["seq"] = change.seq;
+    json["op"] = change.op;
+    json["componentId"] = change.componentId;
+    json["site"] = change.site;
+    if (!change.delta.isNull()) {
+        json["delta"] = change.delta.toInt();
+    }
+    json["data"] = change.payload;
+    json["timestamp"] = change.timestamp.toString(Qt::ISODateWithMs);
+    return QJsonDocument(json).toJson(QJsonDocument::Compact) + '\n';
+}
+
+void ChangeFeedServer::onNewConnection() {
+    while (QLocalSocket* socket = server.nextPendingConnection()) {
+        subscribers.insert(socket, Subscriber());
+        
+        connect(socket, &QLocalSocket::readyRead, this, [this, socket]() {
+            readCursor(socket);
+        });
+        connect(socket, &QLocalSocket::bytesWritten, this, [this, socket]() {
+            sendPending(socket);
+        });
+        connect(socket, &QLocalSocket::disconnected, this, [this, socket]() {
+            subscribers.remove(socket);
+            socket->deleteLater();
+        });
+    }
+}
+
+void ChangeFeedServer::readCursor(QLocalSocket* socket) {
+    auto it = subscribers.find(socket);
+    if (it == subscribers.end()) {
+        return;
+    }
+    
+    // Primera línea: cursor inicial; las siguientes confirman lo procesado
+    it->buffer += socket->readAll();
+    int newline;
+    while ((newline = it->buffer.indexOf('\n')) >= 0) {
+        bool ok = false;
+        const qint64 seq = it->buffer.left(newline).trimmed().toLongLong(&ok);
+        it->buffer.remove(0, newline + 1);
+        if (it->cursor < 0) {
+            it->cursor = ok && seq >= 0 ? seq : 0;
+            it->acked = it->cursor;
+            sendPending(socket);
+        } else if (ok) {
+            // Nunca más allá de lo enviado
+            it->acked = qMax(it->acked, qMin(seq, it->cursor));
+        }
+    }
+    if (it->buffer.size() > 64) {
+        it->buffer.clear();   // Sin salto de línea: no es un cursor
+    }
+}
+
+void ChangeFeedServer::sendPending(QLocalSocket* socket) {
+    auto it = subscribers.find(socket);
+    if (it == subscribers.end() || it->cursor < 0) {
+        return;
+    }
+    
+    // Contrapresión: no leer más del registro mientras el cliente no consuma
+    if (socket->bytesToWrite() > 4 * 1024 * 1024) {
+        return;
+    }
+    
+    QVector<ChangeEvent> changes = readChanges(it->cursor);
+    if (changes.isEmpty()) {
+        return;
+    }
+    
+    QByteArray out;
+    for (const ChangeEvent& change : changes) {
+        out += toJsonLine(change);
+    }
+    it->cursor = changes.last().seq;
+    socket->write(out);   // bytesWritten vuelve a llamar hasta vaciar el atraso
+}
+
+void ChangeFeedServer::onChangesAvailable(qint64 lastSeq) {
+    Q_UNUSED(lastSeq);
+    
+    if (exportFile.isOpen()) {
+        QVector<ChangeEvent> changes;
+        do {
+            changes = readChanges(exportCursor);
+            for (const ChangeEvent& change : changes) {
+                exportFile.write(toJsonLine(change));
+                exportCursor = change.seq;
+            }
+        } while (changes.size() >= kBatchSize);
+        exportFile.flush();
+    }
+    
+    const QList<QLocalSocket*> sockets = subscribers.keys();
+    for (QLocalSocket* socket : sockets) {
+        sendPending(socket);
+    }
+}
+
+QVector<ChangeEvent> ChangeFeedServer::readChanges(qint64 cursor) {
+    // Conexión propia del hilo: la principal podría estar dentro de una
+    // transacción y ver cambios que aún pueden deshacerse
+    QSqlDatabase conn = DatabaseManager::connectionForThread(dbPath);
+    // El último seq se lee antes: si después no queda ninguna entrada, es que se depuraron
+    const qint64 lastSeq = DatabaseManager::readLastChangeSeq(conn);
+    QVector<ChangeEvent> changes = DatabaseManager::readChangesSince(conn, cursor, kBatchSize);
+    
+    // Un cursor por debajo de la primera entrada que queda: avisar del hueco
+    const qint64 next = changes.isEmpty() ? lastSeq + 1 : changes.first().seq;
+    if (next > cursor + 1) {
+        ChangeEvent gap;
+        gap.seq = next - 1;
+        gap.op = "gap";
+        gap.payload = QJsonObject{{"from", cursor + 1}, {"to", next - 1}, {"resync", true}};
+        gap.timestamp = QDateTime::currentDateTimeUtc();
+        changes.prepend(gap);
+    }
+    return changes;
+}
+
+void ChangeFeedServer::prune() {
+    // Lo que no confirmó un consumidor desconectado puede depurarse; al volver con
+    // ese cursor, readChanges le envía la línea "gap" antes de lo que queda
+    qint64 upTo = exportFile.isOpen() ? exportCursor : dbManager->getLastChangeSeq();
+    for (const Subscriber& subscriber : qAsConst(subscribers)) {
+        if (subscriber.acked >= 0) {
+            upTo = qMin(upTo, subscriber.acked);
+        }
+    }
+    if (upTo <= 0) {
+        return;
+    }
+    
+    // Los consumidores desconectados tienen kRetentionDays para volver
+    dbManager->pruneChanges(upTo, QDateTime::currentDateTimeUtc().addDays(-kRetentionDays));
+}
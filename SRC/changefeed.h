@@ -0,0 +1,73 @@
+#ifndef CHANGEFEED_H
+#define CHANGEFEED_H
+
+#include <QObject>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QFile>
+#include <QHash>
+#include <QTimer>
+#include "databasemanager.h"
+
+/**
+ * Publica el registro de cambios de DatabaseManager a consumidores externos.
+ *
+ * Socket local: el cliente envía su cursor ("<seq>\n") y recibe una línea JSON
+ * por cambio con seq mayor; después sigue suscrito y recibe los nuevos. Cada
+ * nueva línea "<seq>\n" confirma lo ya procesado.
+ * Archivo: opcionalmente se añade cada cambio como línea JSON a un archivo,
+ * que puede seguirse con tail desde el último seq leído.
+ *
+ * Si las entradas tras el cursor ya se depuraron, antes de las siguientes llega
+ * una línea {"seq": N, "op": "gap", "data": {"from", "to", "resync": true}}: se
+ * perdieron los cambios from..to y el consumidor debe resincronizarse completo.
+ *
+ * Las lecturas usan una conexión propia (solo ven cambios confirmados). Cada
+ * hora se depuran las entradas de más de kRetentionDays días que ya confirmaron
+ * todos los suscriptores conectados y el archivo.
+ */
+class ChangeFeedServer : public QObject {
+    Q_OBJECT
+
+public:
+    explicit ChangeFeedServer(DatabaseManager* dbManager, QObject* parent = nullptr);
+    ~ChangeFeedServer();
+    
+    bool listen(const QString& name = "inventory-changes");
+    bool setExportFile(const QString& path);
+    
+    static QByteArray toJsonLine(const ChangeEvent& change);
+
+public slots:
+    /// Depura lo que ya no necesita ningún consumidor (ver kRetentionDays)
+    void prune();
+
+private slots:
+    void onNewConnection();
+    void onChangesAvailable(qint64 lastSeq);
+
+private:
+    struct Subscriber {
+        qint64 cursor = -1;      ///< Último enviado; -1 hasta recibir el cursor inicial
+        qint64 acked = -1;       ///< Último confirmado por el cliente
+        QByteArray buffer;
+    };
+    
+    void readCursor(QLocalSocket* socket);
+    void sendPending(QLocalSocket* socket);
+    QVector<ChangeEvent> readChanges(qint64 cursor);
+    qint64 resumeExport();
+    
+    static const int kBatchSize = 500;
+    static const int kRetentionDays = 7;
+    
+    DatabaseManager* dbManager;
+    QString dbPath;
+    QTimer pruneTimer;
+    QLocalServer server;
+    QHash<QLocalSocket*, Subscriber> subscribers;
+    QFile exportFile;
+    qint64 exportCursor;
+};
+
+#endif // CHANGEFEED_H
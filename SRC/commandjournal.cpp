@@ -0,0 +1,148 @@
+#include "commandjournal.h"
+
+namespace {
+InventoryCommand withChange(InventoryCommand::Kind kind, int id,
+                            const Component& before, const Component& after) {
+    InventoryCommand command;
+    command.kind = kind;
+    command.componentId = id;
+    command.change = std::make_shared<const ComponentChange>(ComponentChange{before, after});
+    return command;
+}
+}
+
+InventoryCommand InventoryCommand::added(const Component& after) {
+    return withChange(Add, after.getId(), Component(), after);
+}
+
+InventoryCommand InventoryCommand::updated(const Component& before, const Component& after) {
+    InventoryCommand command = withChange(Update, after.getId(), before, after);
+    command.delta = after.getQuantity() - before.getQuantity();
+    return command;
+}
+
+InventoryCommand InventoryCommand::removed(const Component& before) {
+    return withChange(Remove, before.getId(), before, Component());
+}
+
+InventoryCommand InventoryCommand::adjusted(int id, int delta, const QString& site) {
+    InventoryCommand command;
+    command.kind = Adjust;
+    command.componentId = id;
+    command.delta = delta;
+    command.site = site;
+    return command;
+}
+
+const Component& InventoryCommand::before() const {
+    static const Component none;
+    if (!change) {
+        return none;
+    }
+    return inverted ? change->after : change->before;
+}
+
+const Component& InventoryCommand::after() const {
+    static const Component none;
+    if (!change) {
+        return none;
+    }
+    return inverted ? change->before : change->after;
+}
+
+QVector<LotShift> InventoryCommand::lotShifts() const {
+    if (!lots) {
+        return QVector<LotShift>();
+    }
+    QVector<LotShift> shifts = *lots;
+    if (inverted) {
+        for (LotShift& shift : shifts) {
+            shift.units = -shift.units;
+        }
+    }
+    return shifts;
+}
+
+void InventoryCommand::setLotShifts(const QVector<LotShift>& shifts) {
+    lots = shifts.isEmpty() ? nullptr : std::make_shared<const QVector<LotShift>>(shifts);
+}
+
+CommandJournal::CommandJournal(int maxEntries)
+    : batchDepth(0), maxEntries(maxEntries) {
+}
+
+void CommandJournal::record(const InventoryCommand& command) {
+    if (batchDepth > 0) {
+        batch.commands.append(command);
+        return;
+    }
+    
+    JournalEntry entry;
+    entry.label = describe(command);
+    entry.commands.append(command);
+    push(entry);
+}
+
+void CommandJournal::beginBatch(const QString& label) {
+    if (batchDepth++ == 0) {
+        batch.label = label;
+        batch.commands.clear();
+    }
+}
+
+void CommandJournal::endBatch() {
+    if (batchDepth == 0 || --batchDepth > 0) {
+        return;
+    }
+    if (!batch.commands.isEmpty()) {
+        push(batch);
+    }
+    batch = JournalEntry();
+}
+
+void CommandJournal::push(const JournalEntry& entry) {
+    // Una operación nueva invalida lo que se podía rehacer
+    redoStack.clear();
+    pushUndo(entry);
+}
+
+JournalEntry CommandJournal::takeUndo() {
+    return undoStack.isEmpty() ? JournalEntry() : undoStack.takeLast();
+}
+
+JournalEntry CommandJournal::takeRedo() {
+    return redoStack.isEmpty() ? JournalEntry() : redoStack.takeLast();
+}
+
+void CommandJournal::pushUndo(const JournalEntry& entry) {
+    undoStack.append(entry);
+    if (undoStack.size() > maxEntries) {
+        undoStack.removeFirst();
+    }
+}
+
+void CommandJournal::pushRedo(const JournalEntry& entry) {
+    redoStack.append(entry);
+}
+
+void CommandJournal::clear() {
+    undoStack.clear();
+    redoStack.clear();
+    batch = JournalEntry();
+    batchDepth = 0;
+}
+
+QString CommandJournal::describe(const InventoryCommand& command) {
+    switch (command.kind) {
+    case InventoryCommand::Add:
+        return "Agregar " + command.after().getName();
+    case InventoryCommand::Update:
+        return "Editar " + command.after().getName();
+    case InventoryCommand::Remove:
+        return "Eliminar " + command.before().getName();
+    case InventoryCommand::Adjust:
+        return QString("Ajustar cantidad (%1%2)")
+                .arg(command.delta > 0 ? "+" : "").arg(command.delta);
+    }
+    return QString();
+}
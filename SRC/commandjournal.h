@@ -0,0 +1,99 @@
+#ifndef COMMANDJOURNAL_H
+#define COMMANDJOURNAL_H
+
+#include <QString>
+#include <QVector>
+#include <memory>
+#include "component.h"
+#include "databasemanager.h"
+
+/// Componentes de un alta, edición o baja (los QString se comparten, copia barata)
+struct ComponentChange {
+    Component before;   ///< Update/Remove
+    Component after;    ///< Add/Update
+};
+
+/**
+ * Operación registrada en el diario, con el estado necesario para invertirla.
+ * Un Adjust solo guarda ID, delta y sede; los componentes de las demás
+ * operaciones van en un ComponentChange compartido que el inverso no copia.
+ * Los lotes tocados en la sede principal se guardan igual, compartidos.
+ */
+struct InventoryCommand {
+    enum Kind : quint8 {
+        Add,
+        Update,
+        Remove,
+        Adjust
+    };
+    
+    Kind kind = Adjust;
+    bool inverted = false;  ///< Inverso al deshacer: before y after intercambiados
+    int componentId = -1;
+    int delta = 0;          ///< Variación de cantidad (Adjust y Update)
+    QString site;           ///< Solo Adjust; vacío = sede principal
+    std::shared_ptr<const ComponentChange> change;   ///< nullptr en Adjust
+    std::shared_ptr<const QVector<LotShift>> lots;    ///< nullptr: sin lotes (o FIFO)
+    
+    static InventoryCommand added(const Component& after);
+    static InventoryCommand updated(const Component& before, const Component& after);
+    static InventoryCommand removed(const Component& before);
+    static InventoryCommand adjusted(int id, int delta, const QString& site = QString());
+    
+    const Component& before() const;
+    const Component& after() const;
+    
+    /// Movimientos de lotes en el sentido del comando (invertidos al deshacer)
+    QVector<LotShift> lotShifts() const;
+    void setLotShifts(const QVector<LotShift>& shifts);
+};
+
+/// Grupo de comandos que se deshace/rehace como una unidad (una transacción)
+struct JournalEntry {
+    QString label;
+    QVector<InventoryCommand> commands;
+};
+
+/**
+ * Pilas de deshacer/rehacer. Solo guarda y entrega entradas; la aplicación
+ * de los comandos e inversos la hace InventoryManager dentro de una
+ * transacción de DatabaseManager.
+ */
+class CommandJournal {
+public:
+    explicit CommandJournal(int maxEntries = 100);
+    
+    void record(const InventoryCommand& command);
+    
+    /// Agrupa los comandos registrados hasta endBatch() en una sola entrada
+    void beginBatch(const QString& label);
+    void endBatch();
+    bool inBatch() const { return batchDepth > 0; }
+    
+    bool canUndo() const { return !undoStack.isEmpty(); }
+    bool canRedo() const { return !redoStack.isEmpty(); }
+    QString undoLabel() const { return canUndo() ? undoStack.last().label : QString(); }
+    QString redoLabel() const { return canRedo() ? redoStack.last().label : QString(); }
+    
+    // take* saca la entrada; tras aplicarla se pasa a la otra pila con push*,
+    // o se devuelve a la original si la transacción falló
+    JournalEntry takeUndo();
+    JournalEntry takeRedo();
+    void pushUndo(const JournalEntry& entry);
+    void pushRedo(const JournalEntry& entry);
+    
+    void clear();
+    
+    static QString describe(const InventoryCommand& command);
+
+private:
+    void push(const JournalEntry& entry);
+    
+    QVector<JournalEntry> undoStack;
+    QVector<JournalEntry> redoStack;
+    JournalEntry batch;
+    int batchDepth;
+    int maxEntries;
+};
+
+#endif // COMMANDJOURNAL_H
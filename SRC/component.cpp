@@ -31,11 +31,14 @@ QJsonObject Component::toJSON() const {
     json["quantity"] = m_quantity;
     json["location"] = m_location;
     json["purchaseDate"] = m_purchaseDate.toString(Qt::ISODate);
+    if (!m_site.isEmpty()) {
+        json["site"] = m_site;
+    }
     return json;
 }
 
 Component Component::fromJSON(const QJsonObject& json) {
-    return Component(
+    Component component(
         json["id"].toInt(),
         json["name"].toString(),
         json["type"].toString(),
@@ -43,4 +46,6 @@ Component Component::fromJSON(const QJsonObject& json) {
         json["location"].toString(),
         QDate::fromString(json["purchaseDate"].toString(), Qt::ISODate)
     );
+    component.setSite(json["site"].toString());
+    return component;
 }
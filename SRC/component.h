@@ -4,6 +4,7 @@
 #include <QString>
 #include <QDate>
 #include <QJsonObject>
+#include <QMetaType>
 
 class Component {
 public:
@@ -21,13 +22,16 @@ public:
     int getQuantity() const { return m_quantity; }
     QString getLocation() const { return m_location; }
     QDate getPurchaseDate() const { return m_purchaseDate; }
+    QString getSite() const { return m_site; }
     
     // Setters
+    void setId(int id) { m_id = id; }
     void setName(const QString& name) { m_name = name; }
     void setType(const QString& type) { m_type = type; }
     void setQuantity(int quantity) { m_quantity = quantity; }
     void setLocation(const QString& location) { m_location = location; }
     void setPurchaseDate(const QDate& date) { m_purchaseDate = date; }
+    void setSite(const QString& site) { m_site = site; }
     
     QString toString() const;
     
@@ -42,6 +46,9 @@ private:
     int m_quantity;            ///< Cantidad disponible
     QString m_location;        ///< Ubicación física
     QDate m_purchaseDate;      ///< Fecha de adquisición
+    QString m_site;            ///< Sede/almacén (vacío = sede principal)
 };
 
+Q_DECLARE_METATYPE(Component)
+
 #endif // COMPONENT_H
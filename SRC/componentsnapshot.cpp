@@ -0,0 +1,368 @@
+#include "componentsnapshot.h"
+#include <QSaveFile>
+#include <QHash>
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QDebug>
+#include <cstring>
+
+namespace {
+const char kMagic[4] = {'I', 'C', 'S', 'N'};
+const quint32 kVersion = 3;
+const quint32 kByteOrderMark = 0x01020304;
+
+// Con 256 KiB por bloque, 1M de componentes son ~200 bloques: la tabla ocupa
+// menos de 2 KiB y verificar un bloque al leerlo cuesta décimas de ms
+const qint64 kBlockBytes = 256 * 1024;
+
+quint32 blocksFor(qint64 bodySize) {
+    return static_cast<quint32>((bodySize + kBlockBytes - 1) / kBlockBytes);
+}
+}
+
+/// Acumula registros y pool de cadenas antes de volcarlos a disco
+class ComponentSnapshot::Writer {
+public:
+    explicit Writer(quint64 dataVersion) : dataVersion(dataVersion) {}
+
+    void append(const Component& component) {
+        Record record;
+        std::memset(&record, 0, sizeof(record));
+        record.id = component.getId();
+        record.quantity = component.getQuantity();
+        record.purchaseDay = component.getPurchaseDate().isValid()
+            ? static_cast<qint32>(component.getPurchaseDate().toJulianDay()) : 0;
+        intern(component.getName(), record.nameOffset, record.nameLength);
+        intern(component.getType(), record.typeOffset, record.typeLength);
+        intern(component.getLocation(), record.locationOffset, record.locationLength);
+        records.append(record);
+    }
+
+    bool save(const QString& path) const {
+        Header header;
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, kMagic, sizeof(kMagic));
+        header.version = kVersion;
+        header.byteOrderMark = kByteOrderMark;
+        header.count = static_cast<quint32>(records.size());
+        header.stringPoolLength = static_cast<quint32>(strings.size());
+        header.dataVersion = dataVersion;
+
+        const qint64 recordBytes = qint64(records.size()) * sizeof(Record);
+        const qint64 stringBytes = qint64(strings.size()) * sizeof(QChar);
+
+        // Registros y pool forman un cuerpo contiguo con un checksum por bloque
+        QByteArray body;
+        body.reserve(recordBytes + stringBytes);
+        body.append(reinterpret_cast<const char*>(records.constData()), recordBytes);
+        body.append(reinterpret_cast<const char*>(strings.constData()), stringBytes);
+
+        header.blockCount = blocksFor(body.size());
+        QVector<quint64> blockChecksums(int(header.blockCount));
+        const uchar* bodyData = reinterpret_cast<const uchar*>(body.constData());
+        for (quint32 i = 0; i < header.blockCount; ++i) {
+            const qint64 offset = qint64(i) * kBlockBytes;
+            blockChecksums[int(i)] = ComponentSnapshot::checksum(
+                bodyData + offset, qMin(kBlockBytes, body.size() - offset));
+        }
+        const QByteArray table(reinterpret_cast<const char*>(blockChecksums.constData()),
+                               blockChecksums.size() * int(sizeof(quint64)));
+
+        // El de la cabecera se calcula con el campo a 0 y sigue con la tabla
+        header.checksum = 0;
+        header.checksum = ComponentSnapshot::checksum(
+            reinterpret_cast<const uchar*>(table.constData()), table.size(),
+            ComponentSnapshot::checksum(reinterpret_cast<const uchar*>(&header), sizeof(header)));
+
+        QSaveFile file(path);
+        if (!file.open(QIODevice::WriteOnly)) {
+            qWarning() << "No se pudo crear la instantánea:" << file.errorString();
+            return false;
+        }
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(table);
+        file.write(body);
+        return file.commit();
+    }
+
+private:
+    void intern(const QString& text, quint32& offset, quint16& length) {
+        const QString clipped = text.left(0xFFFF);
+        auto it = pool.constFind(clipped);
+        if (it == pool.constEnd()) {
+            it = pool.insert(clipped, static_cast<quint32>(strings.size()));
+            strings.append(clipped);
+        }
+        offset = it.value();
+        length = static_cast<quint16>(clipped.size());
+    }
+
+    quint64 dataVersion;
+    QVector<Record> records;
+    QString strings;                ///< Pool contiguo en UTF-16
+    QHash<QString, quint32> pool;   ///< Deduplica tipos y ubicaciones repetidos
+};
+
+ComponentSnapshot::ComponentSnapshot()
+    : m_body(nullptr), m_blockChecksums(nullptr), m_records(nullptr), m_strings(nullptr),
+      m_count(0), m_stringPoolLength(0), m_blockCount(0), m_bodySize(0), m_dataVersion(0) {
+}
+
+ComponentSnapshot::~ComponentSnapshot() {
+    close();
+}
+
+bool ComponentSnapshot::open(const QString& path) {
+    close();
+
+    m_file.setFileName(path);
+    if (!m_file.exists() || !m_file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    const qint64 size = m_file.size();
+    if (size < qint64(sizeof(Header))) {
+        qWarning() << "Instantánea truncada:" << path;
+        close();
+        return false;
+    }
+
+    uchar* data = m_file.map(0, size);
+    if (!data) {
+        qWarning() << "No se pudo mapear la instantánea:" << m_file.errorString();
+        close();
+        return false;
+    }
+
+    Header header;
+    std::memcpy(&header, data, sizeof(header));
+
+    if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 ||
+        header.version != kVersion || header.byteOrderMark != kByteOrderMark) {
+        qWarning() << "Instantánea con formato o versión incompatible:" << path;
+        close();
+        return false;
+    }
+
+    const qint64 bodySize = qint64(header.count) * sizeof(Record)
+                          + qint64(header.stringPoolLength) * sizeof(QChar);
+    const qint64 tableSize = qint64(header.blockCount) * sizeof(quint64);
+    if (header.blockCount != blocksFor(bodySize) ||
+        size != qint64(sizeof(Header)) + tableSize + bodySize) {
+        qWarning() << "Tamaño de instantánea inconsistente:" << path;
+        close();
+        return false;
+    }
+
+    // Solo cabecera y tabla: el cuerpo se verifica por bloques al leerlo
+    const uchar* table = data + sizeof(Header);
+    const quint64 stored = header.checksum;
+    header.checksum = 0;
+    if (checksum(table, tableSize, checksum(reinterpret_cast<const uchar*>(&header),
+                                            sizeof(header))) != stored) {
+        qWarning() << "Checksum de instantánea inválido:" << path;
+        close();
+        return false;
+    }
+
+    m_body = table + tableSize;
+    m_blockChecksums = reinterpret_cast<const quint64*>(table);
+    m_records = reinterpret_cast<const Record*>(m_body);
+    m_strings = reinterpret_cast<const QChar*>(m_body + qint64(header.count) * sizeof(Record));
+    m_count = header.count;
+    m_stringPoolLength = header.stringPoolLength;
+    m_blockCount = header.blockCount;
+    m_bodySize = bodySize;
+    m_dataVersion = header.dataVersion;
+    m_blockState.reset(new QAtomicInt[m_blockCount]);
+
+    qDebug() << "Instantánea cargada:" << m_count << "componentes";
+    return true;
+}
+
+void ComponentSnapshot::close() {
+    m_body = nullptr;
+    m_blockChecksums = nullptr;
+    m_records = nullptr;
+    m_strings = nullptr;
+    m_count = 0;
+    m_stringPoolLength = 0;
+    m_blockCount = 0;
+    m_bodySize = 0;
+    m_dataVersion = 0;
+    m_blockState.reset();
+    m_corrupt.storeRelease(0);
+    if (m_file.isOpen()) {
+        m_file.close();   // También libera el mapeo
+    }
+}
+
+Component ComponentSnapshot::at(int index) const {
+    if (!m_records || index < 0 || quint32(index) >= m_count) {
+        return Component();
+    }
+
+    const Record& record = m_records[index];
+    if (!verifyRecord(record, qint64(index) * sizeof(Record))) {
+        return Component();
+    }
+    return Component(
+        record.id,
+        QString(m_strings + record.nameOffset, record.nameLength),
+        QString(m_strings + record.typeOffset, record.typeLength),
+        record.quantity,
+        QString(m_strings + record.locationOffset, record.locationLength),
+        record.purchaseDay ? QDate::fromJulianDay(record.purchaseDay) : QDate()
+    );
+}
+
+QVector<Component> ComponentSnapshot::toVector() const {
+    QVector<Component> components;
+
+    // Se va a leer todo el cuerpo: aquí sí se verifica entero (una sola vez)
+    if (!verify(0, m_bodySize)) {
+        return components;
+    }
+    components.reserve(count());
+
+    // Tipos y ubicaciones se repiten mucho y el pool ya los deduplica: una sola
+    // QString compartida por desplazamiento en lugar de una copia por componente
+    QHash<quint32, QString> shared;
+    auto sharedString = [this, &shared](quint32 offset, quint16 length) {
+        auto it = shared.constFind(offset);
+        if (it == shared.constEnd()) {
+            it = shared.insert(offset, QString(m_strings + offset, length));
+        }
+        return it.value();
+    };
+
+    for (quint32 i = 0; i < m_count; ++i) {
+        const Record& record = m_records[i];
+        components.append(Component(
+            record.id,
+            QString(m_strings + record.nameOffset, record.nameLength),
+            sharedString(record.typeOffset, record.typeLength),
+            record.quantity,
+            sharedString(record.locationOffset, record.locationLength),
+            record.purchaseDay ? QDate::fromJulianDay(record.purchaseDay) : QDate()
+        ));
+    }
+    return components;
+}
+
+bool ComponentSnapshot::write(const QString& path, const QVector<Component>& components,
+                              quint64 dataVersion) {
+    Writer writer(dataVersion);
+    for (const Component& component : components) {
+        writer.append(component);
+    }
+    return writer.save(path);
+}
+
+bool ComponentSnapshot::rebuild(const QString& path, QSqlDatabase db) {
+    // Versión y filas en la misma transacción de lectura: ninguna escritura
+    // puede colarse entre ambas
+    if (!db.transaction()) {
+        qWarning() << "Error iniciando lectura para instantánea:" << db.lastError().text();
+        return false;
+    }
+    const quint64 dataVersion = currentDataVersion(db);
+
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+
+    if (!query.exec("SELECT id, name, type, quantity, location, purchase_date "
+                    "FROM componentes ORDER BY name")) {
+        qWarning() << "Error leyendo componentes para instantánea:" << query.lastError().text();
+        db.rollback();
+        return false;
+    }
+
+    Writer writer(dataVersion);
+    while (query.next()) {
+        writer.append(Component(
+            query.value(0).toInt(),
+            query.value(1).toString(),
+            query.value(2).toString(),
+            query.value(3).toInt(),
+            query.value(4).toString(),
+            query.value(5).toDate()
+        ));
+    }
+    query.finish();
+    db.commit();
+    return writer.save(path);
+}
+
+quint64 ComponentSnapshot::currentDataVersion(QSqlDatabase db) {
+    // AUTOINCREMENT guarda el mayor seq emitido aunque se depure el registro
+    QSqlQuery query(db);
+    if (!query.exec("SELECT seq FROM sqlite_sequence WHERE name = 'cambios'") || !query.next()) {
+        return 0;
+    }
+    return query.value(0).toULongLong();
+}
+
+bool ComponentSnapshot::verify(qint64 offset, qint64 length) const {
+    if (!m_body || offset < 0 || length < 0 || offset + length > m_bodySize) {
+        return false;
+    }
+    if (length == 0) {
+        return true;
+    }
+
+    const quint32 first = quint32(offset / kBlockBytes);
+    const quint32 last = quint32((offset + length - 1) / kBlockBytes);
+    for (quint32 i = first; i <= last; ++i) {
+        // Dos hilos pueden verificar el mismo bloque a la vez: el resultado es idéntico
+        int state = m_blockState[i].loadAcquire();
+        if (state == 0) {
+            const qint64 start = qint64(i) * kBlockBytes;
+            const bool ok = checksum(m_body + start, qMin(kBlockBytes, m_bodySize - start))
+                            == m_blockChecksums[i];
+            state = ok ? 1 : -1;
+            m_blockState[i].storeRelease(state);
+            if (!ok) {
+                qWarning() << "Bloque" << i << "de la instantánea dañado";
+                m_corrupt.storeRelease(1);
+            }
+        }
+        if (state < 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ComponentSnapshot::verifyRecord(const Record& record, qint64 recordOffset) const {
+    if (!verify(recordOffset, sizeof(Record))) {
+        return false;
+    }
+    const qint64 poolOffset = qint64(m_count) * sizeof(Record);
+    const quint32 offsets[] = {record.nameOffset, record.typeOffset, record.locationOffset};
+    const quint16 lengths[] = {record.nameLength, record.typeLength, record.locationLength};
+    for (int i = 0; i < 3; ++i) {
+        if (qint64(offsets[i]) + lengths[i] > m_stringPoolLength ||
+            !verify(poolOffset + qint64(offsets[i]) * sizeof(QChar), lengths[i] * sizeof(QChar))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+quint64 ComponentSnapshot::checksum(const uchar* data, qint64 size, quint64 hash) {
+    // FNV-1a sobre palabras de 64 bits: suficiente para detectar corrupción
+    // y mucho más rápido que un CRC byte a byte sobre decenas de MB
+    const quint64 prime = 0x100000001b3ULL;
+
+    qint64 i = 0;
+    for (; i + 8 <= size; i += 8) {
+        quint64 word;
+        std::memcpy(&word, data + i, sizeof(word));
+        hash = (hash ^ word) * prime;
+    }
+    for (; i < size; ++i) {
+        hash = (hash ^ data[i]) * prime;
+    }
+    return hash;
+}
@@ -0,0 +1,116 @@
+#ifndef COMPONENTSNAPSHOT_H
+#define COMPONENTSNAPSHOT_H
+
+#include <QString>
+#include <QVector>
+#include <QFile>
+#include <QSqlDatabase>
+#include <QAtomicInt>
+#include <QScopedArrayPointer>
+#include "component.h"
+
+/**
+ * Instantánea binaria de la tabla 'componentes'.
+ *
+ * Formato (orden de bytes nativo, versión 3):
+ *   Header   - cabecera fija de 40 bytes (magic, versión, conteos, versión de datos, checksum)
+ *   quint64[] - checksum de cada bloque de 256 KiB del cuerpo
+ *   Record[] - un registro de 32 bytes por componente, ordenados por nombre
+ *   QChar[]  - pool de cadenas UTF-16 deduplicadas
+ *
+ * El archivo se mapea en memoria y los componentes se decodifican bajo
+ * demanda, sin pasar por QSqlQuery ni QVariant. open() solo comprueba la
+ * cabecera y la tabla de checksums; cada bloque del cuerpo se verifica la
+ * primera vez que se lee, así abrir no recorre todas las páginas del archivo.
+ * Un bloque dañado marca la instantánea como corrupta (isCorrupt()).
+ *
+ * La versión de datos es el último seq del registro de cambios incluido: si
+ * no coincide con el de la BD, la instantánea está desactualizada (salida o
+ * caída antes de reconciliar).
+ */
+class ComponentSnapshot {
+public:
+    ComponentSnapshot();
+    ~ComponentSnapshot();
+
+    ComponentSnapshot(const ComponentSnapshot&) = delete;
+    ComponentSnapshot& operator=(const ComponentSnapshot&) = delete;
+
+    /// Mapea el archivo y valida cabecera y checksums; false si falta, está truncado o es de otra versión
+    bool open(const QString& path);
+    void close();
+    bool isOpen() const { return m_records != nullptr; }
+
+    /// Algún bloque leído no coincidió con su checksum
+    bool isCorrupt() const { return m_corrupt.loadAcquire() != 0; }
+
+    int count() const { return static_cast<int>(m_count); }
+    quint64 dataVersion() const { return m_dataVersion; }
+
+    /// Componente -1 si el índice está fuera de rango o su bloque está dañado
+    Component at(int index) const;
+
+    /// Vacío si algún bloque está dañado
+    QVector<Component> toVector() const;
+
+    /// Escribe una instantánea completa de forma atómica
+    static bool write(const QString& path, const QVector<Component>& components,
+                      quint64 dataVersion = 0);
+
+    /// Regenera la instantánea leyendo la tabla desde la conexión indicada
+    static bool rebuild(const QString& path, QSqlDatabase db);
+
+    /// Último seq del registro de cambios (0 si aún no hay cambios)
+    static quint64 currentDataVersion(QSqlDatabase db);
+
+private:
+    struct Header {
+        char magic[4];
+        quint32 version;
+        quint32 byteOrderMark;
+        quint32 count;
+        quint32 stringPoolLength;   ///< En QChar
+        quint32 blockCount;         ///< Entradas de la tabla de checksums
+        quint64 dataVersion;        ///< seq de 'cambios' al generar la instantánea
+        quint64 checksum;           ///< De la cabecera (con este campo a 0) y la tabla
+    };
+
+    struct Record {
+        qint32 id;
+        qint32 quantity;
+        qint32 purchaseDay;         ///< Día juliano, 0 si la fecha es inválida
+        quint32 nameOffset;
+        quint32 typeOffset;
+        quint32 locationOffset;
+        quint16 nameLength;
+        quint16 typeLength;
+        quint16 locationLength;
+        quint16 padding;
+    };
+
+    static_assert(sizeof(Header) == 40, "Header de instantánea debe ocupar 40 bytes");
+    static_assert(sizeof(Record) == 32, "Record de instantánea debe ocupar 32 bytes");
+
+    class Writer;
+
+    static quint64 checksum(const uchar* data, qint64 size, quint64 hash = 0xcbf29ce484222325ULL);
+
+    /// Verifica (una sola vez) los bloques que cubren [offset, offset + length) del cuerpo
+    bool verify(qint64 offset, qint64 length) const;
+    bool verifyRecord(const Record& record, qint64 recordOffset) const;
+
+    QFile m_file;
+    const uchar* m_body;
+    const quint64* m_blockChecksums;
+    const Record* m_records;
+    const QChar* m_strings;
+    quint32 m_count;
+    quint32 m_stringPoolLength;
+    quint32 m_blockCount;
+    qint64 m_bodySize;
+    quint64 m_dataVersion;
+    mutable QScopedArrayPointer<QAtomicInt> m_blockState;   ///< 0 sin verificar, 1 correcto, -1 dañado
+    mutable QAtomicInt m_corrupt;
+};
+
+#endif // COMPONENTSNAPSHOT_H
@@ -3,24 +3,105 @@
 #include <QFile>
 #include <QStandardPaths>
 #include <QSqlError>
+#include <QThread>
+#include <QFileInfo>
+#include <QRegularExpression>
+#include <QtConcurrent>
+#include <QJsonDocument>
+#include <QDataStream>
+#include <algorithm>
 #include <QDebug>
 
 DatabaseManager* DatabaseManager::instance = nullptr;
 QMutex DatabaseManager::mutex;
+QAtomicInt DatabaseManager::threadProfile(int(PerformanceProfile::Balanced));
+QString DatabaseManager::dataDirOverride;
+const QString DatabaseManager::kMainSite = "principal";
+
+namespace {
+struct ProfilePragmas {
+    const char* journalMode;
+    const char* synchronous;
+    int cacheKiB;          ///< cache_size negativo = KiB
+    qint64 mmapSize;
+    const char* tempStore;
+    int walAutocheckpoint; ///< Páginas de WAL antes de cada checkpoint automático
+};
+
+// page_size solo se aplica al crear el archivo (en WAL no cambia con VACUUM)
+const int kPageSize = 4096;
+
+const quint8 kPageTokenVersion = 1;
+
+// SQLITE_MAX_ATTACHED por defecto: no caben más sedes en la conexión principal
+const int kMaxAttachedSites = 10;
+
+// Cada sede numera sus componentes en un bloque propio de 2^24 IDs: el ID
+// identifica la sede y nunca coincide con el de una fila de otra sede
+const int kSiteIdBits = 24;
+
+/// Token de página: última clave (name, id) servida, en base64url
+QString encodePageToken(const QString& name, int id) {
+    QByteArray data;
+    QDataStream out(&data, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_5_12);
+    out << kPageTokenVersion << name << qint32(id);
+    return QString::fromLatin1(data.toBase64(QByteArray::Base64UrlEncoding |
+                                             QByteArray::OmitTrailingEquals));
+}
+
+bool decodePageToken(const QString& token, QString* name, int* id) {
+    const QByteArray data = QByteArray::fromBase64(token.toLatin1(),
+                                                   QByteArray::Base64UrlEncoding |
+                                                   QByteArray::OmitTrailingEquals);
+    QDataStream in(data);
+    in.setVersion(QDataStream::Qt_5_12);
+    quint8 version = 0;
+    qint32 lastId = 0;
+    in >> version >> *name >> lastId;
+    if (in.status() != QDataStream::Ok || version != kPageTokenVersion) {
+        return false;
+    }
+    *id = lastId;
+    return true;
+}
+
+ProfilePragmas pragmasFor(PerformanceProfile profile) {
+    switch (profile) {
+    case PerformanceProfile::Safe:
+        return {"DELETE", "FULL", 2000, 0, "DEFAULT", 1000};
+    case PerformanceProfile::BulkLoad:
+        // Se mantiene WAL: cambiar de modo exige bloqueo exclusivo y checkpoint,
+        // y ROLLBACK sigue funcionando (a diferencia de journal_mode=OFF).
+        // synchronous=NORMAL y no OFF: con OFF un corte de luz puede corromper la BD
+        // y el registro de cambios. Lo que gana una importación es hacer menos
+        // checkpoints (cada uno sincroniza y copia el WAL a la BD) y más caché
+        return {"WAL", "NORMAL", 65536, 256ll * 1024 * 1024, "MEMORY", 16384};
+    case PerformanceProfile::Balanced:
+        break;
+    }
+    return {"WAL", "NORMAL", 16384, 256ll * 1024 * 1024, "MEMORY", 1000};
+}
+}
 
 DatabaseManager::DatabaseManager(QObject* parent) 
     : QObject(parent) {
 
-    QString dataDir = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+    QString dataDir = dataDirOverride.isEmpty()
+        ? QStandardPaths::writableLocation(QStandardPaths::AppDataLocation)
+        : dataDirOverride;
     QDir dir(dataDir);
     if (!dir.exists()) {
         dir.mkpath(".");
     }
     dbPath = dataDir + "/inventory.db";
+    sitesDir = dataDir + "/sites";
+    sitePaths.insert(kMainSite, dbPath);
     qDebug() << "Ruta de base de datos:" << dbPath;
 }
 
 DatabaseManager::~DatabaseManager() {
+    preparedStatements.clear();   // Las consultas preparadas no pueden sobrevivir a la conexión
     if (db.isOpen()) {
         db.close();
     }
@@ -34,6 +115,59 @@ DatabaseManager* DatabaseManager::getInstance() {
     return instance;
 }
 
+namespace {
+// Perfil con el que se configuró cada conexión de este hilo; si el perfil
+// cambió desde entonces, se reaplica al volver a pedirla
+thread_local QHash<QString, int> appliedProfile;
+
+QString threadConnectionName(const QString& path) {
+    // QSqlDatabase no puede compartirse entre hilos: una conexión por hilo y ruta
+    return QString("inventory_%1_%2")
+        .arg(qHash(path))
+        .arg(reinterpret_cast<quintptr>(QThread::currentThreadId()));
+}
+}
+
+QSqlDatabase DatabaseManager::connectionForThread(const QString& path) {
+    const QString name = threadConnectionName(path);
+    const int current = threadProfile.loadAcquire();
+    
+    QSqlDatabase conn;
+    if (QSqlDatabase::contains(name)) {
+        conn = QSqlDatabase::database(name);
+        if (!conn.isOpen() || appliedProfile.value(name, -1) == current) {
+            return conn;
+        }
+    } else {
+        conn = QSqlDatabase::addDatabase("QSQLITE", name);
+        conn.setDatabaseName(path);
+        if (!conn.open()) {
+            qCritical() << "No se pudo abrir conexión de hilo:" << conn.lastError().text();
+            return conn;
+        }
+    }
+    
+    // Las lecturas en segundo plano aprovechan mmap y caché del perfil activo;
+    // journal_mode y synchronous los fija la conexión principal
+    const ProfilePragmas pragmas = pragmasFor(PerformanceProfile(current));
+    QSqlQuery query(conn);
+    query.exec(QString("PRAGMA cache_size = -%1").arg(pragmas.cacheKiB));
+    query.exec(QString("PRAGMA mmap_size = %1").arg(pragmas.mmapSize));
+    query.exec(QString("PRAGMA temp_store = %1").arg(pragmas.tempStore));
+    appliedProfile.insert(name, current);
+    return conn;
+}
+
+void DatabaseManager::releaseThreadConnection(const QString& path) {
+    const QString name = threadConnectionName(path);
+    if (!QSqlDatabase::contains(name)) {
+        return;
+    }
+    QSqlDatabase::database(name, false).close();
+    QSqlDatabase::removeDatabase(name);
+    appliedProfile.remove(name);
+}
+
 bool DatabaseManager::initialize() {
 
     db = QSqlDatabase::addDatabase("QSQLITE", "inventory_connection");
@@ -47,14 +181,34 @@ bool DatabaseManager::initialize() {
     }
     
     qDebug() << "Base de datos abierta exitosamente";
-    return createTables();
+    if (!applyProfile("main", true)) {
+        return false;
+    }
+    if (!createTables()) {
+        return false;
+    }
+    
+    siteIdBlocks.insert(kMainSite, 0);
+    
+    // Adjuntar las sedes existentes (un archivo por sede)
+    QDir dir(sitesDir);
+    const QStringList files = dir.entryList({"*.db"}, QDir::Files, QDir::Name);
+    for (const QString& file : files) {
+        const QString site = QFileInfo(file).completeBaseName();
+        if (!isValidSiteName(site)) {
+            qWarning() << "Se ignora el archivo de sede con nombre inválido:" << dir.filePath(file);
+            continue;
+        }
+        attachSite(site, dir.filePath(file));
+    }
+    return true;
 }
 
-bool DatabaseManager::createTables() {
+bool DatabaseManager::createTables(const QString& schema) {
     QSqlQuery query(db);
     
-    QString createTable = 
-        "CREATE TABLE IF NOT EXISTS componentes ("
+    QString createTable =
+        "CREATE TABLE IF NOT EXISTS " + schema + ".componentes ("
         "id INTEGER PRIMARY KEY AUTOINCREMENT,"
         "name TEXT NOT NULL,"
         "type TEXT NOT NULL,"
@@ -69,91 +223,614 @@ bool DatabaseManager::createTables() {
         return false;
     }
     
-    qDebug() << "Tabla 'componentes' creada/verificada";
+    // Clave de los listados paginados: ORDER BY name, id sin ordenar en memoria.
+    // Por cantidad: el resumen de stock bajo de cada sede no recorre la tabla entera
+    if (!query.exec("CREATE INDEX IF NOT EXISTS " + schema +
+                    ".idx_componentes_name_id ON componentes(name, id)") ||
+        !query.exec("CREATE INDEX IF NOT EXISTS " + schema +
+                    ".idx_componentes_quantity ON componentes(quantity)")) {
+        QString error = "Error creando índice: " + query.lastError().text();
+        qCritical() << error;
+        emit errorOccurred(error);
+        return false;
+    }
+    
+    qDebug() << "Tabla 'componentes' creada/verificada en" << schema;
+    
+    if (schema != "main") {
+        // Cambios de la sede, anotados en su archivo junto al dato hasta copiarlos al
+        // registro principal; AUTOINCREMENT evita reutilizar seq al vaciarla
+        if (!query.exec("CREATE TABLE IF NOT EXISTS " + schema + ".cambios_sede ("
+                        "seq INTEGER PRIMARY KEY AUTOINCREMENT,"
+                        "op TEXT NOT NULL,"
+                        "component_id INTEGER NOT NULL,"
+                        "delta INTEGER,"
+                        "payload TEXT NOT NULL,"
+                        "created_at TEXT NOT NULL)")) {
+            QString error = "Error creando registro de cambios de la sede: " + query.lastError().text();
+            qCritical() << error;
+            emit errorOccurred(error);
+            return false;
+        }
+    }
+    
+    // Reservas y registro de cambios solo existen en la sede principal
+    if (schema == "main") {
+        QString createReservations =
+            "CREATE TABLE IF NOT EXISTS reservas ("
+            "id INTEGER PRIMARY KEY,"
+            "component_id INTEGER NOT NULL REFERENCES componentes(id),"
+            "quantity INTEGER NOT NULL CHECK(quantity > 0),"
+            "project TEXT NOT NULL,"
+            "created_at TEXT NOT NULL)";
+        
+        if (!query.exec(createReservations)) {
+            QString error = "Error creando tabla de reservas: " + query.lastError().text();
+            qCritical() << error;
+            emit errorOccurred(error);
+            return false;
+        }
+        
+        // AUTOINCREMENT garantiza que seq nunca se reutiliza, aunque se depure el registro
+        QString createChangeLog =
+            "CREATE TABLE IF NOT EXISTS cambios ("
+            "seq INTEGER PRIMARY KEY AUTOINCREMENT,"
+            "op TEXT NOT NULL,"
+            "component_id INTEGER NOT NULL,"
+            "site TEXT NOT NULL,"
+            "delta INTEGER,"
+            "payload TEXT NOT NULL,"
+            "created_at TEXT NOT NULL,"
+            "site_seq INTEGER)";
+        
+        if (!query.exec(createChangeLog)) {
+            QString error = "Error creando registro de cambios: " + query.lastError().text();
+            qCritical() << error;
+            emit errorOccurred(error);
+            return false;
+        }
+        
+        // Migración: site_seq (seq en cambios_sede) identifica cada cambio copiado de una
+        // sede; el índice único hace que repetir una copia interrumpida no duplique nada
+        bool hasSiteSeq = false;
+        query.exec("PRAGMA table_info(cambios)");
+        while (query.next()) {
+            hasSiteSeq = hasSiteSeq || query.value(1).toString() == "site_seq";
+        }
+        if ((!hasSiteSeq && !query.exec("ALTER TABLE cambios ADD COLUMN site_seq INTEGER")) ||
+            !query.exec("CREATE UNIQUE INDEX IF NOT EXISTS idx_cambios_site_seq "
+                        "ON cambios(site, site_seq) WHERE site_seq IS NOT NULL")) {
+            QString error = "Error migrando registro de cambios: " + query.lastError().text();
+            qCritical() << error;
+            emit errorOccurred(error);
+            return false;
+        }
+        
+        QString createConsumption =
+            "CREATE TABLE IF NOT EXISTS consumo ("
+            "component_id INTEGER PRIMARY KEY,"
+            "decayed_units REAL NOT NULL,"
+            "last_event_ms INTEGER NOT NULL,"
+            "first_event_ms INTEGER NOT NULL DEFAULT 0)";
+        
+        if (!query.exec(createConsumption)) {
+            QString error = "Error creando tabla de consumo: " + query.lastError().text();
+            qCritical() << error;
+            emit errorOccurred(error);
+            return false;
+        }
+        
+        // Migración: las series anteriores quedan con inicio desconocido (0)
+        bool hasFirstEvent = false;
+        query.exec("PRAGMA table_info(consumo)");
+        while (query.next()) {
+            hasFirstEvent = hasFirstEvent || query.value(1).toString() == "first_event_ms";
+        }
+        if (!hasFirstEvent &&
+            !query.exec("ALTER TABLE consumo ADD COLUMN first_event_ms INTEGER NOT NULL DEFAULT 0")) {
+            QString error = "Error migrando tabla de consumo: " + query.lastError().text();
+            qCritical() << error;
+            emit errorOccurred(error);
+            return false;
+        }
+        
+        if (!createLotTables()) {
+            return false;
+        }
+    }
     return true;
 }
 
-bool DatabaseManager::addComponent(const Component& component) {
+bool DatabaseManager::createLotTables() {
     QSqlQuery query(db);
+    query.exec("SELECT 1 FROM sqlite_master WHERE type = 'table' AND name = 'lotes'");
+    const bool existed = query.next();
+    query.finish();
     
-    query.prepare(
-        "INSERT INTO componentes (name, type, quantity, location, purchase_date) "
-        "VALUES (:name, :type, :quantity, :location, :date)"
-    );
+    // Fechas como día juliano: comparaciones enteras que usan los índices
+    const QStringList statements = {
+        "CREATE TABLE IF NOT EXISTS lotes ("
+        "id INTEGER PRIMARY KEY,"
+        "component_id INTEGER NOT NULL REFERENCES componentes(id),"
+        "received INTEGER NOT NULL CHECK(received > 0),"
+        "remaining INTEGER NOT NULL CHECK(remaining >= 0 AND remaining <= received),"
+        "purchase_day INTEGER NOT NULL,"
+        "unit_cost REAL NOT NULL DEFAULT 0)",
+        // Consumo FIFO de un componente (y borrado de sus lotes)
+        "CREATE INDEX IF NOT EXISTS idx_lotes_component ON lotes(component_id, purchase_day, id)",
+        // Rangos de fechas en orden (purchase_day, id), sin ordenar aparte; cubre los
+        // totales sin leer la tabla. Sustituye a idx_lotes_day, que no incluía el id
+        "CREATE INDEX IF NOT EXISTS idx_lotes_day_id "
+        "ON lotes(purchase_day, id, received, remaining, unit_cost)",
+        "DROP INDEX IF EXISTS idx_lotes_day",
+        // Lotes con existencias, los más antiguos primero
+        "CREATE INDEX IF NOT EXISTS idx_lotes_open ON lotes(purchase_day, id) WHERE remaining > 0"
+    };
+    for (const QString& sql : statements) {
+        if (!query.exec(sql)) {
+            QString error = "Error creando tabla de lotes: " + query.lastError().text();
+            qCritical() << error;
+            emit errorOccurred(error);
+            return false;
+        }
+    }
+    
+    if (existed) {
+        return true;
+    }
+    
+    // Migración: la cantidad actual de cada componente pasa a ser un lote con su fecha de compra
+    if (!query.exec(
+            "INSERT INTO lotes (component_id, received, remaining, purchase_day) "
+            "SELECT id, quantity, quantity, "
+            "COALESCE(CAST(julianday(purchase_date) + 0.5 AS INTEGER), "
+            "CAST(julianday('now') + 0.5 AS INTEGER)) "
+            "FROM componentes WHERE quantity > 0")) {
+        QString error = "Error migrando existencias a lotes: " + query.lastError().text();
+        qCritical() << error;
+        emit errorOccurred(error);
+        return false;
+    }
+    qDebug() << "Lotes iniciales creados:" << query.numRowsAffected();
+    return true;
+}
+
+bool DatabaseManager::isValidSiteName(const QString& site) {
+    // El nombre acaba en un identificador SQL (site_<nombre>) sin comillas
+    static const QRegularExpression validName("^[A-Za-z0-9_]+$");
+    return validName.match(site).hasMatch() && site != kMainSite;
+}
+
+QString DatabaseManager::getSitePath(const QString& site) const {
+    if (isMainSite(site)) {
+        return dbPath;
+    }
+    if (!isValidSiteName(site)) {
+        return QString();
+    }
+    return sitesDir + "/" + site + ".db";
+}
+
+bool DatabaseManager::addSite(const QString& site) {
+    if (!isValidSiteName(site)) {
+        QString error = "Nombre de sede inválido: " + site;
+        qWarning() << error;
+        emit errorOccurred(error);
+        return false;
+    }
+    
+    if (sitePaths.contains(site)) {
+        return true;
+    }
+    
+    QDir().mkpath(sitesDir);
+    return attachSite(site, getSitePath(site));
+}
+
+bool DatabaseManager::attachSite(const QString& site, const QString& path) {
+    // sitePaths incluye la principal, que no cuenta como adjunta
+    if (sitePaths.size() - 1 >= kMaxAttachedSites) {
+        QString error = QString("No se puede adjuntar la sede %1: SQLite admite como máximo %2 "
+                                "bases adjuntas").arg(site).arg(kMaxAttachedSites);
+        qCritical() << error;
+        emit errorOccurred(error);
+        return false;
+    }
+    
+    QSqlQuery query(db);
     
-    query.bindValue(":name", component.getName());
-    query.bindValue(":type", component.getType());
-    query.bindValue(":quantity", component.getQuantity());
-    query.bindValue(":location", component.getLocation());
-    query.bindValue(":date", component.getPurchaseDate().toString(Qt::ISODate));
+    query.prepare("ATTACH DATABASE :path AS site_" + site);
+    query.bindValue(":path", path);
     
     if (!query.exec()) {
-        QString error = "Error agregando componente: " + query.lastError().text();
+        QString error = "Error adjuntando sede " + site + ": " + query.lastError().text();
         qCritical() << error;
         emit errorOccurred(error);
         return false;
     }
     
-    qDebug() << "Componente agregado, ID:" << query.lastInsertId();
-    emit dataChanged();
+    if (!applyProfile("site_" + site, true) || !createTables("site_" + site)) {
+        query.exec("DETACH DATABASE site_" + site);
+        return false;
+    }
+    
+    // El bloque de IDs se guarda en el propio archivo como semilla de AUTOINCREMENT
+    int block = 0;
+    query.exec("SELECT seq FROM site_" + site + ".sqlite_sequence WHERE name = 'componentes'");
+    if (query.next()) {
+        block = int(query.value(0).toLongLong() >> kSiteIdBits);
+    } else {
+        for (int used : qAsConst(siteIdBlocks)) {
+            block = qMax(block, used + 1);
+        }
+        query.prepare("INSERT INTO site_" + site + ".sqlite_sequence (name, seq) "
+                      "VALUES ('componentes', :seq)");
+        query.bindValue(":seq", qint64(block) << kSiteIdBits);
+        if (!query.exec()) {
+            QString error = "Error asignando IDs a la sede " + site + ": " + query.lastError().text();
+            qCritical() << error;
+            emit errorOccurred(error);
+            query.exec("DETACH DATABASE site_" + site);
+            return false;
+        }
+    }
+    const QString owner = siteIdBlocks.key(block);
+    if (!owner.isEmpty()) {
+        // Archivo anterior a los bloques: sus IDs no distinguen la sede
+        qWarning() << "La sede" << site << "comparte IDs con" << owner;
+    }
+    
+    
+    siteIdBlocks.insert(site, block);
+    sitePaths.insert(site, path);
+    qDebug() << "Sede adjuntada:" << site << path;
+    
+    // Cambios anotados que una caída dejó sin copiar al registro principal
+    relaySiteChanges(site);
+    return true;
+}
+
+bool DatabaseManager::setPerformanceProfile(PerformanceProfile newProfile) {
+    if (transactionDepth > 0) {
+        QString error = "No se puede cambiar el perfil de rendimiento dentro de una transacción";
+        qWarning() << error;
+        emit errorOccurred(error);
+        return false;
+    }
+    
+    // Antes de abrir la BD solo se recuerda: initialize() lo aplica
+    if (!db.isOpen()) {
+        profile = newProfile;
+        threadProfile.storeRelease(int(profile));
+        return true;
+    }
+    
+    if (qstrcmp(pragmasFor(newProfile).journalMode, pragmasFor(profile).journalMode) != 0) {
+        QString error = "El modo de journal solo puede cambiarse al arrancar, "
+                        "antes de abrir la base de datos";
+        qWarning() << error;
+        emit errorOccurred(error);
+        return false;
+    }
+    
+    const PerformanceProfile previous = profile;
+    profile = newProfile;
+    bool success = applyProfile("main", false);
+    for (auto it = sitePaths.constBegin(); success && it != sitePaths.constEnd(); ++it) {
+        if (it.key() != kMainSite) {
+            success = applyProfile("site_" + it.key(), false);
+        }
+    }
+    
+    if (!success) {
+        profile = previous;
+        applyProfile("main", false);
+        return false;
+    }
+    threadProfile.storeRelease(int(profile));
+    qDebug() << "Perfil de rendimiento:" << int(profile);
     return true;
 }
 
-bool DatabaseManager::updateComponent(const Component& component) {
+QStringList DatabaseManager::profilePragmas(PerformanceProfile profile, const QString& schema,
+                                            bool newFile) {
+    const ProfilePragmas pragmas = pragmasFor(profile);
+    QStringList statements;
+    if (newFile) {
+        // Sin efecto si el archivo ya tiene tablas; auto_vacuum incremental
+        // permite a MaintenanceScheduler devolver espacio en pasos cortos
+        statements << QString("PRAGMA %1.page_size = %2").arg(schema).arg(kPageSize)
+                   << QString("PRAGMA %1.auto_vacuum = INCREMENTAL").arg(schema);
+    }
+    statements << QString("PRAGMA %1.journal_mode = %2").arg(schema, pragmas.journalMode)
+               << QString("PRAGMA %1.synchronous = %2").arg(schema, pragmas.synchronous)
+               << QString("PRAGMA %1.cache_size = -%2").arg(schema).arg(pragmas.cacheKiB)
+               << QString("PRAGMA %1.mmap_size = %2").arg(schema).arg(pragmas.mmapSize)
+               << QString("PRAGMA temp_store = %1").arg(pragmas.tempStore)
+               << QString("PRAGMA wal_autocheckpoint = %1").arg(pragmas.walAutocheckpoint);
+    return statements;
+}
+
+bool DatabaseManager::applyProfile(const QString& schema, bool newFile) {
     QSqlQuery query(db);
+    const QStringList statements = profilePragmas(profile, schema, newFile);
+    for (const QString& statement : statements) {
+        if (!query.exec(statement)) {
+            QString error = "Error aplicando " + statement + ": " + query.lastError().text();
+            qCritical() << error;
+            emit errorOccurred(error);
+            return false;
+        }
+    }
+    return true;
+}
+
+QString DatabaseManager::tableFor(const QString& site) const {
+    if (isMainSite(site)) {
+        return "componentes";
+    }
+    return "site_" + site + ".componentes";
+}
+
+bool DatabaseManager::checkSiteId(int id, const QString& site, bool report) {
+    QString error;
+    auto it = siteIdBlocks.constFind(isMainSite(site) ? kMainSite : site);
+    if (it == siteIdBlocks.constEnd()) {
+        error = "Sede desconocida: " + site;
+    } else if ((id >> kSiteIdBits) != it.value()) {
+        error = QString("El componente %1 no pertenece a la sede %2")
+            .arg(id).arg(isMainSite(site) ? kMainSite : site);
+    } else {
+        return true;
+    }
     
-    query.prepare(
-        "UPDATE componentes SET "
+    qWarning() << error;
+    if (report) {
+        emit errorOccurred(error);
+    }
+    return false;
+}
+
+bool DatabaseManager::addComponent(const Component& component, int* newId,
+                                   QVector<LotShift>* lotShifts) {
+    return insertComponent(component, false, newId, lotShifts);
+}
+
+bool DatabaseManager::restoreComponent(const Component& component, QVector<LotShift>* lotShifts) {
+    if (component.getId() <= 0) {
+        return false;
+    }
+    return insertComponent(component, true, nullptr, lotShifts);
+}
+
+bool DatabaseManager::insertComponent(const Component& component, bool keepId, int* newId,
+                                      QVector<LotShift>* lotShifts) {
+    if ((keepId && !checkSiteId(component.getId(), component.getSite())) || !beginTransaction()) {
+        return false;
+    }
+    
+    auto query = preparedQuery(
+        "INSERT INTO " + tableFor(component.getSite()) +
+        (keepId ? " (id, name, type, quantity, location, purchase_date) "
+                  "VALUES (:id, :name, :type, :quantity, :location, :date)"
+                : " (name, type, quantity, location, purchase_date) "
+                  "VALUES (:name, :type, :quantity, :location, :date)")
+    );
+    if (!query) {
+        rollbackTransaction();
+        return false;
+    }
+    
+    if (keepId) {
+        query->bindValue(":id", component.getId());
+    }
+    query->bindValue(":name", component.getName());
+    query->bindValue(":type", component.getType());
+    query->bindValue(":quantity", component.getQuantity());
+    query->bindValue(":location", component.getLocation());
+    query->bindValue(":date", component.getPurchaseDate().toString(Qt::ISODate));
+    
+    if (!query->exec()) {
+        QString error = "Error agregando componente: " + query->lastError().text();
+        qCritical() << error;
+        emit errorOccurred(error);
+        rollbackTransaction();
+        return false;
+    }
+    
+    Component stored = component;
+    stored.setId(query->lastInsertId().toInt());
+    
+    const bool mainSite = stored.getSite().isEmpty() || stored.getSite() == kMainSite;
+    if (mainSite && !shiftLots(stored.getId(), stored.getQuantity(),
+                               stored.getPurchaseDate(), 0.0, lotShifts)) {
+        rollbackTransaction();
+        return false;
+    }
+    
+    if (!logChange("insert", stored.getId(), stored.getSite(), stored.getQuantity(), stored.toJSON())) {
+        rollbackTransaction();
+        return false;
+    }
+    if (!commitTransaction()) {
+        return false;
+    }
+    
+    qDebug() << "Componente agregado, ID:" << stored.getId();
+    if (newId) {
+        *newId = stored.getId();
+    }
+    notifyDataChanged();
+    return true;
+}
+
+bool DatabaseManager::updateComponent(const Component& component, QVector<LotShift>* lotShifts) {
+    return writeComponent(component, false, 0, lotShifts);
+}
+
+bool DatabaseManager::updateComponent(const Component& component, int quantityDelta,
+                                      QVector<LotShift>* lotShifts) {
+    return writeComponent(component, true, quantityDelta, lotShifts);
+}
+
+bool DatabaseManager::writeComponent(const Component& component, bool relative, int quantityDelta,
+                                     QVector<LotShift>* lotShifts) {
+    if (!checkSiteId(component.getId(), component.getSite()) || !beginTransaction()) {
+        return false;
+    }
+    
+    const QString table = tableFor(component.getSite());
+    
+    // En la sede principal los lotes deben sumar la nueva cantidad
+    const bool mainSite = isMainSite(component.getSite());
+    int previousQty = component.getQuantity();
+    if (mainSite || relative) {
+        auto select = preparedQuery("SELECT quantity FROM " + table + " WHERE id = :id");
+        if (!select) {
+            rollbackTransaction();
+            return false;
+        }
+        select->bindValue(":id", component.getId());
+        if (select->exec() && select->next()) {
+            previousQty = select->value(0).toInt();
+        } else if (relative) {
+            select->finish();
+            QString error = "Componente no encontrado para actualizar, ID: " +
+                            QString::number(component.getId());
+            qCritical() << error;
+            emit errorOccurred(error);
+            rollbackTransaction();
+            return false;
+        }
+        select->finish();
+    }
+    
+    Component stored = component;
+    if (relative) {
+        stored.setQuantity(previousQty + quantityDelta);
+        if (stored.getQuantity() < 0) {
+            QString error = "No se puede tener cantidad negativa para componente ID: " +
+                            QString::number(component.getId());
+            qWarning() << error;
+            emit errorOccurred(error);
+            rollbackTransaction();
+            return false;
+        }
+    }
+    
+    auto query = preparedQuery(
+        "UPDATE " + table + " SET "
         "name = :name, type = :type, quantity = :quantity, "
         "location = :location, purchase_date = :date "
         "WHERE id = :id"
     );
+    if (!query) {
+        rollbackTransaction();
+        return false;
+    }
     
-    query.bindValue(":id", component.getId());
-    query.bindValue(":name", component.getName());
-    query.bindValue(":type", component.getType());
-    query.bindValue(":quantity", component.getQuantity());
-    query.bindValue(":location", component.getLocation());
-    query.bindValue(":date", component.getPurchaseDate().toString(Qt::ISODate));
+    query->bindValue(":id", stored.getId());
+    query->bindValue(":name", stored.getName());
+    query->bindValue(":type", stored.getType());
+    query->bindValue(":quantity", stored.getQuantity());
+    query->bindValue(":location", stored.getLocation());
+    query->bindValue(":date", stored.getPurchaseDate().toString(Qt::ISODate));
     
-    if (!query.exec()) {
-        QString error = "Error actualizando componente: " + query.lastError().text();
+    if (!query->exec()) {
+        QString error = "Error actualizando componente: " + query->lastError().text();
         qCritical() << error;
         emit errorOccurred(error);
+        rollbackTransaction();
+        return false;
+    }
+    
+    bool updated = query->numRowsAffected() > 0;
+    if (updated && mainSite &&
+        !shiftLots(stored.getId(), stored.getQuantity() - previousQty,
+                   stored.getPurchaseDate(), 0.0, lotShifts)) {
+        rollbackTransaction();
+        return false;
+    }
+    if (updated && !logChange("update", stored.getId(), stored.getSite(),
+                              relative ? QVariant(quantityDelta) : QVariant(), stored.toJSON())) {
+        rollbackTransaction();
+        return false;
+    }
+    if (!commitTransaction()) {
         return false;
     }
     
-    bool updated = query.numRowsAffected() > 0;
     if (updated) {
-        emit dataChanged();
+        notifyDataChanged();
     }
     return updated;
 }
 
-bool DatabaseManager::deleteComponent(int id) {
-    QSqlQuery query(db);
+bool DatabaseManager::deleteComponent(int id, const QString& site, QVector<LotShift>* lotShifts) {
+    if (!checkSiteId(id, site) || !beginTransaction()) {
+        return false;
+    }
     
-    query.prepare("DELETE FROM componentes WHERE id = :id");
-    query.bindValue(":id", id);
+    auto query = preparedQuery("DELETE FROM " + tableFor(site) + " WHERE id = :id");
+    if (!query) {
+        rollbackTransaction();
+        return false;
+    }
+    query->bindValue(":id", id);
     
-    if (!query.exec()) {
-        QString error = "Error eliminando componente: " + query.lastError().text();
+    if (!query->exec()) {
+        QString error = "Error eliminando componente: " + query->lastError().text();
         qCritical() << error;
         emit errorOccurred(error);
+        rollbackTransaction();
+        return false;
+    }
+    
+    bool deleted = query->numRowsAffected() > 0;
+    if (deleted && (site.isEmpty() || site == kMainSite)) {
+        if (lotShifts) {
+            lotShifts->clear();
+            for (const Lot& lot : getLots(id, false)) {
+                lotShifts->append({lot.id, -lot.remaining, true, lot.received,
+                                   lot.purchaseDate, lot.unitCost});
+            }
+        }
+        auto lots = preparedQuery("DELETE FROM lotes WHERE component_id = :id");
+        if (!lots) {
+            rollbackTransaction();
+            return false;
+        }
+        lots->bindValue(":id", id);
+        if (!lots->exec()) {
+            QString error = "Error eliminando lotes: " + lots->lastError().text();
+            qCritical() << error;
+            emit errorOccurred(error);
+            rollbackTransaction();
+            return false;
+        }
+    }
+    if (deleted && !logChange("delete", id, site, QVariant(), QJsonObject{{"id", id}})) {
+        rollbackTransaction();
+        return false;
+    }
+    if (!commitTransaction()) {
         return false;
     }
     
-    bool deleted = query.numRowsAffected() > 0;
     if (deleted) {
-        emit dataChanged();
+        notifyDataChanged();
     }
     return deleted;
 }
 
-Component DatabaseManager::getComponentById(int id) {
+Component DatabaseManager::getComponentById(int id, const QString& site) {
+    if (!checkSiteId(id, site, false)) {
+        return Component();
+    }
+    
     QSqlQuery query(db);
     
-    query.prepare("SELECT * FROM componentes WHERE id = :id");
+    query.prepare("SELECT * FROM " + tableFor(site) + " WHERE id = :id");
     query.bindValue(":id", id);
     
     if (!query.exec() || !query.next()) {
@@ -161,7 +838,11 @@ Component DatabaseManager::getComponentById(int id) {
         return Component();
     }
     
-    return queryToComponent(query);
+    Component component = queryToComponent(query);
+    if (!site.isEmpty() && site != kMainSite) {
+        component.setSite(site);
+    }
+    return component;
 }
 
 QVector<Component> DatabaseManager::getAllComponents() {
@@ -241,44 +922,1026 @@ QVector<Component> DatabaseManager::getLowStockComponents(int threshold) {
     return components;
 }
 
-bool DatabaseManager::updateQuantity(int id, int delta) {
+QVector<Component> DatabaseManager::getComponentsByIds(const QVector<int>& ids) {
+    QVector<Component> components;
+    if (ids.isEmpty()) {
+        return components;
+    }
+    
+    // Los IDs son enteros propios, se pueden incrustar sin riesgo de inyección
+    QStringList idList;
+    for (int id : ids) {
+        idList << QString::number(id);
+    }
+    
+    QSqlQuery query(db);
+    if (!query.exec("SELECT * FROM componentes WHERE id IN (" + idList.join(',') + ")")) {
+        QString error = "Error obteniendo componentes: " + query.lastError().text();
+        qCritical() << error;
+        emit errorOccurred(error);
+        return components;
+    }
+    
+    QHash<int, Component> byId;
+    while (query.next()) {
+        Component component = queryToComponent(query);
+        byId.insert(component.getId(), component);
+    }
+    
+    // Conservar el orden pedido (p. ej. el ranking de la búsqueda aproximada)
+    for (int id : ids) {
+        auto it = byId.constFind(id);
+        if (it != byId.constEnd()) {
+            components.append(it.value());
+        }
+    }
+    return components;
+}
+
+ComponentPage DatabaseManager::getComponentsPage(const ComponentQuery& filter,
+                                                 const QString& pageToken, int limit) {
+    ComponentPage page;
+    queryPage(filter, pageToken, limit, &page);
+    return page;
+}
+
+bool DatabaseManager::visitComponents(const ComponentQuery& filter,
+                                      const std::function<bool(const Component&)>& visitor,
+                                      int batchSize) {
+    QString token;
+    do {
+        // Cada lote es una consulta corta: no se retiene la lectura mientras
+        // trabaja el visitante, que puede incluso modificar el inventario
+        ComponentPage page;
+        if (!queryPage(filter, token, batchSize, &page)) {
+            return false;
+        }
+        for (const Component& component : page.components) {
+            if (!visitor(component)) {
+                return true;
+            }
+        }
+        token = page.nextToken;
+    } while (!token.isEmpty());
+    return true;
+}
+
+bool DatabaseManager::queryPage(const ComponentQuery& filter, const QString& pageToken,
+                                int limit, ComponentPage* page) {
+    limit = qBound(1, limit, 10000);
+    QStringList conditions;
+    QString lastName;
+    int lastId = 0;
+    
+    if (!pageToken.isEmpty()) {
+        if (!decodePageToken(pageToken, &lastName, &lastId)) {
+            QString error = "Token de página no válido";
+            qCritical() << error;
+            emit errorOccurred(error);
+            return false;
+        }
+        // Comparación de filas: SQLite la resuelve como rango sobre idx_componentes_name_id
+        conditions << "(name, id) > (:lastName, :lastId)";
+    }
+    if (!filter.searchText.isEmpty()) {
+        conditions << "(name LIKE :search OR type LIKE :search OR location LIKE :search)";
+    }
+    if (filter.maxQuantity >= 0) {
+        conditions << "quantity <= :threshold";
+    }
+    
+    QString sql = "SELECT * FROM componentes";
+    if (!conditions.isEmpty()) {
+        sql += " WHERE " + conditions.join(" AND ");
+    }
+    sql += " ORDER BY name, id LIMIT :limit";
+    
     QSqlQuery query(db);
+    query.setForwardOnly(true);
+    query.prepare(sql);
+    if (!pageToken.isEmpty()) {
+        query.bindValue(":lastName", lastName);
+        query.bindValue(":lastId", lastId);
+    }
+    if (!filter.searchText.isEmpty()) {
+        query.bindValue(":search", "%" + filter.searchText + "%");
+    }
+    if (filter.maxQuantity >= 0) {
+        query.bindValue(":threshold", filter.maxQuantity);
+    }
+    query.bindValue(":limit", limit + 1);   // Una fila de más indica que hay página siguiente
+    
+    if (!query.exec()) {
+        QString error = "Error obteniendo página de componentes: " + query.lastError().text();
+        qCritical() << error;
+        emit errorOccurred(error);
+        return false;
+    }
+    
+    page->components.reserve(limit + 1);
+    while (query.next()) {
+        page->components.append(queryToComponent(query));
+    }
+    query.finish();
+    
+    if (page->components.size() > limit) {
+        page->components.removeLast();
+        const Component& last = page->components.constLast();
+        page->nextToken = encodePageToken(last.getName(), last.getId());
+    }
+    return true;
+}
+
+bool DatabaseManager::updateQuantity(int id, int delta, const QString& site, int* newQuantity,
+                                     const QDate& purchaseDate, double unitCost,
+                                     QVector<LotShift>* lotShifts) {
+    if (!checkSiteId(id, site) || !beginTransaction()) {
+        return false;
+    }
+    
+    const QString table = tableFor(site);
+    auto select = preparedQuery("SELECT quantity FROM " + table + " WHERE id = :id");
+    auto query = preparedQuery("UPDATE " + table + " SET quantity = :quantity WHERE id = :id");
+    if (!select || !query) {
+        rollbackTransaction();
+        return false;
+    }
     
     // Obtener cantidad actual
-    query.prepare("SELECT quantity FROM componentes WHERE id = :id");
-    query.bindValue(":id", id);
+    select->bindValue(":id", id);
     
-    if (!query.exec() || !query.next()) {
+    if (!select->exec() || !select->next()) {
+        select->finish();
         QString error = "Componente no encontrado para actualizar cantidad, ID: " + QString::number(id);
         qCritical() << error;
         emit errorOccurred(error);
+        rollbackTransaction();
         return false;
     }
     
-    int currentQty = query.value(0).toInt();
+    int currentQty = select->value(0).toInt();
+    select->finish();
     int newQty = currentQty + delta;
     
     if (newQty < 0) {
         QString error = "No se puede tener cantidad negativa para componente ID: " + QString::number(id);
         qWarning() << error;
         emit errorOccurred(error);
+        rollbackTransaction();
         return false;
     }
     
-    query.prepare("UPDATE componentes SET quantity = :quantity WHERE id = :id");
-    query.bindValue(":quantity", newQty);
-    query.bindValue(":id", id);
+    query->bindValue(":quantity", newQty);
+    query->bindValue(":id", id);
     
-    if (!query.exec()) {
-        QString error = "Error actualizando cantidad: " + query.lastError().text();
+    if (!query->exec()) {
+        QString error = "Error actualizando cantidad: " + query->lastError().text();
         qCritical() << error;
         emit errorOccurred(error);
+        rollbackTransaction();
         return false;
     }
     
-    qDebug() << "Cantidad actualizada, ID:" << id << "de" << currentQty << "a" << newQty;
-    emit dataChanged();
-    return true;
+    // Los lotes solo se llevan en la sede principal
+    if (isMainSite(site) && !shiftLots(id, delta, purchaseDate, unitCost, lotShifts)) {
+        rollbackTransaction();
+        return false;
+    }
+    
+    if (!logChange("quantity", id, site, delta,
+                   QJsonObject{{"id", id}, {"from", currentQty}, {"to", newQty}})) {
+        rollbackTransaction();
+        return false;
+    }
+    if (!commitTransaction()) {
+        return false;
+    }
+    
+    qDebug() << "Cantidad actualizada, ID:" << id << "de" << currentQty << "a" << newQty;
+    if (newQuantity) {
+        *newQuantity = newQty;
+    }
+    notifyDataChanged();
+    return true;
+}
+
+bool DatabaseManager::shiftLots(int componentId, int delta, const QDate& purchaseDate,
+                                double unitCost, QVector<LotShift>* shifts) {
+    if (shifts && !shifts->isEmpty()) {
+        return applyLotShifts(componentId, delta, *shifts);
+    }
+    if (delta == 0) {
+        return true;
+    }
+    
+    if (delta > 0) {
+        const QDate date = purchaseDate.isValid() ? purchaseDate : QDate::currentDate();
+        auto insert = preparedQuery(
+            "INSERT INTO lotes (component_id, received, remaining, purchase_day, unit_cost) "
+            "VALUES (:component, :quantity, :quantity, :day, :cost)");
+        if (!insert) {
+            return false;
+        }
+        insert->bindValue(":component", componentId);
+        insert->bindValue(":quantity", delta);
+        insert->bindValue(":day", date.toJulianDay());
+        insert->bindValue(":cost", unitCost);
+        if (!insert->exec()) {
+            QString error = "Error registrando lote: " + insert->lastError().text();
+            qCritical() << error;
+            emit errorOccurred(error);
+            return false;
+        }
+        if (shifts) {
+            shifts->append({insert->lastInsertId().toLongLong(), delta, true, delta, date, unitCost});
+        }
+        return true;
+    }
+    
+    // Salida FIFO: se vacían primero los lotes comprados antes
+    int pending = -delta;
+    QVector<QPair<qint64, int>> updates;   // lote -> existencias restantes
+    QVector<LotShift> taken;
+    auto select = preparedQuery("SELECT id, remaining FROM lotes "
+                                "WHERE component_id = :component AND remaining > 0 "
+                                "ORDER BY purchase_day, id");
+    auto query = preparedQuery("UPDATE lotes SET remaining = :remaining WHERE id = :id");
+    if (!select || !query) {
+        return false;
+    }
+    select->bindValue(":component", componentId);
+    if (!select->exec()) {
+        QString error = "Error leyendo lotes: " + select->lastError().text();
+        qCritical() << error;
+        emit errorOccurred(error);
+        return false;
+    }
+    while (pending > 0 && select->next()) {
+        const int remaining = select->value(1).toInt();
+        const int units = qMin(remaining, pending);
+        updates.append({select->value(0).toLongLong(), remaining - units});
+        taken.append({select->value(0).toLongLong(), -units, false, 0, QDate(), 0.0});
+        pending -= units;
+    }
+    select->finish();
+    
+    // Los lotes deben sumar la cantidad: si no la cubren, el retiro no se aplica
+    if (pending > 0) {
+        QString error = QString("Lotes insuficientes para el componente %1: faltan %2 unidades")
+            .arg(componentId).arg(pending);
+        qCritical() << error;
+        emit errorOccurred(error);
+        return false;
+    }
+    
+    for (const auto& update : updates) {
+        query->bindValue(":remaining", update.second);
+        query->bindValue(":id", update.first);
+        if (!query->exec()) {
+            QString error = "Error consumiendo lote: " + query->lastError().text();
+            qCritical() << error;
+            emit errorOccurred(error);
+            return false;
+        }
+    }
+    if (shifts) {
+        *shifts = taken;
+    }
+    return true;
+}
+
+bool DatabaseManager::applyLotShifts(int componentId, int delta, const QVector<LotShift>& shifts) {
+    int total = 0;
+    for (const LotShift& shift : shifts) {
+        total += shift.units;
+    }
+    if (total != delta) {
+        QString error = QString("Los lotes registrados no suman la variación del componente %1")
+            .arg(componentId);
+        qCritical() << error;
+        emit errorOccurred(error);
+        return false;
+    }
+    
+    auto create = preparedQuery(
+        "INSERT INTO lotes (id, component_id, received, remaining, purchase_day, unit_cost) "
+        "VALUES (:id, :component, :received, :units, :day, :cost)");
+    // Un lote solo se elimina entero si nadie lo ha tocado desde que se registró
+    auto drop = preparedQuery("DELETE FROM lotes WHERE id = :id AND component_id = :component "
+                              "AND received = :received AND remaining = :units");
+    auto move = preparedQuery("UPDATE lotes SET remaining = remaining + :units "
+                              "WHERE id = :id AND component_id = :component "
+                              "AND remaining + :units BETWEEN 0 AND received");
+    if (!create || !drop || !move) {
+        return false;
+    }
+    
+    for (const LotShift& shift : shifts) {
+        QSqlQuery* query = move.get();
+        if (shift.wholeLot) {
+            query = shift.units >= 0 ? create.get() : drop.get();
+            query->bindValue(":received", shift.received);
+            query->bindValue(":units", qAbs(shift.units));
+            if (query == create.get()) {
+                query->bindValue(":day", shift.purchaseDate.toJulianDay());
+                query->bindValue(":cost", shift.unitCost);
+            }
+        } else {
+            query->bindValue(":units", shift.units);
+        }
+        query->bindValue(":id", shift.lotId);
+        query->bindValue(":component", componentId);
+        
+        if (!query->exec()) {
+            QString error = "Error moviendo lote: " + query->lastError().text();
+            qCritical() << error;
+            emit errorOccurred(error);
+            return false;
+        }
+        if (query->numRowsAffected() != 1) {
+            QString error = QString("El lote %1 ha cambiado desde la operación original")
+                .arg(shift.lotId);
+            qWarning() << error;
+            emit errorOccurred(error);
+            return false;
+        }
+    }
+    return true;
+}
+
+QVector<Lot> DatabaseManager::queryLots(QSqlQuery& query) {
+    QVector<Lot> lots;
+    if (!query.exec()) {
+        QString error = "Error consultando lotes: " + query.lastError().text();
+        qCritical() << error;
+        emit errorOccurred(error);
+        return lots;
+    }
+    
+    while (query.next()) {
+        Lot lot;
+        lot.id = query.value(0).toLongLong();
+        lot.componentId = query.value(1).toInt();
+        lot.received = query.value(2).toInt();
+        lot.remaining = query.value(3).toInt();
+        lot.purchaseDate = QDate::fromJulianDay(query.value(4).toLongLong());
+        lot.unitCost = query.value(5).toDouble();
+        lots.append(lot);
+    }
+    return lots;
+}
+
+QVector<Lot> DatabaseManager::getLots(int componentId, bool openOnly) {
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    query.prepare(QString("SELECT id, component_id, received, remaining, purchase_day, unit_cost "
+                          "FROM lotes WHERE component_id = :component %1"
+                          "ORDER BY purchase_day, id")
+                  .arg(openOnly ? "AND remaining > 0 " : ""));
+    query.bindValue(":component", componentId);
+    return queryLots(query);
+}
+
+QVector<Lot> DatabaseManager::getLotsPurchasedBetween(const QDate& from, const QDate& to, int limit) {
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    query.prepare("SELECT id, component_id, received, remaining, purchase_day, unit_cost "
+                  "FROM lotes WHERE purchase_day BETWEEN :from AND :to "
+                  "ORDER BY purchase_day, id LIMIT :limit");
+    query.bindValue(":from", from.toJulianDay());
+    query.bindValue(":to", to.toJulianDay());
+    query.bindValue(":limit", limit);
+    return queryLots(query);
+}
+
+QVector<Lot> DatabaseManager::getOldestLots(int limit) {
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    query.prepare("SELECT id, component_id, received, remaining, purchase_day, unit_cost "
+                  "FROM lotes WHERE remaining > 0 "
+                  "ORDER BY purchase_day, id LIMIT :limit");
+    query.bindValue(":limit", limit);
+    return queryLots(query);
+}
+
+bool DatabaseManager::restoreLots(const QVector<Lot>& lots) {
+    if (!beginTransaction()) {
+        return false;
+    }
+    
+    QSqlQuery query(db);
+    if (!query.exec("DELETE FROM lotes")) {
+        QString error = "Error restaurando lotes: " + query.lastError().text();
+        qCritical() << error;
+        emit errorOccurred(error);
+        rollbackTransaction();
+        return false;
+    }
+    
+    query.prepare("INSERT INTO lotes (id, component_id, received, remaining, purchase_day, unit_cost) "
+                  "VALUES (:id, :component, :received, :remaining, :day, :cost)");
+    for (const Lot& lot : lots) {
+        query.bindValue(":id", lot.id);
+        query.bindValue(":component", lot.componentId);
+        query.bindValue(":received", lot.received);
+        query.bindValue(":remaining", lot.remaining);
+        query.bindValue(":day", lot.purchaseDate.toJulianDay());
+        query.bindValue(":cost", lot.unitCost);
+        if (!query.exec()) {
+            QString error = "Error restaurando lotes: " + query.lastError().text();
+            qCritical() << error;
+            emit errorOccurred(error);
+            rollbackTransaction();
+            return false;
+        }
+    }
+    return commitTransaction();
+}
+
+LotTotals DatabaseManager::getPurchaseTotals(const QDate& from, const QDate& to) {
+    LotTotals totals;
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    
+    // Solo columnas de idx_lotes_day_id: se responde recorriendo el índice
+    query.prepare("SELECT COUNT(*), TOTAL(received), TOTAL(remaining), TOTAL(received * unit_cost) "
+                  "FROM lotes WHERE purchase_day BETWEEN :from AND :to");
+    query.bindValue(":from", from.toJulianDay());
+    query.bindValue(":to", to.toJulianDay());
+    
+    if (!query.exec() || !query.next()) {
+        QString error = "Error sumando lotes: " + query.lastError().text();
+        qCritical() << error;
+        emit errorOccurred(error);
+        return totals;
+    }
+    
+    totals.lots = query.value(0).toInt();
+    totals.received = qint64(query.value(1).toDouble());
+    totals.remaining = qint64(query.value(2).toDouble());
+    totals.cost = query.value(3).toDouble();
+    return totals;
+}
+
+QVector<QVector<Component>> DatabaseManager::queryEachSite(const QString& sql,
+                                                           const QVariantMap& binds) {
+    // Cada sede se consulta en un hilo del pool con su propia conexión al archivo,
+    // sin pasar por la conexión principal
+    QVector<QFuture<QVector<Component>>> futures;
+    for (auto it = sitePaths.constBegin(); it != sitePaths.constEnd(); ++it) {
+        const QString site = it.key();
+        const QString path = it.value();
+        futures.append(QtConcurrent::run([site, path, sql, binds]() {
+            QVector<Component> components;
+            {
+                QSqlQuery query(DatabaseManager::connectionForThread(path));
+                query.setForwardOnly(true);
+                query.prepare(sql);
+                for (auto b = binds.constBegin(); b != binds.constEnd(); ++b) {
+                    query.bindValue(b.key(), b.value());
+                }
+                if (!query.exec()) {
+                    qCritical() << "Error consultando sede" << site << ":" << query.lastError().text();
+                }
+                while (query.isActive() && query.next()) {
+                    Component component = queryToComponent(query);
+                    component.setSite(site);
+                    components.append(component);
+                }
+            }
+            // La conexión es de esta tarea, no del hilo del pool que la ejecutó
+            DatabaseManager::releaseThreadConnection(path);
+            return components;
+        }));
+    }
+    
+    QVector<QVector<Component>> results;
+    for (QFuture<QVector<Component>>& future : futures) {
+        results.append(future.result());
+    }
+    return results;
+}
+
+/// Une los resultados ya ordenados de cada sede conservando el orden global
+template <typename Less>
+static QVector<Component> mergeSorted(const QVector<QVector<Component>>& parts, Less less) {
+    QVector<Component> merged;
+    for (const QVector<Component>& part : parts) {
+        const int middle = merged.size();
+        merged += part;
+        std::inplace_merge(merged.begin(), merged.begin() + middle, merged.end(), less);
+    }
+    return merged;
+}
+
+QVector<Component> DatabaseManager::searchAllSites(const QString& searchText) {
+    QVariantMap binds;
+    binds.insert(":search", "%" + searchText + "%");
+    
+    QVector<Component> components = mergeSorted(
+        queryEachSite("SELECT * FROM componentes WHERE "
+                      "name LIKE :search OR type LIKE :search OR location LIKE :search "
+                      "ORDER BY name", binds),
+        [](const Component& a, const Component& b) { return a.getName() < b.getName(); });
+    
+    qDebug() << "Búsqueda en" << sitePaths.size() << "sedes:" << components.size() << "resultados";
+    return components;
+}
+
+QVector<Component> DatabaseManager::getLowStockAllSites(int threshold) {
+    QVariantMap binds;
+    binds.insert(":threshold", threshold);
+    
+    QVector<Component> components = mergeSorted(
+        queryEachSite("SELECT * FROM componentes WHERE quantity <= :threshold "
+                      "ORDER BY quantity", binds),
+        [](const Component& a, const Component& b) { return a.getQuantity() < b.getQuantity(); });
+    
+    if (!components.isEmpty()) {
+        qWarning() << "¡ALERTA!" << components.size() << "componentes con stock bajo en todas las sedes";
+    }
+    return components;
+}
+
+QMap<QString, SiteTotals> DatabaseManager::getSiteTotals() {
+    QMap<QString, QFuture<SiteTotals>> futures;
+    for (auto it = sitePaths.constBegin(); it != sitePaths.constEnd(); ++it) {
+        const QString path = it.value();
+        futures.insert(it.key(), QtConcurrent::run([path]() {
+            SiteTotals totals;
+            {
+                QSqlQuery query(DatabaseManager::connectionForThread(path));
+                if (query.exec("SELECT COUNT(*), COALESCE(SUM(quantity), 0) FROM componentes") &&
+                    query.next()) {
+                    totals.components = query.value(0).toInt();
+                    totals.units = query.value(1).toLongLong();
+                }
+            }
+            DatabaseManager::releaseThreadConnection(path);
+            return totals;
+        }));
+    }
+    
+    QMap<QString, SiteTotals> totals;
+    for (auto it = futures.begin(); it != futures.end(); ++it) {
+        totals.insert(it.key(), it.value().result());
+    }
+    return totals;
+}
+
+QVector<Reservation> DatabaseManager::getReservations() {
+    QVector<Reservation> reservations;
+    QSqlQuery query(db);
+    
+    if (!query.exec("SELECT id, component_id, quantity, project, created_at FROM reservas")) {
+        QString error = "Error obteniendo reservas: " + query.lastError().text();
+        qCritical() << error;
+        emit errorOccurred(error);
+        return reservations;
+    }
+    
+    while (query.next()) {
+        Reservation reservation;
+        reservation.id = query.value(0).toLongLong();
+        reservation.componentId = query.value(1).toInt();
+        reservation.quantity = query.value(2).toInt();
+        reservation.project = query.value(3).toString();
+        reservation.createdAt = QDateTime::fromString(query.value(4).toString(), Qt::ISODate);
+        reservations.append(reservation);
+    }
+    
+    return reservations;
+}
+
+QVector<QPair<int, int>> DatabaseManager::getQuantities() {
+    QVector<QPair<int, int>> quantities;
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    
+    if (!query.exec("SELECT id, quantity FROM componentes")) {
+        QString error = "Error obteniendo cantidades: " + query.lastError().text();
+        qCritical() << error;
+        emit errorOccurred(error);
+        return quantities;
+    }
+    
+    while (query.next()) {
+        quantities.append(qMakePair(query.value(0).toInt(), query.value(1).toInt()));
+    }
+    return quantities;
+}
+
+bool DatabaseManager::persistReservations(const QVector<Reservation>& added,
+                                          const QVector<qint64>& removed,
+                                          const QHash<int, int>& consumed) {
+    if (!beginTransaction()) {
+        return false;
+    }
+    
+    QSqlQuery insert(db);
+    insert.prepare("INSERT OR REPLACE INTO reservas (id, component_id, quantity, project, created_at) "
+                   "VALUES (:id, :component, :quantity, :project, :created)");
+    QSqlQuery remove(db);
+    remove.prepare("DELETE FROM reservas WHERE id = :id");
+    QSqlQuery current(db);
+    current.prepare("SELECT quantity FROM componentes WHERE id = :id");
+    QSqlQuery consume(db);
+    consume.prepare("UPDATE componentes SET quantity = quantity - :quantity WHERE id = :id");
+    
+    bool ok = true;
+    QSqlError failure;
+    for (const Reservation& reservation : added) {
+        insert.bindValue(":id", reservation.id);
+        insert.bindValue(":component", reservation.componentId);
+        insert.bindValue(":quantity", reservation.quantity);
+        insert.bindValue(":project", reservation.project);
+        insert.bindValue(":created", reservation.createdAt.toString(Qt::ISODate));
+        if (ok && !insert.exec()) {
+            ok = false;
+            failure = insert.lastError();
+        }
+    }
+    for (qint64 id : removed) {
+        remove.bindValue(":id", id);
+        if (ok && !remove.exec()) {
+            ok = false;
+            failure = remove.lastError();
+        }
+    }
+    for (auto it = consumed.constBegin(); ok && it != consumed.constEnd(); ++it) {
+        // Cantidad previa para anotar from/to como cualquier otro cambio de cantidad
+        current.bindValue(":id", it.key());
+        if (!current.exec() || !current.next()) {
+            ok = false;
+            failure = current.lastError().isValid()
+                ? current.lastError()
+                : QSqlError(QString(), QString("componente %1 no encontrado").arg(it.key()));
+            break;
+        }
+        const int from = current.value(0).toInt();
+        current.finish();
+        
+        consume.bindValue(":quantity", it.value());
+        consume.bindValue(":id", it.key());
+        if (!consume.exec()) {
+            ok = false;
+            failure = consume.lastError();
+            break;
+        }
+        if (!shiftLots(it.key(), -it.value(), QDate(), 0.0)) {
+            ok = false;
+            failure = QSqlError(QString(), QString("lotes del componente %1").arg(it.key()));
+            break;
+        }
+        if (!logChange("quantity", it.key(), QString(), -it.value(),
+                       QJsonObject{{"id", it.key()}, {"from", from}, {"to", from - it.value()},
+                                   {"reservation", true}})) {
+            ok = false;
+            failure = QSqlError(QString(), QString("registro de cambios del componente %1").arg(it.key()));
+            break;
+        }
+    }
+    
+    if (!ok) {
+        QString error = "Error guardando lote de reservas: " + failure.text();
+        qCritical() << error;
+        emit errorOccurred(error);
+        rollbackTransaction();
+        return false;
+    }
+    if (!commitTransaction()) {
+        return false;
+    }
+    
+    qDebug() << "Reservas guardadas:" << added.size() << "nuevas," << removed.size()
+             << "cerradas," << consumed.size() << "componentes consumidos";
+    if (!consumed.isEmpty()) {
+        notifyDataChanged();
+    }
+    return true;
+}
+
+QHash<int, ConsumptionState> DatabaseManager::getConsumptionStates() {
+    QHash<int, ConsumptionState> states;
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    
+    if (!query.exec("SELECT component_id, decayed_units, last_event_ms, first_event_ms FROM consumo")) {
+        QString error = "Error obteniendo consumo: " + query.lastError().text();
+        qCritical() << error;
+        emit errorOccurred(error);
+        return states;
+    }
+    
+    while (query.next()) {
+        ConsumptionState state;
+        state.decayedUnits = query.value(1).toDouble();
+        state.lastEventMs = query.value(2).toLongLong();
+        state.firstEventMs = query.value(3).toLongLong();
+        states.insert(query.value(0).toInt(), state);
+    }
+    return states;
+}
+
+bool DatabaseManager::saveConsumptionStates(const QHash<int, ConsumptionState>& changed,
+                                            const QVector<int>& removed) {
+    if (!beginTransaction()) {
+        return false;
+    }
+    
+    QSqlQuery upsert(db);
+    upsert.prepare("INSERT OR REPLACE INTO consumo "
+                   "(component_id, decayed_units, last_event_ms, first_event_ms) "
+                   "VALUES (:id, :units, :last, :first)");
+    QSqlQuery remove(db);
+    remove.prepare("DELETE FROM consumo WHERE component_id = :id");
+    
+    bool ok = true;
+    for (auto it = changed.constBegin(); it != changed.constEnd() && ok; ++it) {
+        upsert.bindValue(":id", it.key());
+        upsert.bindValue(":units", it->decayedUnits);
+        upsert.bindValue(":last", it->lastEventMs);
+        upsert.bindValue(":first", it->firstEventMs);
+        ok = upsert.exec();
+    }
+    for (int i = 0; i < removed.size() && ok; ++i) {
+        remove.bindValue(":id", removed[i]);
+        ok = remove.exec();
+    }
+    
+    if (!ok) {
+        QString error = "Error guardando consumo: " + db.lastError().text();
+        qCritical() << error;
+        emit errorOccurred(error);
+        rollbackTransaction();
+        return false;
+    }
+    return commitTransaction();
+}
+
+bool DatabaseManager::beginTransaction() {
+    // Transacciones anidables: solo la más externa abre y confirma en SQLite
+    if (transactionDepth == 0) {
+        if (!db.transaction()) {
+            QString error = "No se pudo iniciar la transacción: " + db.lastError().text();
+            qCritical() << error;
+            emit errorOccurred(error);
+            return false;
+        }
+        transactionFailed = false;
+    }
+    ++transactionDepth;
+    return true;
+}
+
+bool DatabaseManager::commitTransaction() {
+    if (transactionDepth == 0) {
+        return false;
+    }
+    if (--transactionDepth > 0) {
+        return !transactionFailed;
+    }
+    
+    if (transactionFailed || !db.commit()) {
+        if (!transactionFailed) {
+            QString error = "Error confirmando la transacción: " + db.lastError().text();
+            qCritical() << error;
+            emit errorOccurred(error);
+        }
+        db.rollback();
+        pendingDataChanged = false;
+        pendingChangeSeq = 0;
+        pendingRelaySites.clear();
+        return false;
+    }
+    
+    // Las señales se emiten una sola vez, con los datos ya confirmados
+    if (pendingChangeSeq > 0) {
+        qint64 seq = pendingChangeSeq;
+        pendingChangeSeq = 0;
+        emit changesAvailable(seq);
+    }
+    if (pendingDataChanged) {
+        pendingDataChanged = false;
+        emit dataChanged();
+    }
+    
+    // Con el cambio ya confirmado en el archivo de la sede, copiarlo al registro
+    // principal (si falla, se reintenta con el próximo cambio de esa sede o al adjuntarla)
+    const QSet<QString> relaySites = pendingRelaySites;
+    pendingRelaySites.clear();
+    for (const QString& site : relaySites) {
+        relaySiteChanges(site);
+    }
+    return true;
+}
+
+void DatabaseManager::rollbackTransaction() {
+    if (transactionDepth == 0) {
+        return;
+    }
+    if (--transactionDepth > 0) {
+        transactionFailed = true;   // La transacción externa deberá deshacerse
+        return;
+    }
+    db.rollback();
+    pendingDataChanged = false;
+    pendingChangeSeq = 0;
+    pendingRelaySites.clear();
+}
+
+void DatabaseManager::notifyDataChanged() {
+    if (transactionDepth > 0) {
+        pendingDataChanged = true;
+    } else {
+        emit dataChanged();
+    }
+}
+
+bool DatabaseManager::logChange(const QString& op, int componentId, const QString& site,
+                                const QVariant& delta, const QJsonObject& payload) {
+    // Cada cambio se anota en el archivo de su dato: así ambos se confirman juntos
+    const bool mainSite = isMainSite(site);
+    auto query = preparedQuery(mainSite
+        ? "INSERT INTO cambios (op, component_id, site, delta, payload, created_at) "
+          "VALUES (:op, :component, :site, :delta, :payload, :created)"
+        : "INSERT INTO site_" + site + ".cambios_sede (op, component_id, delta, payload, created_at) "
+          "VALUES (:op, :component, :delta, :payload, :created)"
+    );
+    if (!query) {
+        return false;
+    }
+    query->bindValue(":op", op);
+    query->bindValue(":component", componentId);
+    if (mainSite) {
+        query->bindValue(":site", kMainSite);
+    }
+    query->bindValue(":delta", delta);
+    query->bindValue(":payload", QString::fromUtf8(QJsonDocument(payload).toJson(QJsonDocument::Compact)));
+    query->bindValue(":created", QDateTime::currentDateTimeUtc().toString(Qt::ISODateWithMs));
+    
+    if (!query->exec()) {
+        QString error = "Error registrando cambio: " + query->lastError().text();
+        qCritical() << error;
+        emit errorOccurred(error);
+        return false;
+    }
+    
+    if (mainSite) {
+        pendingChangeSeq = query->lastInsertId().toLongLong();
+    } else {
+        pendingRelaySites.insert(site);
+    }
+    return true;
+}
+
+bool DatabaseManager::relaySiteChanges(const QString& site) {
+    // Dos pasos, cada uno atómico en un solo archivo: copiar al registro principal y
+    // vaciar lo copiado. Una caída entre ambos deja filas que la próxima copia ignora
+    // gracias al índice único (site, site_seq)
+    const QString outbox = "site_" + site + ".cambios_sede";
+    if (!beginTransaction()) {
+        return false;
+    }
+    auto copy = preparedQuery(
+        "INSERT OR IGNORE INTO cambios (op, component_id, site, delta, payload, created_at, site_seq) "
+        "SELECT op, component_id, :site, delta, payload, created_at, seq FROM " + outbox +
+        " ORDER BY seq"
+    );
+    if (!copy) {
+        rollbackTransaction();
+        return false;
+    }
+    copy->bindValue(":site", site);
+    if (!copy->exec()) {
+        QString error = "Error copiando cambios de la sede " + site + ": " + copy->lastError().text();
+        qCritical() << error;
+        emit errorOccurred(error);
+        rollbackTransaction();
+        return false;
+    }
+    if (copy->numRowsAffected() > 0) {
+        pendingChangeSeq = getLastChangeSeq();
+    }
+    if (!commitTransaction()) {
+        return false;
+    }
+    
+    auto clear = preparedQuery(
+        "DELETE FROM " + outbox + " WHERE seq <= "
+        "(SELECT COALESCE(MAX(site_seq), 0) FROM cambios WHERE site = :site)"
+    );
+    if (!clear) {
+        return false;
+    }
+    clear->bindValue(":site", site);
+    if (!clear->exec()) {
+        // Sin consecuencias: lo ya copiado se ignora en la próxima copia
+        qWarning() << "No se pudo vaciar el registro de la sede" << site << ":"
+                   << clear->lastError().text();
+        return false;
+    }
+    return true;
+}
+
+std::shared_ptr<QSqlQuery> DatabaseManager::preparedQuery(const QString& sql) {
+    // Altas, ajustes, lotes y registro de cambios repiten las mismas sentencias:
+    // se preparan una vez y un deshacer masivo solo vuelve a enlazar valores
+    auto it = preparedStatements.constFind(sql);
+    if (it != preparedStatements.constEnd()) {
+        return it.value();
+    }
+    
+    auto query = std::make_shared<QSqlQuery>(db);
+    query->setForwardOnly(true);
+    if (!query->prepare(sql)) {
+        QString error = "Error preparando consulta: " + query->lastError().text();
+        qCritical() << error;
+        emit errorOccurred(error);
+        return nullptr;
+    }
+    preparedStatements.insert(sql, query);
+    return query;
+}
+
+QVector<ChangeEvent> DatabaseManager::getChangesSince(qint64 seq, int limit) {
+    QString error;
+    QVector<ChangeEvent> changes = readChangesSince(db, seq, limit, &error);
+    if (!error.isEmpty()) {
+        emit errorOccurred(error);
+    }
+    return changes;
+}
+
+QVector<ChangeEvent> DatabaseManager::readChangesSince(const QSqlDatabase& conn, qint64 seq,
+                                                       int limit, QString* error) {
+    QVector<ChangeEvent> changes;
+    QSqlQuery query(conn);
+    query.setForwardOnly(true);
+    
+    query.prepare(
+        "SELECT seq, op, component_id, site, delta, payload, created_at FROM cambios "
+        "WHERE seq > :seq ORDER BY seq LIMIT :limit"
+    );
+    query.bindValue(":seq", seq);
+    query.bindValue(":limit", limit);
+    
+    if (!query.exec()) {
+        const QString message = "Error leyendo el registro de cambios: " + query.lastError().text();
+        qCritical() << message;
+        if (error) {
+            *error = message;
+        }
+        return changes;
+    }
+    
+    while (query.next()) {
+        ChangeEvent change;
+        change.seq = query.value(0).toLongLong();
+        change.op = query.value(1).toString();
+        change.componentId = query.value(2).toInt();
+        change.site = query.value(3).toString();
+        change.delta = query.value(4);
+        change.payload = QJsonDocument::fromJson(query.value(5).toString().toUtf8()).object();
+        change.timestamp = QDateTime::fromString(query.value(6).toString(), Qt::ISODateWithMs);
+        changes.append(change);
+    }
+    
+    return changes;
+}
+
+bool DatabaseManager::pruneChanges(qint64 upToSeq, const QDateTime& olderThan) {
+    QSqlQuery query(db);
+    // created_at es ISO 8601 en UTC: el orden de texto es el cronológico
+    query.prepare(olderThan.isValid()
+                  ? "DELETE FROM cambios WHERE seq <= :seq AND created_at < :cutoff"
+                  : "DELETE FROM cambios WHERE seq <= :seq");
+    query.bindValue(":seq", upToSeq);
+    if (olderThan.isValid()) {
+        query.bindValue(":cutoff", olderThan.toUTC().toString(Qt::ISODateWithMs));
+    }
+    
+    if (!query.exec()) {
+        QString error = "Error depurando el registro de cambios: " + query.lastError().text();
+        qCritical() << error;
+        emit errorOccurred(error);
+        return false;
+    }
+    qDebug() << "Registro de cambios depurado:" << query.numRowsAffected() << "entradas";
+    return true;
+}
+
+qint64 DatabaseManager::getLastChangeSeq() {
+    return readLastChangeSeq(db);
+}
+
+qint64 DatabaseManager::readLastChangeSeq(const QSqlDatabase& conn) {
+    // sqlite_sequence conserva el máximo aunque pruneChanges vacíe la tabla
+    QSqlQuery query(conn);
+    if (!query.exec("SELECT seq FROM sqlite_sequence WHERE name = 'cambios'") || !query.next()) {
+        return 0;
+    }
+    return query.value(0).toLongLong();
 }
 
 Component DatabaseManager::queryToComponent(const QSqlQuery& query) {
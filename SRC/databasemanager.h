@@ -5,9 +5,113 @@
 #include <QSqlDatabase>
 #include <QSqlQuery>
 #include <QVector>
+#include <QMap>
+#include <QStringList>
+#include <QVariantMap>
 #include <QMutex>
+#include <QAtomicInt>
+#include <QHash>
+#include <QSet>
+#include <QDateTime>
+#include <QJsonObject>
+#include <functional>
+#include <memory>
 #include "component.h"
 
+/// Totales agregados de una sede
+struct SiteTotals {
+    int components = 0;
+    qint64 units = 0;
+};
+
+/// Reserva de stock para un proyecto (solo componentes de la sede principal)
+struct Reservation {
+    qint64 id = -1;
+    int componentId = -1;
+    int quantity = 0;
+    QString project;
+    QDateTime createdAt;
+};
+
+/// Lote de compra de un componente de la sede principal; se consume en orden FIFO
+struct Lot {
+    qint64 id = -1;
+    int componentId = -1;
+    int received = 0;
+    int remaining = 0;
+    QDate purchaseDate;      ///< En SQLite, día juliano (INTEGER) para consultas por rango
+    double unitCost = 0.0;
+};
+
+/// Movimiento de un lote por una variación de cantidad; el diario lo guarda para
+/// deshacer y rehacer sobre los mismos lotes
+struct LotShift {
+    qint64 lotId = -1;
+    int units = 0;           ///< Existencias que entran (> 0) o salen (< 0) del lote
+    bool wholeLot = false;   ///< Crea (units >= 0) o elimina (units < 0) el lote entero
+    int received = 0;        ///< Solo wholeLot: datos para recrear el lote
+    QDate purchaseDate;
+    double unitCost = 0.0;
+};
+
+/// Totales de los lotes comprados en un intervalo de fechas
+struct LotTotals {
+    int lots = 0;
+    qint64 received = 0;
+    qint64 remaining = 0;
+    double cost = 0.0;       ///< Coste de lo recibido
+};
+
+/// Consumo acumulado con decaimiento exponencial (ver ReorderForecaster)
+struct ConsumptionState {
+    double decayedUnits = 0.0;
+    qint64 lastEventMs = 0;
+    qint64 firstEventMs = 0;     ///< Inicio de la serie; 0 = desconocido (sin corrección)
+};
+
+/// Entrada del registro de cambios (CDC), con secuencia monótona
+struct ChangeEvent {
+    qint64 seq = 0;
+    QString op;          ///< insert | update | delete | quantity
+    int componentId = -1;
+    QString site;
+    QVariant delta;      ///< Variación de cantidad, nula si no aplica
+    QJsonObject payload;
+    QDateTime timestamp;
+};
+
+/// Filtro de los listados paginados, siempre ordenados por (name, id)
+struct ComponentQuery {
+    QString searchText;      ///< Vacío = sin filtro de texto (LIKE en nombre, tipo o ubicación)
+    int maxQuantity = -1;    ///< >= 0: solo stock bajo (quantity <= maxQuantity)
+};
+
+/// Página de un listado; nextToken vacío cuando no quedan más resultados
+struct ComponentPage {
+    QVector<Component> components;
+    QString nextToken;       ///< Opaco: se pasa tal cual para pedir la página siguiente
+};
+
+/**
+ * Perfiles de ajuste de SQLite (journal, sincronización, caché, mmap).
+ *
+ * Balanced es el predeterminado: con WAL los hilos de HTTP, registro de
+ * cambios y mantenimiento leen mientras la GUI escribe. Antes de existir los
+ * perfiles la BD usaba el journal clásico con synchronous=FULL, que hoy es
+ * Safe y se elige al arrancar (--db-profile safe).
+ *
+ * BulkLoad conserva la durabilidad de Balanced (synchronous=NORMAL): un corte de
+ * luz puede perder las últimas transacciones, no corromper la BD. Difiere en la
+ * caché y en dejar crecer el WAL hasta ~64 MiB entre checkpoints; mientras tanto
+ * las lecturas recorren un WAL más largo, así que conviene volver a Balanced al
+ * terminar la importación.
+ */
+enum class PerformanceProfile {
+    Safe,       ///< Journal clásico y synchronous=FULL: máxima durabilidad; solo al arrancar
+    Balanced,   ///< WAL + synchronous=NORMAL (predeterminado)
+    BulkLoad    ///< WAL con caché de 64 MiB y checkpoint cada 16384 páginas, para importaciones
+};
+
 class DatabaseManager : public QObject {
     Q_OBJECT
     
@@ -15,22 +119,148 @@ public:
    
     static DatabaseManager* getInstance();
     
+    /// Directorio de datos alternativo (p. ej. BD vacía para reproducir trazas);
+    /// debe llamarse antes del primer getInstance()
+    static void setDataDirectory(const QString& dir) { dataDirOverride = dir; }
+    
    
     bool initialize();
     
-    bool addComponent(const Component& component);
-    bool updateComponent(const Component& component);
-    bool deleteComponent(int id);
-    Component getComponentById(int id);
+    /// lotShifts (opcional, sede principal): vacío recibe los lotes tocados; con
+    /// movimientos se aplican exactamente esos en lugar de FIFO (deshacer/rehacer)
+    bool addComponent(const Component& component, int* newId = nullptr,
+                      QVector<LotShift>* lotShifts = nullptr);
+    bool updateComponent(const Component& component, QVector<LotShift>* lotShifts = nullptr);
+    
+    /// Como updateComponent, pero la cantidad varía en quantityDelta en lugar de
+    /// fijarse (deshacer/rehacer una edición sin pisar ajustes posteriores)
+    bool updateComponent(const Component& component, int quantityDelta,
+                         QVector<LotShift>* lotShifts = nullptr);
+    
+    /// lotShifts recibe los lotes eliminados, para recrearlos al deshacer la baja
+    bool deleteComponent(int id, const QString& site = QString(),
+                         QVector<LotShift>* lotShifts = nullptr);
+    
+    /// Reinserta un componente conservando su ID (deshacer una baja)
+    bool restoreComponent(const Component& component, QVector<LotShift>* lotShifts = nullptr);
+    Component getComponentById(int id, const QString& site = QString());
     QVector<Component> getAllComponents();
     QVector<Component> searchComponents(const QString& searchText);
     QVector<Component> getLowStockComponents(int threshold = 5);
+    QVector<Component> getComponentsByIds(const QVector<int>& ids);
+    
+    // Listados paginados por clave (name, id): la memoria queda acotada por página
+    ComponentPage getComponentsPage(const ComponentQuery& filter, const QString& pageToken,
+                                    int limit = 100);
+    
+    /// Recorre los resultados por lotes; el visitante devuelve false para parar
+    bool visitComponents(const ComponentQuery& filter,
+                         const std::function<bool(const Component&)>& visitor,
+                         int batchSize = 256);
     
 
-    bool updateQuantity(int id, int delta);
+    /// Una entrada (delta > 0) crea un lote; una salida consume los más antiguos primero
+    /// y falla si los lotes no cubren el retiro. lotShifts como en updateComponent
+    bool updateQuantity(int id, int delta, const QString& site = QString(),
+                        int* newQuantity = nullptr, const QDate& purchaseDate = QDate(),
+                        double unitCost = 0.0, QVector<LotShift>* lotShifts = nullptr);
+    
+    // Lotes de compra (sede principal); las fechas usan índices por día juliano
+    QVector<Lot> getLots(int componentId, bool openOnly = true);
+    QVector<Lot> getLotsPurchasedBetween(const QDate& from, const QDate& to, int limit = 1000);
+    QVector<Lot> getOldestLots(int limit = 100);
+    
+    /// Sustituye todos los lotes por los indicados conservando sus IDs (reproducción de trazas)
+    bool restoreLots(const QVector<Lot>& lots);
+    LotTotals getPurchaseTotals(const QDate& from, const QDate& to);
+    
+    QString getDatabasePath() const { return dbPath; }
+    QString getSitesDirectory() const { return sitesDir; }
+    
+    /// Archivo de una sede (vacío si el nombre no es válido); no depende de qué
+    /// sedes estén adjuntas, así que puede llamarse desde cualquier hilo
+    QString getSitePath(const QString& site) const;
+    
+    /// Cambia el perfil en caliente (fuera de transacciones), p. ej. BulkLoad para importar.
+    /// Cambiar el modo de journal (Safe) solo se admite antes de initialize(): salir de
+    /// WAL exige que ninguna otra conexión tenga abierto el archivo
+    bool setPerformanceProfile(PerformanceProfile profile);
+    PerformanceProfile getPerformanceProfile() const { return profile; }
+    
+    /// PRAGMAs de un perfil para el esquema indicado (page_size y auto_vacuum si es nuevo)
+    static QStringList profilePragmas(PerformanceProfile profile, const QString& schema = "main",
+                                      bool newFile = false);
+    
+    // Sedes: cada una en su propio archivo SQLite, adjunto (ATTACH) a la conexión principal.
+    // Las escrituras de todas las sedes pasan por esa conexión y se serializan; solo las
+    // lecturas entre sedes van en paralelo. En WAL una transacción entre archivos no es
+    // atómica, así que cada sede anota sus cambios en su propio archivo (cambios_sede,
+    // en la misma transacción que el dato) y después se copian al registro principal
+    static const QString kMainSite;
+    static bool isMainSite(const QString& site) { return site.isEmpty() || site == kMainSite; }
+    static bool isValidSiteName(const QString& site);
+    bool addSite(const QString& site);
+    QStringList getSites() const { return sitePaths.keys(); }
+    
+    /// Bloque de IDs de una sede (0 = principal, -1 si no está adjunta)
+    int getSiteIdBlock(const QString& site) const {
+        return siteIdBlocks.value(isMainSite(site) ? kMainSite : site, -1);
+    }
+    
+    // Consultas entre sedes: se ejecutan en paralelo, una conexión por archivo
+    QVector<Component> searchAllSites(const QString& searchText);
+    QVector<Component> getLowStockAllSites(int threshold = 5);
+    QMap<QString, SiteTotals> getSiteTotals();
+    
+    // Reservas: se persisten por lotes en una sola transacción
+    QVector<Reservation> getReservations();
+    QVector<QPair<int, int>> getQuantities();   ///< (id, cantidad) de la sede principal
+    bool persistReservations(const QVector<Reservation>& added,
+                             const QVector<qint64>& removed,
+                             const QHash<int, int>& consumed);
+    
+    // Estado del pronóstico de consumo
+    QHash<int, ConsumptionState> getConsumptionStates();
+    bool saveConsumptionStates(const QHash<int, ConsumptionState>& changed,
+                               const QVector<int>& removed);
+    
+    // Registro de cambios para consumidores externos
+    QVector<ChangeEvent> getChangesSince(qint64 seq, int limit = 1000);
+    
+    /// Igual que getChangesSince pero con otra conexión (p. ej. connectionForThread),
+    /// que solo ve cambios confirmados y no compite con la conexión principal
+    static QVector<ChangeEvent> readChangesSince(const QSqlDatabase& conn, qint64 seq,
+                                                 int limit = 1000, QString* error = nullptr);
+    
+    /// Borra hasta upToSeq; con olderThan válido, solo las entradas anteriores
+    bool pruneChanges(qint64 upToSeq, const QDateTime& olderThan = QDateTime());
+    
+    /// Mayor seq emitido (0 si aún no hay cambios); sirve de versión de los datos
+    qint64 getLastChangeSeq();
+    static qint64 readLastChangeSeq(const QSqlDatabase& conn);
+    
+    // Transacciones anidables; las señales se difieren hasta la confirmación externa
+    bool beginTransaction();
+    bool commitTransaction();
+    void rollbackTransaction();
+    
+    /// Conexión propia del hilo actual a la BD indicada (para trabajo en segundo plano)
+    static QSqlDatabase connectionForThread(const QString& path);
+    
+    /// Cierra y elimina la conexión del hilo actual; las tareas del pool la liberan al
+    /// terminar (sin QSqlQuery vivas sobre ella) para no dejar una por hilo y archivo
+    static void releaseThreadConnection(const QString& path);
+    
+    /// Convierte la fila actual de un SELECT * FROM componentes
+    static Component queryToComponent(const QSqlQuery& query);
     
 signals:
 
+    void dataChanged();
+    
+    /// Hay entradas nuevas en el registro de cambios hasta 'lastSeq'
+    void changesAvailable(qint64 lastSeq);
+    
     void errorOccurred(const QString& errorMessage);
     
 private:
@@ -42,13 +272,45 @@ private:
     DatabaseManager(const DatabaseManager&) = delete;
     DatabaseManager& operator=(const DatabaseManager&) = delete;
     
-    bool createTables();
-    Component queryToComponent(const QSqlQuery& query);
+    bool createTables(const QString& schema = "main");
+    bool insertComponent(const Component& component, bool keepId, int* newId,
+                         QVector<LotShift>* lotShifts);
+    bool writeComponent(const Component& component, bool relative, int quantityDelta,
+                        QVector<LotShift>* lotShifts);
+    std::shared_ptr<QSqlQuery> preparedQuery(const QString& sql);
+    bool createLotTables();
+    bool shiftLots(int componentId, int delta, const QDate& purchaseDate, double unitCost,
+                   QVector<LotShift>* shifts = nullptr);
+    bool applyLotShifts(int componentId, int delta, const QVector<LotShift>& shifts);
+    QVector<Lot> queryLots(QSqlQuery& query);
+    bool attachSite(const QString& site, const QString& path);
+    bool applyProfile(const QString& schema, bool newFile);
+    QString tableFor(const QString& site) const;
+    bool checkSiteId(int id, const QString& site, bool report = true);
+    bool queryPage(const ComponentQuery& filter, const QString& pageToken, int limit,
+                   ComponentPage* page);
+    QVector<QVector<Component>> queryEachSite(const QString& sql, const QVariantMap& binds);
+    bool logChange(const QString& op, int componentId, const QString& site,
+                   const QVariant& delta, const QJsonObject& payload);
+    bool relaySiteChanges(const QString& site);
+    void notifyDataChanged();
     
     static DatabaseManager* instance;   ///< Instancia única
     static QMutex mutex;               ///< Mutex para thread-safety
+    static QAtomicInt threadProfile;   ///< Perfil para las conexiones de hilo
+    static QString dataDirOverride;    ///< Vacío = AppDataLocation
     QSqlDatabase db;                   ///< Conexión a BD
     QString dbPath;                    ///< Ruta del archivo de BD
+    QString sitesDir;                  ///< Directorio con un .db por sede
+    QMap<QString, QString> sitePaths;  ///< Sede -> archivo
+    QMap<QString, int> siteIdBlocks;   ///< Sede -> bloque de IDs (id >> kSiteIdBits)
+    PerformanceProfile profile = PerformanceProfile::Balanced;
+    int transactionDepth = 0;
+    bool transactionFailed = false;
+    bool pendingDataChanged = false;
+    qint64 pendingChangeSeq = 0;
+    QSet<QString> pendingRelaySites;   ///< Sedes con cambios anotados por copiar al registro
+    QHash<QString, std::shared_ptr<QSqlQuery>> preparedStatements;  ///< Escrituras preparadas una sola vez
 };
 
 #endif // DATABASEMANAGER_H
@@ -0,0 +1,197 @@
+#include "httploadgen.h"
+#include <QTextStream>
+#include <algorithm>
+
+namespace {
+const char* const kSearchTerms[] = {"res", "cap", "sensor", "esp", "led", "cable", "mod", "trans"};
+}
+
+HttpLoadGenerator::HttpLoadGenerator(const Options& options, QObject* parent)
+    : QObject(parent), options(options), random(QRandomGenerator::securelySeeded()),
+      errors(0), seconds(0.0), running(false), reported(false) {
+    
+    deadline.setSingleShot(true);
+    connect(&deadline, &QTimer::timeout, this, &HttpLoadGenerator::finish);
+    drainDeadline.setSingleShot(true);
+    drainDeadline.setInterval(5000);
+    connect(&drainDeadline, &QTimer::timeout, this, &HttpLoadGenerator::report);
+}
+
+void HttpLoadGenerator::start() {
+    connections.resize(qMax(1, options.connections));
+    latenciesNs.reserve(1 << 20);
+    running = true;
+    clock.start();
+    
+    for (int i = 0; i < connections.size(); ++i) {
+        QTcpSocket* socket = new QTcpSocket(this);
+        socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+        connections[i].socket = socket;
+        
+        connect(socket, &QTcpSocket::connected, this, [this, i]() {
+            fill(connections[i]);
+        });
+        connect(socket, &QTcpSocket::readyRead, this, [this, i]() {
+            readResponses(connections[i]);
+        });
+        auto onError = [this, i](QAbstractSocket::SocketError) {
+            ++errors;
+            if (running && connections[i].sentAt.isEmpty()) {
+                QTextStream(stderr) << "Conexión " << i << ": "
+                                    << connections[i].socket->errorString() << "\n";
+            }
+            if (!running) {
+                maybeReport();
+            }
+        };
+#if QT_VERSION >= QT_VERSION_CHECK(5, 15, 0)
+        connect(socket, &QAbstractSocket::errorOccurred, this, onError);
+#else
+        connect(socket, QOverload<QAbstractSocket::SocketError>::of(&QAbstractSocket::error),
+                this, onError);
+#endif
+        socket->connectToHost(options.host, options.port);
+    }
+    deadline.start(options.durationMs);
+}
+
+QByteArray HttpLoadGenerator::nextRequest(int* count) {
+    *count = 1;
+    const double roll = random.generateDouble();
+    if (roll < options.adjustRatio) {
+        // +1 y -1 al mismo ID en la misma conexión: el servidor los atiende en
+        // orden, así el -1 nunca falla por falta de stock y el stock no deriva
+        const QByteArray path = "POST /components/" +
+                                QByteArray::number(1 + random.bounded(options.maxId)) +
+                                "/adjust HTTP/1.1\r\nHost: localhost\r\n"
+                                "Content-Type: application/json\r\n";
+        QByteArray requests;
+        for (int delta : {1, -1}) {
+            const QByteArray body = "{\"delta\":" + QByteArray::number(delta) +
+                                    ",\"reason\":\"loadgen\"}";
+            requests += path + "Content-Length: " + QByteArray::number(body.size()) +
+                        "\r\n\r\n" + body;
+        }
+        *count = 2;
+        return requests;
+    }
+    if (roll < options.adjustRatio + options.searchRatio) {
+        const int term = random.bounded(int(sizeof(kSearchTerms) / sizeof(kSearchTerms[0])));
+        return QByteArray("GET /components?q=") + kSearchTerms[term] +
+               "&limit=20 HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    }
+    return "GET /components/" + QByteArray::number(1 + random.bounded(options.maxId)) +
+           " HTTP/1.1\r\nHost: localhost\r\n\r\n";
+}
+
+void HttpLoadGenerator::fill(Connection& connection) {
+    if (!running) {
+        return;
+    }
+    // Varias peticiones en un solo write: el servidor las recibe en pipeline
+    QByteArray batch;
+    while (connection.sentAt.size() < options.pipeline) {
+        int count = 0;
+        batch += nextRequest(&count);
+        const qint64 sentAt = clock.nsecsElapsed();
+        for (int i = 0; i < count; ++i) {
+            connection.sentAt.enqueue(sentAt);
+        }
+    }
+    if (!batch.isEmpty()) {
+        connection.socket->write(batch);
+    }
+}
+
+void HttpLoadGenerator::readResponses(Connection& connection) {
+    connection.buffer += connection.socket->readAll();
+    
+    while (!connection.sentAt.isEmpty()) {
+        const int headerEnd = connection.buffer.indexOf("\r\n\r\n");
+        if (headerEnd < 0) {
+            return;
+        }
+        
+        int contentLength = 0;
+        const QList<QByteArray> lines = connection.buffer.left(headerEnd).split('\n');
+        for (const QByteArray& line : lines) {
+            if (line.toLower().startsWith("content-length:")) {
+                contentLength = line.mid(15).trimmed().toInt();
+            }
+        }
+        const int total = headerEnd + 4 + contentLength;
+        if (connection.buffer.size() < total) {
+            return;
+        }
+        
+        // "HTTP/1.1 200 OK": 2xx y 404 (ID inexistente) cuentan como respuesta válida
+        const int status = lines.first().mid(9, 3).toInt();
+        if (status != 200 && status != 404) {
+            ++errors;
+        }
+        const qint64 sentAt = connection.sentAt.dequeue();
+        if (running) {
+            latenciesNs.append(clock.nsecsElapsed() - sentAt);
+        }
+        connection.buffer.remove(0, total);
+    }
+    if (running) {
+        fill(connection);
+    } else {
+        maybeReport();
+    }
+}
+
+void HttpLoadGenerator::finish() {
+    // No se envía nada más, pero se esperan las respuestas en vuelo: cortar la
+    // conexión podría dejar un +1 aplicado sin su -1
+    running = false;
+    seconds = clock.nsecsElapsed() / 1e9;
+    drainDeadline.start();
+    maybeReport();
+}
+
+void HttpLoadGenerator::maybeReport() {
+    for (const Connection& connection : qAsConst(connections)) {
+        if (!connection.sentAt.isEmpty() &&
+            connection.socket->state() == QAbstractSocket::ConnectedState) {
+            return;
+        }
+    }
+    report();
+}
+
+void HttpLoadGenerator::report() {
+    if (reported) {
+        return;
+    }
+    reported = true;
+    drainDeadline.stop();
+    for (Connection& connection : connections) {
+        connection.socket->abort();
+    }
+    
+    std::sort(latenciesNs.begin(), latenciesNs.end());
+    auto percentile = [this](double p) -> double {
+        if (latenciesNs.isEmpty()) {
+            return 0.0;
+        }
+        const int index = qMin(latenciesNs.size() - 1, int(p * latenciesNs.size()));
+        return latenciesNs[index] / 1e3;
+    };
+    
+    QString report;
+    QTextStream out(&report);
+    out << "Conexiones: " << connections.size() << ", pipeline: " << options.pipeline
+        << ", duración: " << QString::number(seconds, 'f', 1) << " s\n"
+        << "Peticiones: " << latenciesNs.size() << " ("
+        << QString::number(latenciesNs.size() / seconds, 'f', 0) << " req/s), errores: "
+        << errors << "\n"
+        << "Latencia (us): p50 " << QString::number(percentile(0.50), 'f', 0)
+        << "  p90 " << QString::number(percentile(0.90), 'f', 0)
+        << "  p99 " << QString::number(percentile(0.99), 'f', 0)
+        << "  p99.9 " << QString::number(percentile(0.999), 'f', 0)
+        << "  máx " << QString::number(latenciesNs.isEmpty() ? 0.0 : latenciesNs.last() / 1e3, 'f', 0)
+        << "\n";
+    emit finished(report);
+}
@@ -0,0 +1,68 @@
+#ifndef HTTPLOADGEN_H
+#define HTTPLOADGEN_H
+
+#include <QObject>
+#include <QTcpSocket>
+#include <QElapsedTimer>
+#include <QTimer>
+#include <QQueue>
+#include <QVector>
+#include <QRandomGenerator>
+
+/**
+ * Generador de carga para HttpService: abre varias conexiones keep-alive y
+ * mantiene en cada una 'pipeline' peticiones en vuelo durante el tiempo
+ * indicado. Mide peticiones/s y latencias (p50 ... p99.9) desde el envío de
+ * cada petición hasta recibir su respuesta completa.
+ */
+class HttpLoadGenerator : public QObject {
+    Q_OBJECT
+
+public:
+    struct Options {
+        QString host = "127.0.0.1";
+        quint16 port = 8080;
+        int connections = 8;
+        int pipeline = 4;            ///< Peticiones en vuelo por conexión
+        int durationMs = 10000;
+        int maxId = 1000;            ///< GET /components/<1..maxId>
+        double searchRatio = 0.2;    ///< Fracción de búsquedas
+        double adjustRatio = 0.0;    ///< Fracción de ajustes: pares +1/-1 al mismo ID, el stock no varía
+    };
+    
+    explicit HttpLoadGenerator(const Options& options, QObject* parent = nullptr);
+    
+    void start();
+
+signals:
+    /// Informe legible para la consola
+    void finished(const QString& report);
+
+private:
+    struct Connection {
+        QTcpSocket* socket = nullptr;
+        QByteArray buffer;
+        QQueue<qint64> sentAt;      ///< ns de envío de cada petición pendiente
+    };
+    
+    void fill(Connection& connection);
+    void readResponses(Connection& connection);
+    QByteArray nextRequest(int* count);
+    void finish();
+    void maybeReport();
+    void report();
+    
+    Options options;
+    QVector<Connection> connections;
+    QElapsedTimer clock;
+    QTimer deadline;
+    QTimer drainDeadline;       ///< Tope para esperar las respuestas en vuelo al terminar
+    QRandomGenerator random;
+    QVector<qint64> latenciesNs;
+    qint64 errors;
+    double seconds;
+    bool running;
+    bool reported;
+};
+
+#endif // HTTPLOADGEN_H
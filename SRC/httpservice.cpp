@@ -0,0 +1,406 @@
+#include "httpservice.h"
+#include "inventory_manager.h"
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QFile>
+#include <QSemaphore>
+#include <QSqlError>
+#include <QUrlQuery>
+#include <QDebug>
+
+namespace {
+QByteArray reasonPhrase(int status) {
+    switch (status) {
+    case 200: return "OK";
+    case 400: return "Bad Request";
+    case 404: return "Not Found";
+    case 405: return "Method Not Allowed";
+    case 409: return "Conflict";
+    case 413: return "Payload Too Large";
+    case 431: return "Request Header Fields Too Large";
+    case 503: return "Service Unavailable";
+    default: return "Internal Server Error";
+    }
+}
+
+QJsonObject componentsJson(QSqlQuery& query) {
+    QJsonArray items;
+    while (query.next()) {
+        items.append(DatabaseManager::queryToComponent(query).toJSON());
+    }
+    query.finish();   // Liberar la instantánea de lectura (en WAL retiene el checkpoint)
+    return QJsonObject{{"components", items}, {"count", items.size()}};
+}
+
+/// Resultado de un ajuste ejecutado en el hilo de InventoryManager
+struct AdjustCall {
+    QSemaphore done;
+    bool ok = false;
+    QString error;
+};
+}
+
+HttpWorker::HttpWorker(InventoryManager* inventory, const QString& dbPath,
+                       const QAtomicInt* stopping)
+    : inventory(inventory), dbPath(dbPath), stopping(stopping) {
+}
+
+void HttpWorker::addConnection(qintptr socketDescriptor) {
+    QTcpSocket* socket = new QTcpSocket(this);
+    if (!socket->setSocketDescriptor(socketDescriptor)) {
+        qWarning() << "Conexión HTTP rechazada:" << socket->errorString();
+        delete socket;
+        return;
+    }
+    socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+    buffers.insert(socket, QByteArray());
+    
+    connect(socket, &QTcpSocket::readyRead, this, [this, socket]() {
+        buffers[socket] += socket->readAll();
+        processBuffer(socket);
+    });
+    connect(socket, &QTcpSocket::bytesWritten, this, [this, socket]() {
+        // Reanudar peticiones en cola que se frenaron por contrapresión
+        if (!buffers.value(socket).isEmpty()) {
+            processBuffer(socket);
+        }
+    });
+    connect(socket, &QTcpSocket::disconnected, this, [this, socket]() {
+        buffers.remove(socket);
+        socket->deleteLater();
+    });
+}
+
+void HttpWorker::processBuffer(QTcpSocket* socket) {
+    QByteArray& buffer = buffers[socket];
+    auto fail = [&](int status, const QString& message) {
+        socket->write(serialize(errorResponse(status, message), false));
+        socket->disconnectFromHost();
+        buffer.clear();
+    };
+    
+    // Pipelining: se atienden en orden todas las peticiones completas del búfer
+    while (!buffer.isEmpty() && socket->bytesToWrite() < kMaxPendingWrite) {
+        const int headerEnd = buffer.indexOf("\r\n\r\n");
+        if (headerEnd < 0) {
+            if (buffer.size() > kMaxHeaderBytes) {
+                fail(431, "Cabeceras demasiado grandes");
+            }
+            return;
+        }
+        
+        const QList<QByteArray> lines = buffer.left(headerEnd).split('\n');
+        const QList<QByteArray> requestLine = lines.first().trimmed().split(' ');
+        if (requestLine.size() != 3 || !requestLine[2].startsWith("HTTP/1.")) {
+            fail(400, "Línea de petición inválida");
+            return;
+        }
+        
+        Request request;
+        request.method = requestLine[0];
+        const QByteArray& target = requestLine[1];
+        const int queryStart = target.indexOf('?');
+        request.path = queryStart < 0 ? target : target.left(queryStart);
+        request.query = queryStart < 0 ? QByteArray() : target.mid(queryStart + 1);
+        request.keepAlive = requestLine[2] != "HTTP/1.0";
+        
+        int contentLength = 0;
+        for (int i = 1; i < lines.size(); ++i) {
+            const QByteArray line = lines[i].trimmed();
+            const int colon = line.indexOf(':');
+            if (colon <= 0) {
+                continue;
+            }
+            const QByteArray name = line.left(colon).trimmed().toLower();
+            const QByteArray value = line.mid(colon + 1).trimmed().toLower();
+            if (name == "content-length") {
+                contentLength = value.toInt();
+            } else if (name == "connection") {
+                request.keepAlive = value == "keep-alive" ||
+                                    (request.keepAlive && value != "close");
+            }
+        }
+        
+        if (contentLength < 0 || contentLength > kMaxBodyBytes) {
+            fail(413, "Cuerpo demasiado grande");
+            return;
+        }
+        const int total = headerEnd + 4 + contentLength;
+        if (buffer.size() < total) {
+            return;   // Falta el resto del cuerpo
+        }
+        request.body = buffer.mid(headerEnd + 4, contentLength);
+        buffer.remove(0, total);
+        
+        socket->write(serialize(handle(request), request.keepAlive));
+        if (!request.keepAlive) {
+            socket->disconnectFromHost();
+            buffer.clear();
+            return;
+        }
+    }
+}
+
+HttpWorker::Response HttpWorker::handle(const Request& request) {
+    if (!prepareQueries()) {
+        return errorResponse(503, "Base de datos no disponible");
+    }
+    
+    // "/components/12/adjust" -> ["", "components", "12", "adjust"]
+    const QList<QByteArray> parts = request.path.split('/');
+    QByteArray rawQuery = request.query;
+    const QUrlQuery params(QString::fromUtf8(rawQuery.replace('+', ' ')));
+    
+    if (parts.value(1) == "low-stock" && parts.size() == 2) {
+        if (request.method != "GET") {
+            return errorResponse(405, "Use GET");
+        }
+        bool ok = false;
+        const int threshold = params.queryItemValue("threshold").toInt(&ok);
+        return lowStock(ok ? threshold : 5);
+    }
+    
+    if (parts.value(1) != "components" || parts.size() > 4) {
+        return errorResponse(404, "Ruta desconocida");
+    }
+    
+    if (parts.size() == 2) {
+        if (request.method != "GET") {
+            return errorResponse(405, "Use GET");
+        }
+        bool ok = false;
+        const int limit = params.queryItemValue("limit").toInt(&ok);
+        return search(params.queryItemValue("q", QUrl::FullyDecoded), ok ? qBound(1, limit, 1000) : 100);
+    }
+    
+    bool validId = false;
+    const int id = parts[2].toInt(&validId);
+    if (!validId) {
+        return errorResponse(404, "ID inválido");
+    }
+    
+    const QString site = params.queryItemValue("site", QUrl::FullyDecoded);
+    if (parts.size() == 3) {
+        if (request.method != "GET") {
+            return errorResponse(405, "Use GET");
+        }
+        return getById(id, site);
+    }
+    
+    if (parts[3] != "adjust") {
+        return errorResponse(404, "Ruta desconocida");
+    }
+    if (request.method != "POST") {
+        return errorResponse(405, "Use POST");
+    }
+    return adjust(id, request.body, site);
+}
+
+bool HttpWorker::prepareQueries() {
+    if (searchQuery) {
+        return true;
+    }
+    
+    // Se preparan una vez por hilo, en el hilo dueño de la conexión
+    QSqlDatabase conn = DatabaseManager::connectionForThread(dbPath);
+    if (!conn.isOpen()) {
+        return false;
+    }
+    
+    std::unique_ptr<QSqlQuery> searchStmt(new QSqlQuery(conn));
+    std::unique_ptr<QSqlQuery> byIdStmt(new QSqlQuery(conn));
+    std::unique_ptr<QSqlQuery> lowStockStmt(new QSqlQuery(conn));
+    const bool prepared =
+        searchStmt->prepare("SELECT * FROM componentes WHERE "
+                            "name LIKE :search OR type LIKE :search OR location LIKE :search "
+                            "ORDER BY name LIMIT :limit") &&
+        byIdStmt->prepare("SELECT * FROM componentes WHERE id = :id") &&
+        lowStockStmt->prepare("SELECT * FROM componentes WHERE quantity <= :threshold "
+                              "ORDER BY quantity");
+    if (!prepared) {
+        qCritical() << "Error preparando consultas HTTP:" << searchStmt->lastError().text()
+                    << byIdStmt->lastError().text() << lowStockStmt->lastError().text();
+        return false;
+    }
+    
+    searchQuery = std::move(searchStmt);
+    byIdQuery = std::move(byIdStmt);
+    lowStockQuery = std::move(lowStockStmt);
+    return true;
+}
+
+HttpWorker::Response HttpWorker::search(const QString& text, int limit) {
+    searchQuery->bindValue(":search", "%" + text + "%");
+    searchQuery->bindValue(":limit", limit);
+    if (!searchQuery->exec()) {
+        return errorResponse(500, "Error buscando componentes: " + searchQuery->lastError().text());
+    }
+    return {200, componentsJson(*searchQuery)};
+}
+
+QSqlQuery* HttpWorker::siteByIdQuery(const QString& site) {
+    if (DatabaseManager::isMainSite(site)) {
+        return byIdQuery.get();
+    }
+    if (std::shared_ptr<QSqlQuery> query = siteByIdQueries.value(site)) {
+        return query.get();
+    }
+    
+    // Solo sedes existentes: connectionForThread crearía un archivo vacío
+    const QString path = DatabaseManager::getInstance()->getSitePath(site);
+    if (path.isEmpty() || !QFile::exists(path)) {
+        return nullptr;
+    }
+    QSqlDatabase conn = DatabaseManager::connectionForThread(path);
+    auto query = std::make_shared<QSqlQuery>(conn);
+    if (!conn.isOpen() || !query->prepare("SELECT * FROM componentes WHERE id = :id")) {
+        qCritical() << "Error preparando consulta HTTP de la sede" << site << ":"
+                    << query->lastError().text();
+        return nullptr;
+    }
+    siteByIdQueries.insert(site, query);
+    return query.get();
+}
+
+HttpWorker::Response HttpWorker::getById(int id, const QString& site) {
+    QSqlQuery* query = siteByIdQuery(site);
+    if (!query) {
+        return errorResponse(404, "Sede desconocida: " + site);
+    }
+    query->bindValue(":id", id);
+    if (!query->exec()) {
+        return errorResponse(500, "Error obteniendo componente: " + query->lastError().text());
+    }
+    if (!query->next()) {
+        query->finish();
+        return errorResponse(404, "Componente no encontrado, ID: " + QString::number(id));
+    }
+    Component component = DatabaseManager::queryToComponent(*query);
+    query->finish();
+    if (!DatabaseManager::isMainSite(site)) {
+        component.setSite(site);
+    }
+    return {200, component.toJSON()};
+}
+
+HttpWorker::Response HttpWorker::lowStock(int threshold) {
+    lowStockQuery->bindValue(":threshold", threshold);
+    if (!lowStockQuery->exec()) {
+        return errorResponse(500, "Error obteniendo stock bajo: " + lowStockQuery->lastError().text());
+    }
+    return {200, componentsJson(*lowStockQuery)};
+}
+
+HttpWorker::Response HttpWorker::adjust(int id, const QByteArray& body, const QString& querySite) {
+    QJsonParseError parseError;
+    const QJsonObject json = QJsonDocument::fromJson(body, &parseError).object();
+    if (parseError.error != QJsonParseError::NoError || !json.value("delta").isDouble() ||
+        json.value("delta").toInt() == 0) {
+        return errorResponse(400, "Se espera {\"delta\": <entero distinto de 0>}");
+    }
+    const int delta = json.value("delta").toInt();
+    const QString reason = json.value("reason").toString();
+    const QString site = json.value("site").toString(querySite);
+    
+    // Las escrituras pasan por InventoryManager (reservas, diario, pronóstico).
+    // No se usa BlockingQueuedConnection: al cerrar, la GUI espera a este hilo.
+    auto call = std::make_shared<AdjustCall>();
+    InventoryManager* target = inventory;
+    // El error vuelve en la respuesta: InventoryManager::error abriría un diálogo en la GUI
+    QMetaObject::invokeMethod(inventory, [call, target, id, delta, reason, site]() {
+        call->ok = target->adjustQuantity(id, delta, reason, site, &call->error);
+        call->done.release();
+    }, Qt::QueuedConnection);
+    
+    while (!call->done.tryAcquire(1, 100)) {
+        if (stopping->loadAcquire()) {
+            return errorResponse(503, "Servicio deteniéndose");
+        }
+    }
+    if (!call->ok) {
+        return errorResponse(409, call->error.isEmpty() ? "No se pudo ajustar la cantidad"
+                                                        : call->error);
+    }
+    return getById(id, site);
+}
+
+QByteArray HttpWorker::serialize(const Response& response, bool keepAlive) {
+    const QByteArray payload = QJsonDocument(response.body).toJson(QJsonDocument::Compact);
+    
+    QByteArray out;
+    out.reserve(payload.size() + 128);
+    out += "HTTP/1.1 " + QByteArray::number(response.status) + ' ' +
+           reasonPhrase(response.status) + "\r\n";
+    out += "Content-Type: application/json; charset=utf-8\r\n";
+    out += "Content-Length: " + QByteArray::number(payload.size()) + "\r\n";
+    out += keepAlive ? "Connection: keep-alive\r\n\r\n" : "Connection: close\r\n\r\n";
+    out += payload;
+    return out;
+}
+
+HttpWorker::Response HttpWorker::errorResponse(int status, const QString& message) {
+    return {status, QJsonObject{{"error", message}}};
+}
+
+HttpService::HttpService(InventoryManager* inventory, QObject* parent)
+    : QTcpServer(parent), inventory(inventory), nextWorker(0), stopping(0) {
+}
+
+HttpService::~HttpService() {
+    stop();
+}
+
+bool HttpService::start(quint16 port, int threadCount, const QHostAddress& address) {
+    if (isListening()) {
+        return true;
+    }
+    
+    stopping.storeRelease(0);
+    const QString dbPath = DatabaseManager::getInstance()->getDatabasePath();
+    for (int i = 0; i < qMax(1, threadCount); ++i) {
+        QThread* thread = new QThread(this);
+        HttpWorker* worker = new HttpWorker(inventory, dbPath, &stopping);
+        worker->moveToThread(thread);
+        connect(thread, &QThread::finished, worker, &QObject::deleteLater);
+        thread->start();
+        threads.append(thread);
+        workers.append(worker);
+    }
+    
+    if (!listen(address, port)) {
+        qWarning() << "No se pudo iniciar el servicio HTTP:" << errorString();
+        stop();
+        return false;
+    }
+    qDebug() << "Servicio HTTP en el puerto" << serverPort() << "con" << workers.size() << "hilos";
+    return true;
+}
+
+void HttpService::stop() {
+    close();
+    stopping.storeRelease(1);
+    for (QThread* thread : qAsConst(threads)) {
+        thread->quit();
+        thread->wait();
+    }
+    qDeleteAll(threads);
+    threads.clear();
+    workers.clear();
+    nextWorker = 0;
+}
+
+void HttpService::incomingConnection(qintptr socketDescriptor) {
+    if (workers.isEmpty()) {
+        QTcpSocket socket;
+        socket.setSocketDescriptor(socketDescriptor);
+        socket.abort();
+        return;
+    }
+    
+    // Reparto por turnos; la conexión queda fija en su hilo para conservar el orden
+    HttpWorker* worker = workers[nextWorker];
+    nextWorker = (nextWorker + 1) % workers.size();
+    QMetaObject::invokeMethod(worker, [worker, socketDescriptor]() {
+        worker->addConnection(socketDescriptor);
+    }, Qt::QueuedConnection);
+}
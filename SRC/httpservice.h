@@ -0,0 +1,110 @@
+#ifndef HTTPSERVICE_H
+#define HTTPSERVICE_H
+
+#include <QObject>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QThread>
+#include <QHash>
+#include <QSqlQuery>
+#include <QAtomicInt>
+#include <QJsonObject>
+#include <memory>
+
+class InventoryManager;
+
+/**
+ * Atiende las conexiones HTTP de un hilo del pool.
+ *
+ * Las lecturas usan la conexión SQLite propia del hilo con consultas
+ * preparadas una sola vez. Los ajustes de cantidad se envían al hilo de
+ * InventoryManager para que reservas, diario y pronóstico sigan coherentes.
+ */
+class HttpWorker : public QObject {
+    Q_OBJECT
+
+public:
+    HttpWorker(InventoryManager* inventory, const QString& dbPath, const QAtomicInt* stopping);
+
+public slots:
+    void addConnection(qintptr socketDescriptor);
+
+private:
+    struct Request {
+        QByteArray method;
+        QByteArray path;
+        QByteArray query;
+        QByteArray body;
+        bool keepAlive = true;
+    };
+    
+    struct Response {
+        int status = 200;
+        QJsonObject body;
+    };
+    
+    void processBuffer(QTcpSocket* socket);
+    Response handle(const Request& request);
+    Response search(const QString& text, int limit);
+    Response getById(int id, const QString& site);
+    Response lowStock(int threshold);
+    Response adjust(int id, const QByteArray& body, const QString& site);
+    bool prepareQueries();
+    QSqlQuery* siteByIdQuery(const QString& site);
+    static QByteArray serialize(const Response& response, bool keepAlive);
+    static Response errorResponse(int status, const QString& message);
+    
+    static const int kMaxHeaderBytes = 16 * 1024;
+    static const int kMaxBodyBytes = 64 * 1024;
+    static const qint64 kMaxPendingWrite = 1024 * 1024;   ///< Contrapresión por socket
+    
+    InventoryManager* inventory;
+    QString dbPath;
+    const QAtomicInt* stopping;
+    QHash<QTcpSocket*, QByteArray> buffers;
+    
+    // Consultas preparadas reutilizadas entre peticiones del mismo hilo
+    std::unique_ptr<QSqlQuery> searchQuery;
+    std::unique_ptr<QSqlQuery> byIdQuery;
+    std::unique_ptr<QSqlQuery> lowStockQuery;
+    QHash<QString, std::shared_ptr<QSqlQuery>> siteByIdQueries;   ///< Por sede, con su conexión
+};
+
+/**
+ * Servicio HTTP/JSON local para clientes de planta (tablets).
+ *
+ *   GET  /components?q=texto&limit=N
+ *   GET  /components/<id>[?site=sede]
+ *   GET  /low-stock?threshold=N
+ *   POST /components/<id>/adjust   {"delta": -3, "reason": "...", "site": "sede"}
+ *
+ * Sin sede se usa la principal; el ID debe pertenecer a la sede indicada.
+ * No hay autenticación: por defecto solo escucha en localhost y exponerlo a
+ * la red de planta es una decisión explícita (--http-address).
+ *
+ * HTTP/1.1 con keep-alive y pipelining: las respuestas salen en el orden de
+ * las peticiones. Cada conexión se asigna a un hilo del pool por turnos.
+ */
+class HttpService : public QTcpServer {
+    Q_OBJECT
+
+public:
+    explicit HttpService(InventoryManager* inventory, QObject* parent = nullptr);
+    ~HttpService();
+    
+    bool start(quint16 port, int threads = QThread::idealThreadCount(),
+               const QHostAddress& address = QHostAddress::LocalHost);
+    void stop();
+
+protected:
+    void incomingConnection(qintptr socketDescriptor) override;
+
+private:
+    InventoryManager* inventory;
+    QVector<QThread*> threads;
+    QVector<HttpWorker*> workers;
+    int nextWorker;
+    QAtomicInt stopping;
+};
+
+#endif // HTTPSERVICE_H
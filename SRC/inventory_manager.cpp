@@ -1,30 +1,172 @@
 #include "inventory_manager.h"
+#include "httpservice.h"
+#include <QtConcurrent>
+#include <QFile>
+#include <QElapsedTimer>
+#include <QScopedValueRollback>
 #include <QDebug>
+#include <algorithm>
+#include <limits>
+#include <utility>
 
 InventoryManager::InventoryManager(QObject* parent) 
-    : QObject(parent), dbManager(DatabaseManager::getInstance()) {
+    : QObject(parent), dbManager(DatabaseManager::getInstance()),
+      reservations(new ReservationManager(dbManager, this)),
+      changeFeed(new ChangeFeedServer(dbManager, this)),
+      forecaster(new ReorderForecaster(dbManager, this)),
+      snapshotFresh(false), databaseReady(false), writeGeneration(0), reconcileGeneration(0),
+      searchIndex(nullptr),
+      maintenance(new MaintenanceScheduler(dbManager->getDatabasePath(),
+                                           dbManager->getSitesDirectory())),
+      lowStock(new LowStockAggregator()),
+      httpService(nullptr), recorder(nullptr), errorSink(nullptr) {
     
+    qRegisterMetaType<MaintenanceReport>();
+    maintenance->moveToThread(&maintenanceThread);
+    connect(&maintenanceThread, &QThread::started,
+            maintenance, &MaintenanceScheduler::start);
+    connect(&maintenanceThread, &QThread::finished,
+            maintenance, &QObject::deleteLater);
+    // Directa: solo actualiza un atómico, así la inactividad se mide sin cola de eventos
     connect(dbManager, &DatabaseManager::dataChanged,
-            this, &InventoryManager::inventoryChanged);
+            maintenance, &MaintenanceScheduler::noteActivity, Qt::DirectConnection);
+    connect(maintenance, &MaintenanceScheduler::maintenanceFinished,
+            this, &InventoryManager::maintenanceFinished);
+    
+    qRegisterMetaType<QVector<Component>>();
+    lowStock->moveToThread(&lowStockThread);
+    connect(&lowStockThread, &QThread::started,
+            lowStock, &LowStockAggregator::start);
+    connect(&lowStockThread, &QThread::finished,
+            lowStock, &QObject::deleteLater);
+    connect(lowStock, &LowStockAggregator::summaryReady,
+            this, &InventoryManager::lowStockAlert);
+    
+    connect(dbManager, &DatabaseManager::dataChanged,
+            this, &InventoryManager::onDataChanged);
     connect(dbManager, &DatabaseManager::errorOccurred,
-            this, &InventoryManager::error);
+            this, &InventoryManager::reportError);
+    connect(reservations, &ReservationManager::error,
+            this, &InventoryManager::reportError);
+    connect(&reconcileWatcher, &QFutureWatcher<bool>::finished,
+            this, &InventoryManager::onSnapshotRebuilt);
+    connect(&indexWatcher, &QFutureWatcher<TrigramIndex*>::finished,
+            this, &InventoryManager::onSearchIndexBuilt);
+    connect(&forecastWatcher, &QFutureWatcher<QVector<ReorderForecast>>::finished, this, [this]() {
+        emit reorderForecastReady(forecastWatcher.result());
+    });
+    
+    reconcileTimer.setSingleShot(true);
+    reconcileTimer.setInterval(5000);
+    connect(&reconcileTimer, &QTimer::timeout,
+            this, &InventoryManager::startSnapshotReconcile);
 }
 
 InventoryManager::~InventoryManager() {
+    // Primero el servicio HTTP: sus hilos envían ajustes a este objeto
+    delete httpService;
+    delete recorder;
+    
+    maintenance->stop();
+    maintenanceThread.quit();
+    maintenanceThread.wait();
+    lowStockThread.quit();
+    lowStockThread.wait();
+    
+    reservations->flush();
+    forecaster->flush();
+    forecastWatcher.waitForFinished();
+    
+    // No dejar la reconciliación escribiendo tras destruir el gestor
+    const bool reconcilePending = reconcileTimer.isActive() || reconcileWatcher.isRunning();
+    reconcileWatcher.waitForFinished();
+    
+    // Con escrituras sin reconciliar, regenerar ya: el próximo arranque la
+    // descartaría por versión y tendría que leer todo de SQLite
+    if (reconcilePending && !snapshotFresh) {
+        reconcileTimer.stop();
+        snapshot.close();
+        const QString path = snapshotPath();
+        QSqlDatabase conn = DatabaseManager::connectionForThread(dbManager->getDatabasePath());
+        if (conn.isOpen() && ComponentSnapshot::rebuild(path + ".new", conn)) {
+            QFile::remove(path);
+            QFile::rename(path + ".new", path);
+        } else {
+            QFile::remove(path + ".new");
+        }
+    }
     
+    indexWatcher.waitForFinished();
+    if (!searchIndex && indexWatcher.future().resultCount() > 0) {
+        delete indexWatcher.result();
+    }
+    delete searchIndex;
+}
+
+bool InventoryManager::openSnapshot() {
+    // Solo el archivo mapeado: no toca SQLite, así la ventana lista de inmediato
+    QElapsedTimer timer;
+    timer.start();
+    snapshotFresh = false;
+    if (!snapshot.open(snapshotPath())) {
+        return false;
+    }
+    qDebug() << "Instantánea mapeada en" << timer.elapsed() << "ms";
+    return true;
 }
 
 bool InventoryManager::initialize() {
+    if (!snapshot.isOpen()) {
+        openSnapshot();
+    }
+    
     bool success = dbManager->initialize();
     if (!success) {
         emit error("No se pudo inicializar el sistema de base de datos");
+        return false;
+    }
+    databaseReady = true;
+    
+    // Solo vale si se generó tras el último cambio registrado; si no, la app
+    // salió o se cayó con la reconciliación pendiente
+    snapshotFresh = snapshot.isOpen() && !snapshot.isCorrupt() &&
+                    snapshot.dataVersion() == quint64(dbManager->getLastChangeSeq());
+    if (snapshot.isOpen() && !snapshotFresh) {
+        qDebug() << "Instantánea desactualizada (versión" << snapshot.dataVersion()
+                 << "de" << dbManager->getLastChangeSeq() << "), se regenerará";
+        snapshot.close();
+    }
+    
+    reservations->load();
+    forecaster->load();
+    changeFeed->listen();
+    maintenanceThread.start(QThread::LowestPriority);
+    for (const QString& site : dbManager->getSites()) {
+        lowStock->addSite(site, dbManager->getSitePath(site));
+    }
+    lowStockThread.start(QThread::LowPriority);
+    
+    // El índice de trigramas se construye fuera del hilo de la GUI, con la
+    // lista ya verificada (instantánea al día o SQLite)
+    QVector<Component> components = getAllComponents();
+    indexWatcher.setFuture(QtConcurrent::run([components]() {
+        TrigramIndex* index = new TrigramIndex();
+        index->build(components);
+        return index;
+    }));
+    
+    if (!snapshotFresh) {
+        startSnapshotReconcile();
     }
     return success;
 }
 
 bool InventoryManager::addComponent(const QString& name, const QString& type, int quantity,
-                                  const QString& location, const QDate& purchaseDate) {
-
+                                  const QString& location, const QDate& purchaseDate,
+                                  const QString& site, int* newIdOut) {
+    TraceRecorder::Call trace(recorder, TraceOp::Add);
+    trace << name << type << quantity << location << purchaseDate << site;
+    
     if (name.isEmpty() || type.isEmpty() || location.isEmpty()) {
         emit error("Nombre, tipo y ubicación son obligatorios");
         return false;
@@ -36,18 +178,34 @@ bool InventoryManager::addComponent(const QString& name, const QString& type, in
     }
     
     Component component(-1, name, type, quantity, location, purchaseDate);
-    bool success = dbManager->addComponent(component);
+    component.setSite(site);
+    int newId = -1;
+    QVector<LotShift> lots;
+    bool success = dbManager->addComponent(component, &newId, &lots);
     
-    if (success && quantity <= 5) {
-        // Verificar si hay alerta de stock bajo
-        checkLowStock();
+    if (success) {
+        component.setId(newId);
+        trace << newId;
+        if (newIdOut) {
+            *newIdOut = newId;
+        }
+        InventoryCommand command = InventoryCommand::added(component);
+        command.setLotShifts(lots);
+        recordCommand(command);
+        if (site.isEmpty() || site == DatabaseManager::kMainSite) {
+            reservations->setQuantity(newId, quantity);
+            indexUpsert(component);
+        }
+        noteQuantity(newId, -1, quantity, site);
     }
     
     return success;
 }
 
 bool InventoryManager::updateComponent(const Component& component) {
-
+    TraceRecorder::Call trace(recorder, TraceOp::Update);
+    trace << component;
+    
     if (component.getName().isEmpty() || component.getType().isEmpty() || 
         component.getLocation().isEmpty()) {
         emit error("Nombre, tipo y ubicación son obligatorios");
@@ -59,59 +217,780 @@ bool InventoryManager::updateComponent(const Component& component) {
         return false;
     }
     
-    bool success = dbManager->updateComponent(component);
+    const bool mainSite = component.getSite().isEmpty() ||
+                          component.getSite() == DatabaseManager::kMainSite;
+    if (mainSite) {
+        if (component.getQuantity() < reservations->reserved(component.getId())) {
+            emit error("La cantidad no puede ser menor que lo reservado");
+            return false;
+        }
+    }
     
-    if (success && component.getQuantity() <= 5) {
-
-        checkLowStock();
+    Component before;
+    QVector<LotShift> lots;
+    auto write = [this, &component, &before, &lots]() {
+        before = dbManager->getComponentById(component.getId(), component.getSite());
+        return dbManager->updateComponent(component, &lots);
+    };
+    // En la principal, los consumos pendientes se aplican antes y ningún commit
+    // concurrente se cuela hasta fijar el contador con la cantidad absoluta
+    bool success = mainSite
+        ? reservations->writeQuantity(component.getId(), component.getQuantity(), write)
+        : write();
+    
+    if (success && before.getId() != -1) {
+        InventoryCommand command = InventoryCommand::updated(before, component);
+        command.setLotShifts(lots);
+        recordCommand(command);
+    }
+    if (success && mainSite) {
+        indexUpsert(component);
+        // Bajar la cantidad al editar también es consumo para el pronóstico
+        if (before.getId() != -1 && component.getQuantity() < before.getQuantity()) {
+            forecaster->recordConsumption(component.getId(),
+                                          before.getQuantity() - component.getQuantity());
+        }
+    }
+    if (success) {
+        noteQuantity(component.getId(), before.getId() != -1 ? before.getQuantity() : -1,
+                     component.getQuantity(), component.getSite());
     }
     
     return success;
 }
 
-bool InventoryManager::removeComponent(int id) {
-    return dbManager->deleteComponent(id);
+bool InventoryManager::removeComponent(int id, const QString& site) {
+    TraceRecorder::Call trace(recorder, TraceOp::Remove);
+    trace << id << site;
+    
+    const bool mainSite = site.isEmpty() || site == DatabaseManager::kMainSite;
+    if (mainSite && reservations->reserved(id) > 0) {
+        emit error("El componente tiene reservas activas");
+        return false;
+    }
+    
+    const Component before = dbManager->getComponentById(id, site);
+    QVector<LotShift> lots;
+    bool success = dbManager->deleteComponent(id, site, &lots);
+    if (success && before.getId() != -1) {
+        InventoryCommand command = InventoryCommand::removed(before);
+        command.setLotShifts(lots);
+        recordCommand(command);
+    }
+    if (success && mainSite) {
+        reservations->forgetComponent(id);
+        forecaster->forgetComponent(id);
+        indexRemove(id);
+    }
+    return success;
 }
 
 QVector<Component> InventoryManager::getAllComponents() {
+    TraceRecorder::Call trace(recorder, TraceOp::GetAll);
+    if (snapshotFresh || (!databaseReady && snapshot.isOpen())) {
+        QVector<Component> components = snapshot.toVector();
+        if (!snapshot.isCorrupt()) {
+            return components;
+        }
+        // Un bloque dañado se detecta al leerlo: regenerar desde SQLite
+        qWarning() << "Instantánea dañada, se regenerará";
+        snapshotFresh = false;
+        if (!databaseReady) {
+            return components;   // Vacía: aún no hay otra fuente
+        }
+        QMetaObject::invokeMethod(this, &InventoryManager::startSnapshotReconcile,
+                                  Qt::QueuedConnection);
+    }
     return dbManager->getAllComponents();
 }
 
-QVector<Component> InventoryManager::searchComponents(const QString& searchText) {
-    return dbManager->searchComponents(searchText);
+QVector<Component> InventoryManager::searchComponents(const QString& searchText,
+                                                      SearchMode mode) {
+    TraceRecorder::Call trace(recorder, TraceOp::Search);
+    trace << searchText << quint8(mode);
+    
+    if (mode == SearchMode::Exact || searchText.isEmpty()) {
+        return dbManager->searchComponents(searchText);
+    }
+    
+    if (!searchIndex) {
+        qDebug() << "Índice de trigramas aún en construcción";
+        return QVector<Component>();
+    }
+    
+    QElapsedTimer timer;
+    timer.start();
+    const QVector<TrigramIndex::Match> matches = searchIndex->search(searchText);
+    
+    QVector<int> ids;
+    ids.reserve(matches.size());
+    for (const TrigramIndex::Match& match : matches) {
+        ids.append(match.componentId);
+    }
+    
+    QVector<Component> components = dbManager->getComponentsByIds(ids);
+    qDebug() << "Búsqueda aproximada '" << searchText << "':" << components.size()
+             << "resultados en" << timer.elapsed() << "ms";
+    return components;
 }
 
 QVector<Component> InventoryManager::getLowStockAlert(int threshold) {
-    QVector<Component> lowStock = dbManager->getLowStockComponents(threshold);
+    TraceRecorder::Call trace(recorder, TraceOp::LowStock);
+    trace << threshold;
+    return dbManager->getLowStockComponents(threshold);
+}
+
+ComponentPage InventoryManager::getComponentsPage(const ComponentQuery& filter,
+                                                  const QString& pageToken, int limit) {
+    return dbManager->getComponentsPage(filter, pageToken, limit);
+}
+
+bool InventoryManager::forEachComponent(const ComponentQuery& filter,
+                                        const std::function<bool(const Component&)>& visitor) {
+    return dbManager->visitComponents(filter, visitor);
+}
+
+bool InventoryManager::adjustQuantity(int id, int delta, const QString& reason,
+                                      const QString& site, QString* errorMessage) {
+    TraceRecorder::Call trace(recorder, TraceOp::Adjust);
+    trace << id << delta << reason << site;
+    QScopedValueRollback<QString*> sink(errorSink, errorMessage ? errorMessage : errorSink);
     
-    if (!lowStock.isEmpty()) {
-        emit lowStockAlert(lowStock);
+    // Reservas y pronóstico solo siguen a la sede principal; las alertas, a todas
+    const bool mainSite = DatabaseManager::isMainSite(site);
+    
+    // Un retiro no puede consumir unidades reservadas por otros proyectos: se
+    // descuenta antes de escribir. Las entradas se suman tras confirmar, así
+    // ninguna reserva cuenta con unidades que la BD aún podría rechazar
+    if (mainSite && delta < 0 && !reservations->tryAdjust(id, delta)) {
+        reportError("No hay unidades disponibles: el stock está reservado");
+        return false;
+    }
+    
+    int newQuantity = 0;
+    QVector<LotShift> lots;
+    bool success = dbManager->updateQuantity(id, delta, site, &newQuantity, QDate(), 0.0, &lots);
+    
+    if (!success) {
+        if (mainSite && delta < 0) {
+            reservations->addQuantity(id, -delta);
+        }
+    } else {
+        InventoryCommand command = InventoryCommand::adjusted(id, delta,
+                                                              mainSite ? QString() : site);
+        command.setLotShifts(lots);
+        recordCommand(command);
+        if (mainSite) {
+            reservations->addQuantity(id, delta);
+            if (delta < 0) {
+                forecaster->recordConsumption(id, -delta);
+            }
+        }
+        noteQuantity(id, newQuantity - delta, newQuantity, site);
     }
     
-    return lowStock;
+    return success;
 }
 
-bool InventoryManager::adjustQuantity(int id, int delta, const QString& reason) {
-    bool success = dbManager->updateQuantity(id, delta);
+bool InventoryManager::receiveLot(int id, int quantity, const QDate& purchaseDate,
+                                  double unitCost) {
+    TraceRecorder::Call trace(recorder, TraceOp::Receive);
+    trace << id << quantity << purchaseDate << unitCost;
     
-    if (success) {
-        // Verificar stock después del ajuste
-        Component comp = getComponentById(id);
-        if (comp.getId() != -1 && comp.getQuantity() <= 5) {
-            checkLowStock();
+    if (quantity <= 0) {
+        emit error("La cantidad recibida debe ser positiva");
+        return false;
+    }
+    int newQuantity = 0;
+    QVector<LotShift> lots;
+    if (!dbManager->updateQuantity(id, quantity, QString(), &newQuantity, purchaseDate, unitCost,
+                                   &lots)) {
+        return false;
+    }
+    
+    // Una entrada nunca invade lo reservado: solo actualiza el contador.
+    // El comando guarda el lote creado: deshacer lo elimina y rehacer lo recrea igual
+    reservations->addQuantity(id, quantity);
+    InventoryCommand command = InventoryCommand::adjusted(id, quantity);
+    command.setLotShifts(lots);
+    recordCommand(command);
+    noteQuantity(id, newQuantity - quantity, newQuantity);
+    return true;
+}
+
+QVector<Lot> InventoryManager::getLots(int id, bool openOnly) {
+    return dbManager->getLots(id, openOnly);
+}
+
+QVector<Lot> InventoryManager::getLotsPurchasedBetween(const QDate& from, const QDate& to,
+                                                       int limit) {
+    return dbManager->getLotsPurchasedBetween(from, to, limit);
+}
+
+QVector<Lot> InventoryManager::getOldestLots(int limit) {
+    return dbManager->getOldestLots(limit);
+}
+
+LotTotals InventoryManager::getPurchaseTotals(const QDate& from, const QDate& to) {
+    return dbManager->getPurchaseTotals(from, to);
+}
+
+Component InventoryManager::getComponentById(int id, const QString& site) {
+    TraceRecorder::Call trace(recorder, TraceOp::GetById);
+    trace << id << site;
+    return dbManager->getComponentById(id, site);
+}
+
+qint64 InventoryManager::reserveComponent(int id, int quantity, const QString& project) {
+    TraceRecorder::Call trace(recorder, TraceOp::Reserve);
+    trace << id << quantity << project;
+    
+    qint64 reservationId = reservations->reserve(id, quantity, project);
+    trace << reservationId;
+    if (reservationId < 0) {
+        emit error(QString("No hay %1 unidades disponibles para reservar").arg(quantity));
+    }
+    return reservationId;
+}
+
+bool InventoryManager::releaseReservation(qint64 reservationId) {
+    TraceRecorder::Call trace(recorder, TraceOp::Release);
+    trace << reservationId;
+    return reservations->release(reservationId);
+}
+
+bool InventoryManager::commitReservation(qint64 reservationId) {
+    TraceRecorder::Call trace(recorder, TraceOp::Commit);
+    trace << reservationId;
+    
+    Reservation committed;
+    if (!reservations->commit(reservationId, &committed)) {
+        return false;
+    }
+    forecaster->recordConsumption(committed.componentId, committed.quantity);
+    
+    // Cantidad tras el consumo según los contadores, sin consultar la BD
+    const int id = committed.componentId;
+    const int quantity = reservations->available(id) + reservations->reserved(id);
+    noteQuantity(id, quantity + committed.quantity, quantity);
+    return true;
+}
+
+int InventoryManager::getAvailableQuantity(int id) {
+    TraceRecorder::Call trace(recorder, TraceOp::Available);
+    trace << id;
+    return reservations->available(id);
+}
+
+ReorderForecast InventoryManager::getReorderForecast(int id) {
+    TraceRecorder::Call trace(recorder, TraceOp::Forecast);
+    trace << id;
+    return forecaster->forecast(getComponentById(id));
+}
+
+void InventoryManager::startReorderForecast() {
+    if (forecastWatcher.isRunning()) {
+        return;
+    }
+    forecastWatcher.setFuture(forecaster->forecastAll(getAllComponents()));
+}
+
+void InventoryManager::beginBatch(const QString& label) {
+    journal.beginBatch(label);
+}
+
+void InventoryManager::endBatch() {
+    journal.endBatch();
+    if (!journal.inBatch()) {
+        emit journalChanged();
+    }
+}
+
+bool InventoryManager::undo() {
+    TraceRecorder::Call trace(recorder, TraceOp::Undo);
+    if (!journal.canUndo() || journal.inBatch()) {
+        return false;
+    }
+    
+    JournalEntry entry = journal.takeUndo();
+    if (!applyJournalEntry(entry, true)) {
+        journal.pushUndo(entry);
+        return false;
+    }
+    journal.pushRedo(entry);
+    emit journalChanged();
+    return true;
+}
+
+bool InventoryManager::redo() {
+    TraceRecorder::Call trace(recorder, TraceOp::Redo);
+    if (!journal.canRedo() || journal.inBatch()) {
+        return false;
+    }
+    
+    JournalEntry entry = journal.takeRedo();
+    if (!applyJournalEntry(entry, false)) {
+        journal.pushRedo(entry);
+        return false;
+    }
+    journal.pushUndo(entry);
+    emit journalChanged();
+    return true;
+}
+
+void InventoryManager::recordCommand(const InventoryCommand& command) {
+    journal.record(command);
+    if (!journal.inBatch()) {
+        emit journalChanged();
+    }
+}
+
+namespace {
+/// Comando que deshace a 'command' (alta <-> baja, antes <-> después, -delta).
+/// Comparte los componentes con el original: solo cambia el sentido
+InventoryCommand inverseOf(const InventoryCommand& command) {
+    InventoryCommand inverse = command;
+    switch (command.kind) {
+    case InventoryCommand::Add:
+        inverse.kind = InventoryCommand::Remove;
+        break;
+    case InventoryCommand::Remove:
+        inverse.kind = InventoryCommand::Add;
+        break;
+    case InventoryCommand::Update:
+    case InventoryCommand::Adjust:
+        break;
+    }
+    inverse.inverted = !command.inverted;
+    inverse.delta = -command.delta;
+    return inverse;
+}
+
+bool isMainSite(const Component& component) {
+    return component.getSite().isEmpty() || component.getSite() == DatabaseManager::kMainSite;
+}
+
+/// Ajuste o edición de la sede principal: su delta de cantidad mueve las reservas
+bool isMainSiteDelta(const InventoryCommand& command) {
+    switch (command.kind) {
+    case InventoryCommand::Adjust:
+        return DatabaseManager::isMainSite(command.site);
+    case InventoryCommand::Update:
+        return isMainSite(command.after());
+    case InventoryCommand::Add:
+    case InventoryCommand::Remove:
+        break;
+    }
+    return false;
+}
+}
+
+bool InventoryManager::applyJournalEntry(const JournalEntry& entry, bool undoing) {
+    // Deshacer recorre la entrada al revés aplicando los inversos
+    QVector<InventoryCommand> commands;
+    commands.reserve(entry.commands.size());
+    if (undoing) {
+        for (int i = entry.commands.size() - 1; i >= 0; --i) {
+            commands.append(inverseOf(entry.commands[i]));
         }
+    } else {
+        commands = entry.commands;
     }
     
-    return success;
+    // Validar contra las reservas antes de tocar la BD. Las salidas se descuentan
+    // ya de los contadores, como en adjustQuantity, y se devuelven si algo falla
+    QVector<QPair<int, int>> deducted;
+    auto restoreDeducted = [this, &deducted]() {
+        for (const QPair<int, int>& item : qAsConst(deducted)) {
+            reservations->addQuantity(item.first, item.second);
+        }
+    };
+    for (const InventoryCommand& command : qAsConst(commands)) {
+        bool blocked = false;
+        switch (command.kind) {
+        case InventoryCommand::Remove:
+            blocked = isMainSite(command.before()) && reservations->reserved(command.componentId) > 0;
+            break;
+        case InventoryCommand::Update:
+        case InventoryCommand::Adjust:
+            if (isMainSiteDelta(command) && command.delta < 0) {
+                blocked = !reservations->tryAdjust(command.componentId, command.delta);
+                if (!blocked) {
+                    deducted.append(qMakePair(command.componentId, -command.delta));
+                }
+            }
+            break;
+        case InventoryCommand::Add:
+            break;
+        }
+        if (blocked) {
+            restoreDeducted();
+            emit error("No se puede " + QString(undoing ? "deshacer" : "rehacer") +
+                       " '" + entry.label + "': hay unidades reservadas");
+            return false;
+        }
+    }
+    
+    // Todas las escrituras en una transacción: una sola señal dataChanged
+    reservations->flush();
+    if (!dbManager->beginTransaction()) {
+        restoreDeducted();
+        return false;
+    }
+    QVector<int> quantities(commands.size(), -1);
+    for (int i = 0; i < commands.size(); ++i) {
+        const InventoryCommand& command = commands[i];
+        if (!applyCommand(command, &quantities[i])) {
+            dbManager->rollbackTransaction();
+            restoreDeducted();
+            emit error("No se pudo " + QString(undoing ? "deshacer" : "rehacer") +
+                       " '" + entry.label + "'");
+            return false;
+        }
+    }
+    if (!dbManager->commitTransaction()) {
+        restoreDeducted();
+        return false;
+    }
+    
+    // Con la BD confirmada, actualizar índice, reservas y pronóstico
+    if (undoing) {
+        for (int i = entry.commands.size() - 1; i >= 0; --i) {
+            syncCommand(entry.commands[i], true);
+        }
+    } else {
+        for (const InventoryCommand& command : entry.commands) {
+            syncCommand(command, false);
+        }
+    }
+    
+    // Umbral de stock bajo con las cantidades ya escritas (un borrado no tiene nada que avisar)
+    for (int i = 0; i < commands.size(); ++i) {
+        const InventoryCommand& command = commands[i];
+        switch (command.kind) {
+        case InventoryCommand::Add:
+            noteQuantity(command.componentId, -1, quantities[i], command.after().getSite());
+            break;
+        case InventoryCommand::Update:
+            noteQuantity(command.componentId, quantities[i] - command.delta, quantities[i],
+                         command.after().getSite());
+            break;
+        case InventoryCommand::Adjust:
+            noteQuantity(command.componentId, quantities[i] - command.delta, quantities[i],
+                         command.site);
+            break;
+        case InventoryCommand::Remove:
+            break;
+        }
+    }
+    return true;
+}
+
+bool InventoryManager::applyCommand(const InventoryCommand& command, int* quantity) {
+    // Con lotes registrados se mueven exactamente esos; sin ellos (sedes, comandos
+    // anteriores a los lotes) la base de datos aplica FIFO
+    QVector<LotShift> lots = command.lotShifts();
+    QVector<LotShift>* exactLots = lots.isEmpty() ? nullptr : &lots;
+    switch (command.kind) {
+    case InventoryCommand::Add:
+        *quantity = command.after().getQuantity();
+        return dbManager->restoreComponent(command.after(), exactLots);
+    case InventoryCommand::Update:
+        // Cantidad relativa: no pisa los ajustes hechos después de la edición
+        if (!dbManager->updateComponent(command.after(), command.delta, exactLots)) {
+            return false;
+        }
+        *quantity = dbManager->getComponentById(command.componentId,
+                                                command.after().getSite()).getQuantity();
+        return true;
+    case InventoryCommand::Remove:
+        return dbManager->deleteComponent(command.componentId, command.before().getSite());
+    case InventoryCommand::Adjust:
+        return dbManager->updateQuantity(command.componentId, command.delta, command.site,
+                                         quantity, QDate(), 0.0, exactLots);
+    }
+    return false;
+}
+
+void InventoryManager::syncCommand(const InventoryCommand& command, bool undoing) {
+    const int id = command.componentId;
+    auto upsert = [this, id](const Component& component) {
+        if (isMainSite(component)) {
+            reservations->setQuantity(id, component.getQuantity());
+            indexUpsert(component);
+        }
+    };
+    auto drop = [this, id](const Component& component) {
+        if (isMainSite(component)) {
+            reservations->forgetComponent(id);
+            forecaster->forgetComponent(id);
+            indexRemove(id);
+        }
+    };
+    
+    switch (command.kind) {
+    case InventoryCommand::Add:
+        if (undoing) {
+            drop(command.after());
+        } else {
+            upsert(command.after());
+        }
+        break;
+    case InventoryCommand::Remove:
+        if (undoing) {
+            upsert(command.before());
+        } else {
+            drop(command.before());
+        }
+        break;
+    case InventoryCommand::Update:
+    case InventoryCommand::Adjust: {
+        if (!isMainSiteDelta(command)) {
+            break;
+        }
+        if (command.kind == InventoryCommand::Update) {
+            indexUpsert(undoing ? command.before() : command.after());
+        }
+        // Las salidas ya se descontaron al validar; las entradas se suman ahora
+        const int applied = undoing ? -command.delta : command.delta;
+        if (applied > 0) {
+            reservations->addQuantity(id, applied);
+        }
+        if (command.delta < 0) {
+            if (undoing) {
+                forecaster->revertConsumption(id, -command.delta);
+            } else {
+                forecaster->recordConsumption(id, -command.delta);
+            }
+        }
+        break;
+    }
+    }
+}
+
+bool InventoryManager::startTraceRecording(const QString& path) {
+    if (!recorder) {
+        recorder = new TraceRecorder();
+    }
+    
+    // El estado inicial va en la cabecera para reproducir sobre una BD vacía;
+    // reservas y consumo pendientes se vuelcan antes para que estén incluidos
+    reservations->flush();
+    forecaster->flush();
+    TraceSnapshot state;
+    for (const QString& site : dbManager->getSites()) {
+        if (!DatabaseManager::isMainSite(site)) {
+            state.sites.append(site);
+        }
+    }
+    // Al reproducir, las sedes se añaden en este orden y reciben los mismos bloques de IDs
+    std::sort(state.sites.begin(), state.sites.end(), [this](const QString& a, const QString& b) {
+        return dbManager->getSiteIdBlock(a) < dbManager->getSiteIdBlock(b);
+    });
+    state.components = dbManager->getAllComponents();
+    for (const Component& component : dbManager->searchAllSites(QString())) {
+        if (!isMainSite(component)) {
+            state.components.append(component);
+        }
+    }
+    state.reservations = dbManager->getReservations();
+    state.lots = dbManager->getOldestLots(std::numeric_limits<int>::max());
+    state.consumption = dbManager->getConsumptionStates();
+    return recorder->open(path, state);
+}
+
+void InventoryManager::stopTraceRecording() {
+    if (recorder) {
+        recorder->close();
+    }
+}
+
+bool InventoryManager::importComponents(const QVector<Component>& components) {
+    // Mismo camino que rehacer altas: una transacción e índice/reservas al día
+    JournalEntry entry;
+    entry.label = "Importar componentes";
+    entry.commands.reserve(components.size());
+    for (const Component& component : components) {
+        entry.commands.append(InventoryCommand::added(component));
+    }
+    return applyJournalEntry(entry, false);
+}
+
+bool InventoryManager::restoreTraceState(const TraceSnapshot& state) {
+    for (const QString& site : state.sites) {
+        if (!dbManager->addSite(site)) {
+            return false;
+        }
+    }
+    if (!importComponents(state.components)) {
+        return false;
+    }
+    
+    // Lotes, reservas y consumo se escriben tal cual y se recargan en memoria
+    if (!dbManager->beginTransaction()) {
+        return false;
+    }
+    if (!dbManager->restoreLots(state.lots) ||
+        !dbManager->persistReservations(state.reservations, {}, {}) ||
+        !dbManager->saveConsumptionStates(state.consumption, {})) {
+        dbManager->rollbackTransaction();
+        return false;
+    }
+    if (!dbManager->commitTransaction()) {
+        return false;
+    }
+    return reservations->load() && forecaster->load();
+}
+
+bool InventoryManager::startHttpService(quint16 port, int threads, const QHostAddress& address) {
+    if (!httpService) {
+        httpService = new HttpService(this, this);
+    }
+    return httpService->start(port, threads, address);
+}
+
+bool InventoryManager::setPerformanceProfile(PerformanceProfile profile) {
+    return dbManager->setPerformanceProfile(profile);
+}
+
+bool InventoryManager::exportChangesToFile(const QString& path) {
+    return changeFeed->setExportFile(path);
+}
+
+bool InventoryManager::addSite(const QString& site) {
+    return dbManager->addSite(site);
+}
+
+QStringList InventoryManager::getSites() const {
+    return dbManager->getSites();
+}
+
+QVector<Component> InventoryManager::searchAllSites(const QString& searchText) {
+    return dbManager->searchAllSites(searchText);
+}
+
+QVector<Component> InventoryManager::getLowStockAlertAllSites(int threshold) {
+    return dbManager->getLowStockAllSites(threshold);
+}
+
+QMap<QString, SiteTotals> InventoryManager::getSiteTotals() {
+    return dbManager->getSiteTotals();
 }
 
-Component InventoryManager::getComponentById(int id) {
-    return dbManager->getComponentById(id);
+void InventoryManager::noteQuantity(int id, int previousQuantity, int quantity,
+                                    const QString& site) {
+    // Solo se encolan los cambios cerca del umbral; el resto no cuesta nada
+    if (!lowStock->isRelevant(previousQuantity, quantity)) {
+        return;
+    }
+    LowStockAggregator* aggregator = lowStock;
+    const QString siteName = DatabaseManager::isMainSite(site) ? DatabaseManager::kMainSite : site;
+    const QString path = dbManager->getSitePath(site);
+    QMetaObject::invokeMethod(aggregator, [aggregator, id, previousQuantity, quantity,
+                                           siteName, path]() {
+        aggregator->quantityChanged(id, previousQuantity, quantity, siteName, path);
+    }, Qt::QueuedConnection);
+}
+
+void InventoryManager::onDataChanged() {
+    // Cualquier escritura invalida la instantánea hasta la próxima reconciliación
+    ++writeGeneration;
+    snapshotFresh = false;
+    reconcileTimer.start();
+    emit inventoryChanged();
+}
+
+QString InventoryManager::snapshotPath() const {
+    return dbManager->getDatabasePath() + ".snapshot";
+}
+
+void InventoryManager::startSnapshotReconcile() {
+    if (reconcileWatcher.isRunning()) {
+        reconcileTimer.start();
+        return;
+    }
+    
+    reconcileGeneration = writeGeneration;
+    const QString dbPath = dbManager->getDatabasePath();
+    const QString tempPath = snapshotPath() + ".new";
+    
+    reconcileWatcher.setFuture(QtConcurrent::run([dbPath, tempPath]() {
+        bool rebuilt = false;
+        {
+            QSqlDatabase conn = DatabaseManager::connectionForThread(dbPath);
+            rebuilt = conn.isOpen() && ComponentSnapshot::rebuild(tempPath, conn);
+        }
+        DatabaseManager::releaseThreadConnection(dbPath);
+        return rebuilt;
+    }));
+}
+
+void InventoryManager::onSnapshotRebuilt() {
+    const QString path = snapshotPath();
+    const QString tempPath = path + ".new";
+    
+    if (!reconcileWatcher.result()) {
+        QFile::remove(tempPath);
+        return;
+    }
+    
+    // Liberar el mapeo antes de reemplazar el archivo (necesario en Windows)
+    snapshot.close();
+    QFile::remove(path);
+    if (!QFile::rename(tempPath, path)) {
+        qWarning() << "No se pudo reemplazar la instantánea";
+        snapshotFresh = false;
+        return;
+    }
+    
+    bool opened = snapshot.open(path);
+    
+    // Si hubo escrituras mientras se leía SQLite, la copia ya nace desactualizada
+    snapshotFresh = opened && reconcileGeneration == writeGeneration;
+    if (!snapshotFresh) {
+        reconcileTimer.start();
+    }
+    emit snapshotReconciled();
+}
+
+void InventoryManager::onSearchIndexBuilt() {
+    searchIndex = indexWatcher.result();
+    
+    // Aplicar en orden los cambios que llegaron durante la construcción
+    for (const QPair<bool, Component>& op : pendingIndexOps) {
+        if (op.first) {
+            searchIndex->remove(op.second.getId());
+        } else {
+            searchIndex->update(op.second);
+        }
+    }
+    pendingIndexOps.clear();
+    
+    qDebug() << "Índice de trigramas listo:" << searchIndex->size() << "componentes";
+}
+
+void InventoryManager::reportError(const QString& message) {
+    if (errorSink) {
+        *errorSink = message;
+    } else {
+        emit error(message);
+    }
+}
+
+void InventoryManager::indexUpsert(const Component& component) {
+    if (searchIndex) {
+        searchIndex->update(component);
+    } else {
+        pendingIndexOps.append(qMakePair(false, component));
+    }
 }
 
-void InventoryManager::checkLowStock() {
-    QVector<Component> lowStock = getLowStockAlert();
-    if (!lowStock.isEmpty()) {
-        qWarning() << "⚠️  Alerta: Componentes con stock bajo detectados";
+void InventoryManager::indexRemove(int id) {
+    if (searchIndex) {
+        searchIndex->remove(id);
+    } else {
+        Component removed;
+        removed.setId(id);
+        pendingIndexOps.append(qMakePair(true, removed));
     }
 }
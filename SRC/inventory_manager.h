@@ -3,9 +3,29 @@
 
 #include <QObject>
 #include <QVector>
+#include <QFutureWatcher>
+#include <QTimer>
+#include <QThread>
+#include <QHostAddress>
 #include "component.h"
+#include "componentsnapshot.h"
 #include "databasemanager.h"
+#include "reservationmanager.h"
+#include "changefeed.h"
+#include "trigramindex.h"
+#include "reorderforecaster.h"
+#include "commandjournal.h"
+#include "maintenancescheduler.h"
+#include "lowstockaggregator.h"
+#include "tracerecorder.h"
 
+class HttpService;
+
+/// Modo de búsqueda: LIKE exacto en SQLite o aproximado por trigramas
+enum class SearchMode {
+    Exact,
+    Fuzzy
+};
 
 class InventoryManager : public QObject {
     Q_OBJECT
@@ -21,31 +41,168 @@ public:
     bool initialize();
     
     bool addComponent(const QString& name, const QString& type, int quantity,
-                     const QString& location, const QDate& purchaseDate);
+                     const QString& location, const QDate& purchaseDate,
+                     const QString& site = QString(), int* newId = nullptr);
     bool updateComponent(const Component& component);
-    bool removeComponent(int id);
+    bool removeComponent(int id, const QString& site = QString());
     QVector<Component> getAllComponents();
-    QVector<Component> searchComponents(const QString& searchText);
+    QVector<Component> searchComponents(const QString& searchText,
+                                        SearchMode mode = SearchMode::Exact);
     QVector<Component> getLowStockAlert(int threshold = 5);
     
+    /// Página de un listado grande; pageToken vacío = primera página
+    ComponentPage getComponentsPage(const ComponentQuery& filter,
+                                    const QString& pageToken = QString(), int limit = 100);
+    
+    /// Recorre el listado sin cargarlo entero; el visitante devuelve false para parar
+    bool forEachComponent(const ComponentQuery& filter,
+                          const std::function<bool(const Component&)>& visitor);
+    
 
-    bool adjustQuantity(int id, int delta, const QString& reason = "");
+    /// Con errorMessage el fallo se devuelve ahí y no se emite error() (clientes HTTP:
+    /// la GUI no debe abrir un diálogo por cada ajuste remoto rechazado)
+    bool adjustQuantity(int id, int delta, const QString& reason = "",
+                        const QString& site = QString(), QString* errorMessage = nullptr);
+    
+    // Lotes de compra (sede principal): las salidas consumen primero los más antiguos
+    bool receiveLot(int id, int quantity, const QDate& purchaseDate, double unitCost = 0.0);
+    QVector<Lot> getLots(int id, bool openOnly = true);
+    QVector<Lot> getLotsPurchasedBetween(const QDate& from, const QDate& to, int limit = 1000);
+    QVector<Lot> getOldestLots(int limit = 100);
+    LotTotals getPurchaseTotals(const QDate& from, const QDate& to);
     
 
-    Component getComponentById(int id);
+    Component getComponentById(int id, const QString& site = QString());
+    
+    // Sedes / almacenes
+    bool addSite(const QString& site);
+    QStringList getSites() const;
+    QVector<Component> searchAllSites(const QString& searchText);
+    QVector<Component> getLowStockAlertAllSites(int threshold = 5);
+    QMap<QString, SiteTotals> getSiteTotals();
+    
+    // Reservas por proyecto (disponible = cantidad - reservado)
+    qint64 reserveComponent(int id, int quantity, const QString& project);
+    bool releaseReservation(qint64 reservationId);
+    bool commitReservation(qint64 reservationId);
+    int getAvailableQuantity(int id);
+    
+    // Pronóstico de reposición según el ritmo de consumo
+    ReorderForecast getReorderForecast(int id);
+    void startReorderForecast();
+    
+    // Deshacer / rehacer: cada entrada se aplica en una sola transacción
+    bool undo();
+    bool redo();
+    bool canUndo() const { return journal.canUndo(); }
+    bool canRedo() const { return journal.canRedo(); }
+    QString undoText() const { return journal.undoLabel(); }
+    QString redoText() const { return journal.redoLabel(); }
+    
+    /// Agrupa las operaciones hasta endBatch() en un solo paso de deshacer
+    void beginBatch(const QString& label);
+    void endBatch();
+    
+    // Traza binaria de llamadas para reproducirla con TraceReplayer
+    bool startTraceRecording(const QString& path);
+    void stopTraceRecording();
+    
+    /// Inserta componentes conservando sus IDs
+    bool importComponents(const QVector<Component>& components);
+    
+    /// Carga el estado inicial de una traza (sedes, componentes, lotes, reservas y
+    /// consumo) en una BD vacía, conservando los IDs grabados
+    bool restoreTraceState(const TraceSnapshot& state);
+    
+    /// Servicio HTTP/JSON para clientes de planta (búsqueda, consulta, ajuste, stock bajo)
+    /// Solo escucha en localhost salvo que se indique otra dirección (p. ej. la red de planta)
+    bool startHttpService(quint16 port, int threads = QThread::idealThreadCount(),
+                          const QHostAddress& address = QHostAddress::LocalHost);
+    
+    /// Perfil de SQLite; BulkLoad acelera importaciones masivas
+    bool setPerformanceProfile(PerformanceProfile profile);
+    
+    /// Replica el registro de cambios en un archivo JSONL además del socket local
+    bool exportChangesToFile(const QString& path);
+    
+    /// Acceso seguro entre hilos para trabajadores que reservan en paralelo
+    ReservationManager* getReservationManager() const { return reservations; }
+    
+    /// Mapea la instantánea sin abrir SQLite. Hasta initialize(), getAllComponents()
+    /// la sirve aunque pueda estar desactualizada (isSnapshotFresh() es false)
+    bool openSnapshot();
+    
+    /// true mientras la instantánea coincide con SQLite y puede servir lecturas
+    bool isSnapshotFresh() const { return snapshotFresh; }
     
 signals:
 
     void inventoryChanged();
     
+    /// La instantánea se regeneró desde SQLite en segundo plano
+    void snapshotReconciled();
+    
+    /// Componentes que se agotarán antes del plazo de reposición, los más urgentes primero
+    void reorderForecastReady(const QVector<ReorderForecast>& forecasts);
+    
 
+    /// Resumen agrupado de componentes que cruzaron el umbral (como mucho uno por intervalo)
+    /// en cualquier sede; el primero, al arrancar, con todo lo que ya estaba bajo
     void lowStockAlert(const QVector<Component>& components);
     
+    /// Cambió lo que se puede deshacer o rehacer
+    void journalChanged();
+    
+    /// Una pasada de mantenimiento terminó (espacio recuperado y tiempos)
+    void maintenanceFinished(const MaintenanceReport& report);
+    
 
     void error(const QString& errorMessage);
     
+private slots:
+    void onDataChanged();
+    void onSnapshotRebuilt();
+    void onSearchIndexBuilt();
+    
 private:
+    void noteQuantity(int id, int previousQuantity, int quantity,
+                      const QString& site = QString());
+    void reportError(const QString& message);
+    void startSnapshotReconcile();
+    QString snapshotPath() const;
+    void indexUpsert(const Component& component);
+    void indexRemove(int id);
+    void recordCommand(const InventoryCommand& command);
+    bool applyJournalEntry(const JournalEntry& entry, bool undoing);
+    bool applyCommand(const InventoryCommand& command, int* quantity);
+    void syncCommand(const InventoryCommand& command, bool undoing);
+    
     DatabaseManager* dbManager;  ///< Gestor de base de datos
+    ReservationManager* reservations; ///< Contadores de reservas en memoria
+    ChangeFeedServer* changeFeed; ///< Publicación del registro de cambios
+    ReorderForecaster* forecaster; ///< Ritmo de consumo por componente
+    QFutureWatcher<QVector<ReorderForecast>> forecastWatcher;
+    ComponentSnapshot snapshot;  ///< Copia mapeada para arranque en frío
+    bool snapshotFresh;          ///< La instantánea refleja el estado actual de la BD
+    bool databaseReady;          ///< initialize() ya abrió SQLite
+    quint64 writeGeneration;     ///< Se incrementa con cada escritura
+    quint64 reconcileGeneration; ///< Generación al lanzar la reconciliación
+    QFutureWatcher<bool> reconcileWatcher;
+    QTimer reconcileTimer;       ///< Agrupa ráfagas de escrituras en una sola regeneración
+    
+    TrigramIndex* searchIndex;   ///< Índice para búsqueda aproximada (nullptr mientras se construye)
+    QFutureWatcher<TrigramIndex*> indexWatcher;
+    QVector<QPair<bool, Component>> pendingIndexOps; ///< Cambios durante la construcción (true = baja)
+    
+    CommandJournal journal;      ///< Pilas de deshacer/rehacer
+    
+    MaintenanceScheduler* maintenance; ///< Vive en maintenanceThread
+    LowStockAggregator* lowStock; ///< Vive en lowStockThread
+    HttpService* httpService;    ///< nullptr hasta startHttpService()
+    TraceRecorder* recorder;     ///< nullptr si no se graba
+    QString* errorSink;          ///< Si no es nullptr, los errores van aquí en vez de a error()
+    QThread maintenanceThread;
+    QThread lowStockThread;
 };
 
 #endif // INVENTORY_MANAGER_H
@@ -0,0 +1,97 @@
+#include "lowstockaggregator.h"
+#include "databasemanager.h"
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QStringList>
+#include <QDebug>
+#include <algorithm>
+
+LowStockAggregator::LowStockAggregator(int threshold, QObject* parent)
+    : QObject(parent), threshold(threshold), intervalMs(5000), timer(nullptr), scanAll(true) {
+}
+
+void LowStockAggregator::start() {
+    // Se ejecuta ya en el hilo del agregador: el timer queda en ese hilo
+    timer = new QTimer(this);
+    timer->setSingleShot(true);
+    connect(timer, &QTimer::timeout, this, &LowStockAggregator::flush);
+    
+    // Resumen inicial con el stock que ya estaba bajo, sin esperar a un cambio
+    timer->start(0);
+}
+
+void LowStockAggregator::quantityChanged(int componentId, int previousQuantity, int quantity,
+                                         const QString& site, const QString& path) {
+    sitePaths.insert(site, path);
+    
+    if (quantity > threshold) {
+        pending[site].remove(componentId);   // Repuesto antes del aviso
+        return;
+    }
+    if (previousQuantity >= 0 && previousQuantity <= threshold) {
+        return;   // Ya estaba bajo el umbral: se avisó al cruzarlo
+    }
+    
+    pending[site].insert(componentId);
+    if (timer && !timer->isActive()) {
+        timer->start(intervalMs);
+    }
+}
+
+void LowStockAggregator::flush() {
+    QVector<Component> components;
+    if (scanAll) {
+        // El resumen inicial ya incluye lo que cruzó el umbral mientras tanto
+        scanAll = false;
+        pending.clear();
+        for (auto it = sitePaths.constBegin(); it != sitePaths.constEnd(); ++it) {
+            components += readSite(it.key(), nullptr);
+        }
+    } else {
+        for (auto it = pending.constBegin(); it != pending.constEnd(); ++it) {
+            if (!it.value().isEmpty()) {
+                components += readSite(it.key(), &it.value());
+            }
+        }
+        pending.clear();
+    }
+    
+    if (!components.isEmpty()) {
+        std::stable_sort(components.begin(), components.end(),
+                         [](const Component& a, const Component& b) {
+                             return a.getQuantity() < b.getQuantity();
+                         });
+        qWarning() << "¡ALERTA!" << components.size() << "componentes cruzaron el umbral de stock bajo";
+        emit summaryReady(components);
+    }
+}
+
+QVector<Component> LowStockAggregator::readSite(const QString& site, const QSet<int>* ids) {
+    // Los IDs son enteros propios, se pueden incrustar sin riesgo de inyección
+    QString idFilter;
+    if (ids) {
+        QStringList idList;
+        for (int id : *ids) {
+            idList << QString::number(id);
+        }
+        idFilter = "id IN (" + idList.join(',') + ") AND ";
+    }
+    
+    QSqlQuery query(DatabaseManager::connectionForThread(sitePaths.value(site)));
+    query.setForwardOnly(true);
+    query.prepare("SELECT * FROM componentes WHERE " + idFilter + "quantity <= :threshold");
+    query.bindValue(":threshold", threshold);
+    
+    QVector<Component> components;
+    if (!query.exec()) {
+        qCritical() << "Error leyendo stock bajo de la sede" << site << ":"
+                    << query.lastError().text();
+        return components;
+    }
+    while (query.next()) {
+        Component component = DatabaseManager::queryToComponent(query);
+        component.setSite(site);
+        components.append(component);
+    }
+    return components;
+}
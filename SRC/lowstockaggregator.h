@@ -0,0 +1,61 @@
+#ifndef LOWSTOCKAGGREGATOR_H
+#define LOWSTOCKAGGREGATOR_H
+
+#include <QObject>
+#include <QTimer>
+#include <QHash>
+#include <QSet>
+#include <QVector>
+#include "component.h"
+
+/**
+ * Agrupa las alertas de stock bajo en lugar de avisar en cada escritura.
+ *
+ * Recibe los cambios de cantidad, se queda con los componentes que cruzan el
+ * umbral (uno por componente; si se reponen antes del aviso se descartan) y
+ * emite un único resumen por intervalo. Vive en su propio hilo y relee los
+ * pendientes con su propia conexión al archivo de cada sede al emitir, así las
+ * escrituras no pagan ninguna consulta. Al arrancar emite un primer resumen con
+ * todo lo que ya estaba bajo el umbral en las sedes conocidas.
+ */
+class LowStockAggregator : public QObject {
+    Q_OBJECT
+
+public:
+    explicit LowStockAggregator(int threshold = 5, QObject* parent = nullptr);
+    
+    int getThreshold() const { return threshold; }
+    void setInterval(int ms) { intervalMs = ms; }
+    
+    /// Sede a revisar en el resumen inicial; llamar antes de arrancar el hilo
+    void addSite(const QString& site, const QString& path) { sitePaths.insert(site, path); }
+    
+    /// true si el cambio puede interesar al agregador (evita encolar el resto)
+    bool isRelevant(int previousQuantity, int quantity) const {
+        return quantity <= threshold || (previousQuantity >= 0 && previousQuantity <= threshold);
+    }
+
+public slots:
+    void start();
+    
+    /// previousQuantity < 0 = componente nuevo; path es el archivo de la sede
+    void quantityChanged(int componentId, int previousQuantity, int quantity,
+                         const QString& site, const QString& path);
+
+signals:
+    /// Componentes que siguen bajo el umbral, con su cantidad actual
+    void summaryReady(const QVector<Component>& components);
+
+private:
+    void flush();
+    QVector<Component> readSite(const QString& site, const QSet<int>* ids);
+    
+    int threshold;
+    int intervalMs;          ///< Separación mínima entre resúmenes
+    QTimer* timer;
+    bool scanAll;            ///< El próximo resumen revisa todas las sedes (arranque)
+    QHash<QString, QString> sitePaths;  ///< Sede -> archivo
+    QHash<QString, QSet<int>> pending;  ///< Por sede, componentes que cruzaron el umbral
+};
+
+#endif // LOWSTOCKAGGREGATOR_H
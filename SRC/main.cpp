@@ -1,11 +1,196 @@
 #include "mainwindow.h"
+#include "httploadgen.h"
+#include "tracereplayer.h"
+#include "maintenancescheduler.h"
 #include <QApplication>
+#include <QCommandLineParser>
+#include <QDir>
+#include <QFile>
+#include <QTemporaryDir>
+#include <QTextStream>
+
+namespace {
+/// Perfil de SQLite pedido con --db-profile; el modo de journal solo se elige al arrancar
+bool applyDatabaseProfile(const QString& name) {
+    PerformanceProfile profile;
+    if (name == "safe") {
+        profile = PerformanceProfile::Safe;
+    } else if (name == "balanced") {
+        profile = PerformanceProfile::Balanced;
+    } else if (name == "bulk") {
+        profile = PerformanceProfile::BulkLoad;
+    } else {
+        QTextStream(stderr) << "Perfil de base de datos desconocido: " << name << "\n";
+        return false;
+    }
+    return DatabaseManager::getInstance()->setPerformanceProfile(profile);
+}
+}
 
 int main(int argc, char *argv[]) {
+    QStringList arguments;
+    for (int i = 0; i < argc; ++i) {
+        arguments << QString::fromLocal8Bit(argv[i]);
+    }
+    
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Gestor de Inventario IoT");
+    parser.addHelpOption();
+    QCommandLineOption httpPortOption("http-port",
+        "Publica el servicio HTTP/JSON en el puerto indicado.", "puerto");
+    QCommandLineOption httpAddressOption("http-address",
+        "Dirección del servicio HTTP (por defecto 127.0.0.1; 0.0.0.0 lo expone a la red, "
+        "sin autenticación).", "ip", "127.0.0.1");
+    QCommandLineOption httpThreadsOption("http-threads",
+        "Hilos del servicio HTTP (por defecto, uno por núcleo).", "n");
+    QCommandLineOption loadgenOption("loadgen",
+        "Genera carga contra el servicio HTTP en 127.0.0.1:<puerto> y sale.", "puerto");
+    QCommandLineOption connectionsOption("connections", "Conexiones del generador.", "n", "8");
+    QCommandLineOption pipelineOption("pipeline", "Peticiones en vuelo por conexión.", "n", "4");
+    QCommandLineOption durationOption("duration", "Duración de la prueba en segundos.", "s", "10");
+    QCommandLineOption maxIdOption("max-id", "Mayor ID consultado.", "id", "1000");
+    QCommandLineOption adjustRatioOption("adjust-ratio",
+        "Fracción de ajustes de cantidad (modifica la BD).", "r", "0");
+    QCommandLineOption recordOption("record",
+        "Graba las llamadas al inventario en una traza binaria.", "archivo");
+    QCommandLineOption replayOption("replay",
+        "Reproduce una traza sobre una base de datos vacía y sale.", "archivo");
+    QCommandLineOption threadsOption("threads", "Hilos de la reproducción.", "n", "1");
+    QCommandLineOption fastOption("fast", "Reproducir sin respetar los tiempos originales.");
+    QCommandLineOption replayDirOption("replay-dir",
+        "Directorio de datos para la reproducción (por defecto, uno temporal).", "dir");
+    QCommandLineOption convertVacuumOption("convert-vacuum",
+        "Convierte a auto_vacuum incremental la base de datos y las sedes creadas antes "
+        "de usarlo (reescribe cada archivo; con la aplicación cerrada) y sale.");
+    QCommandLineOption dbProfileOption("db-profile",
+        "Perfil de SQLite: balanced (WAL, predeterminado), safe (journal clásico y "
+        "synchronous=FULL, como antes de existir los perfiles) o bulk.", "perfil", "balanced");
+    parser.addOptions({httpPortOption, httpAddressOption, httpThreadsOption, loadgenOption,
+                       connectionsOption, pipelineOption, durationOption, maxIdOption,
+                       adjustRatioOption, recordOption, replayOption, threadsOption,
+                       fastOption, replayDirOption, convertVacuumOption, dbProfileOption});
+    parser.parse(arguments);
+    
+    if (parser.isSet(loadgenOption)) {
+        // Modo consola: no abre la base de datos ni la ventana
+        QCoreApplication app(argc, argv);
+        HttpLoadGenerator::Options options;
+        options.port = quint16(parser.value(loadgenOption).toUInt());
+        options.connections = parser.value(connectionsOption).toInt();
+        options.pipeline = qMax(1, parser.value(pipelineOption).toInt());
+        options.durationMs = int(parser.value(durationOption).toDouble() * 1000);
+        options.maxId = qMax(1, parser.value(maxIdOption).toInt());
+        options.adjustRatio = parser.value(adjustRatioOption).toDouble();
+        
+        HttpLoadGenerator generator(options);
+        QObject::connect(&generator, &HttpLoadGenerator::finished, &app, [&app](const QString& report) {
+            QTextStream(stdout) << report;
+            app.quit();
+        });
+        generator.start();
+        return app.exec();
+    }
+    
+    if (parser.isSet(convertVacuumOption)) {
+        // Modo consola, sin la BD abierta: el VACUUM de cada archivo no bloquea ninguna GUI
+        QCoreApplication app(argc, argv);
+        app.setApplicationName("Gestor de Inventario IoT");
+        DatabaseManager* db = DatabaseManager::getInstance();
+        QStringList paths{db->getDatabasePath()};
+        QDir dir(db->getSitesDirectory());
+        for (const QString& file : dir.entryList({"*.db"}, QDir::Files, QDir::Name)) {
+            paths.append(dir.filePath(file));
+        }
+        
+        int failures = 0;
+        for (const QString& path : qAsConst(paths)) {
+            if (!QFile::exists(path)) {
+                continue;
+            }
+            QString error;
+            if (MaintenanceScheduler::convertToIncrementalVacuum(path, &error)) {
+                QTextStream(stdout) << path << ": auto_vacuum incremental\n";
+            } else {
+                QTextStream(stderr) << path << ": " << error << "\n";
+                ++failures;
+            }
+        }
+        return failures == 0 ? 0 : 1;
+    }
+    
+    if (parser.isSet(replayOption)) {
+        // Modo consola sobre una BD nueva: nunca toca el inventario real
+        QCoreApplication app(argc, argv);
+        app.setApplicationName("Gestor de Inventario IoT");
+        QTemporaryDir tempDir;
+        DatabaseManager::setDataDirectory(parser.isSet(replayDirOption)
+                                          ? parser.value(replayDirOption) : tempDir.path());
+        if (!applyDatabaseProfile(parser.value(dbProfileOption))) {
+            return 1;
+        }
+        
+        InventoryManager inventory;
+        TraceReplayer::Options options;
+        options.threads = qMax(1, parser.value(threadsOption).toInt());
+        options.fast = parser.isSet(fastOption);
+        TraceReplayer replayer(&inventory, options);
+        
+        QString error;
+        if (!replayer.load(parser.value(replayOption), &error)) {
+            QTextStream(stderr) << error << "\n";
+            return 1;
+        }
+        if (!inventory.initialize() || !inventory.restoreTraceState(replayer.initialState())) {
+            QTextStream(stderr) << "No se pudo preparar la base de datos de reproducción\n";
+            return 1;
+        }
+        QTextStream(stdout) << "Traza: " << replayer.eventCount() << " llamadas, "
+                            << replayer.initialState().components.size() << " componentes iniciales\n";
+        
+        QObject::connect(&replayer, &TraceReplayer::finished, &app, [&app](const QString& report) {
+            QTextStream(stdout) << report;
+            app.quit();
+        });
+        replayer.start();
+        return app.exec();
+    }
+    
     QApplication app(argc, argv);
     app.setApplicationName("Gestor de Inventario IoT");
     
+    if (parser.isSet("help")) {
+        parser.showHelp();
+    }
+    
+    // Antes de que MainWindow abra la base de datos
+    if (!applyDatabaseProfile(parser.value(dbProfileOption))) {
+        return 1;
+    }
+    
+    const QHostAddress address(parser.value(httpAddressOption));
+    if (parser.isSet(httpPortOption) && address.isNull()) {
+        QTextStream(stderr) << "Dirección HTTP inválida: " << parser.value(httpAddressOption) << "\n";
+        return 1;
+    }
+    
     MainWindow window;
+    
+    // Grabación y servicio HTTP necesitan la BD abierta, que se abre tras mostrar la ventana
+    QObject::connect(&window, &MainWindow::inventoryReady, &window,
+                     [&window, &parser, &recordOption, &httpPortOption, &httpThreadsOption,
+                      address]() {
+        InventoryManager* inventory = window.getInventoryManager();
+        if (parser.isSet(recordOption)) {
+            inventory->startTraceRecording(parser.value(recordOption));
+        }
+        if (parser.isSet(httpPortOption)) {
+            const int threads = parser.isSet(httpThreadsOption)
+                                ? parser.value(httpThreadsOption).toInt()
+                                : QThread::idealThreadCount();
+            inventory->startHttpService(quint16(parser.value(httpPortOption).toUInt()),
+                                        threads, address);
+        }
+    });
     window.show();
     
     return app.exec();
@@ -0,0 +1,209 @@
+#include "maintenancescheduler.h"
+#include <QDateTime>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QDebug>
+
+namespace {
+const qint64 kMaxWriteMs = 5;        // Objetivo por paso de vacuum
+const int kMinStepPages = 8;
+const int kMaxStepPages = 1024;
+
+qint64 pragmaValue(QSqlQuery& query, const QString& pragma) {
+    if (!query.exec("PRAGMA " + pragma) || !query.next()) {
+        return -1;
+    }
+    return query.value(0).toLongLong();
+}
+}
+
+MaintenanceScheduler::MaintenanceScheduler(const QString& dbPath, const QString& sitesDir,
+                                           QObject* parent)
+    : QObject(parent), dbPath(dbPath), sitesDir(sitesDir), timer(nullptr),
+      lastActivityMs(QDateTime::currentMSecsSinceEpoch()), stopping(0), lastRunMs(0),
+      idleMs(30000), intervalMs(3600000), vacuumStepPages(64) {
+}
+
+void MaintenanceScheduler::noteActivity() {
+    lastActivityMs.storeRelease(QDateTime::currentMSecsSinceEpoch());
+}
+
+void MaintenanceScheduler::start() {
+    // Se ejecuta ya en el hilo de mantenimiento: el timer queda en ese hilo
+    timer = new QTimer(this);
+    timer->setInterval(60000);
+    connect(timer, &QTimer::timeout, this, &MaintenanceScheduler::tick);
+    timer->start();
+}
+
+void MaintenanceScheduler::stop() {
+    stopping.storeRelease(1);   // Corta pasos pendientes aunque se llame desde otro hilo
+}
+
+void MaintenanceScheduler::runNow() {
+    lastRunMs = 0;
+    tick();
+}
+
+bool MaintenanceScheduler::isIdle() const {
+    return !stopping.loadAcquire() &&
+           QDateTime::currentMSecsSinceEpoch() - lastActivityMs.loadAcquire() >= idleMs;
+}
+
+void MaintenanceScheduler::tick() {
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    if (!isIdle() || (lastRunMs > 0 && now - lastRunMs < intervalMs)) {
+        return;
+    }
+    lastRunMs = now;
+    
+    QStringList paths{dbPath};
+    QDir dir(sitesDir);
+    for (const QString& file : dir.entryList({"*.db"}, QDir::Files, QDir::Name)) {
+        paths.append(dir.filePath(file));
+    }
+    
+    for (const QString& path : qAsConst(paths)) {
+        MaintenanceReport report = maintainFile(path);
+        qDebug() << "Mantenimiento" << path << "- recuperados" << report.reclaimedBytes
+                 << "bytes, escritura máx." << report.longestWriteMs << "ms"
+                 << (report.interrupted ? "(interrumpido)" : "");
+        emit maintenanceFinished(report);
+        if (report.interrupted) {
+            lastRunMs = 0;   // Reintentar en la próxima ventana de inactividad
+            break;
+        }
+    }
+}
+
+MaintenanceReport MaintenanceScheduler::maintainFile(const QString& path) {
+    MaintenanceReport report;
+    report.path = path;
+    
+    // Conexión solo para esta pasada: se cierra y se elimina al terminar
+    const QString name = QString("maintenance_%1").arg(qHash(path));
+    {
+        QSqlDatabase conn = QSqlDatabase::addDatabase("QSQLITE", name);
+        conn.setDatabaseName(path);
+        if (conn.open()) {
+            maintainConnection(conn, &report);
+            conn.close();
+        } else {
+            qWarning() << "Mantenimiento: no se pudo abrir" << path << conn.lastError().text();
+            report.interrupted = true;
+        }
+    }
+    QSqlDatabase::removeDatabase(name);
+    return report;
+}
+
+bool MaintenanceScheduler::convertToIncrementalVacuum(const QString& path, QString* error) {
+    bool converted = false;
+    const QString name = QString("vacuum_conversion_%1").arg(qHash(path));
+    {
+        QSqlDatabase conn = QSqlDatabase::addDatabase("QSQLITE", name);
+        conn.setDatabaseName(path);
+        if (conn.open()) {
+            QSqlQuery query(conn);
+            QElapsedTimer timer;
+            timer.start();
+            // El modo solo cambia con VACUUM; si el archivo está en uso, falla con SQLITE_BUSY
+            converted = pragmaValue(query, "auto_vacuum") == 2 ||
+                        (query.exec("PRAGMA auto_vacuum = INCREMENTAL") && query.exec("VACUUM"));
+            if (converted) {
+                qDebug() << path << "usa auto_vacuum incremental (" << timer.elapsed() << "ms)";
+            } else if (error) {
+                *error = query.lastError().text();
+            }
+            conn.close();
+        } else if (error) {
+            *error = conn.lastError().text();
+        }
+    }
+    QSqlDatabase::removeDatabase(name);
+    return converted;
+}
+
+void MaintenanceScheduler::maintainConnection(QSqlDatabase& conn, MaintenanceReport* report) {
+    const QString& path = report->path;
+    QSqlQuery query(conn);
+    QElapsedTimer timer;
+    
+    // Si la app está escribiendo, ceder enseguida en vez de esperar el bloqueo
+    query.exec("PRAGMA busy_timeout = 20");
+    const qint64 pageSize = pragmaValue(query, "page_size");
+    const qint64 freeBefore = pragmaValue(query, "freelist_count");
+    query.exec("PRAGMA journal_mode");
+    const bool wal = query.next() && query.value(0).toString().compare("wal", Qt::CaseInsensitive) == 0;
+    
+    // 1. Estadísticas del planificador; analysis_limit acota lo que lee ANALYZE
+    timer.start();
+    query.exec("PRAGMA analysis_limit = 400");
+    if (!query.exec("PRAGMA optimize")) {
+        qWarning() << "PRAGMA optimize falló:" << query.lastError().text();
+    }
+    report->optimizeMs = timer.elapsed();
+    report->longestWriteMs = report->optimizeMs;
+    
+    // 2. Vacuum incremental; los archivos antiguos solo se convierten a petición
+    timer.start();
+    if (pragmaValue(query, "auto_vacuum") == 2) {
+        while (isIdle() && pragmaValue(query, "freelist_count") > 0) {
+            QElapsedTimer step;
+            step.start();
+            if (!query.exec(QString("PRAGMA incremental_vacuum(%1)").arg(vacuumStepPages))) {
+                break;   // Probablemente SQLITE_BUSY: la app tomó el bloqueo
+            }
+            while (query.next()) {
+                // Cada fila devuelta libera una página; hay que recorrerlas todas
+            }
+            query.finish();
+            
+            const qint64 elapsed = step.elapsed();
+            report->longestWriteMs = qMax(report->longestWriteMs, elapsed);
+            ++report->vacuumSteps;
+            if (elapsed > kMaxWriteMs) {
+                vacuumStepPages = qMax(kMinStepPages, vacuumStepPages / 2);
+            } else if (elapsed * 4 < kMaxWriteMs) {
+                vacuumStepPages = qMin(kMaxStepPages, vacuumStepPages * 2);
+            }
+        }
+    } else {
+        report->conversionNeeded = true;
+        qWarning() << path << "no usa auto_vacuum incremental; se omiten" << freeBefore
+                   << "páginas libres (requiere conversión: --convert-vacuum)";
+    }
+    report->vacuumMs = timer.elapsed();
+    
+    const qint64 freeAfter = pragmaValue(query, "freelist_count");
+    if (freeBefore > 0 && freeAfter >= 0 && pageSize > 0) {
+        report->reclaimedBytes = (freeBefore - freeAfter) * pageSize;
+    }
+    
+    // 3. Checkpoint PASSIVE: copia lo que puede sin esperar a lectores ni escritores
+    timer.start();
+    if (wal && query.exec("PRAGMA wal_checkpoint(PASSIVE)") && query.next()) {
+        report->checkpointedFrames = query.value(2).toInt();
+    }
+    report->checkpointMs = timer.elapsed();
+    
+    // 4. quick_check recorre todo el archivo; solo en WAL, donde no bloquea escrituras
+    if (wal && isIdle()) {
+        timer.start();
+        if (query.exec("PRAGMA quick_check(1)") && query.next()) {
+            report->integrityChecked = true;
+            report->integrityMessage = query.value(0).toString();
+            report->integrityOk = report->integrityMessage == "ok";
+            if (!report->integrityOk) {
+                qCritical() << "quick_check en" << path << ":" << report->integrityMessage;
+            }
+        }
+        query.finish();
+        report->checkMs = timer.elapsed();
+    }
+    
+    report->interrupted = !isIdle();
+}
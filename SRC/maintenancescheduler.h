@@ -0,0 +1,85 @@
+#ifndef MAINTENANCESCHEDULER_H
+#define MAINTENANCESCHEDULER_H
+
+#include <QObject>
+#include <QTimer>
+#include <QAtomicInteger>
+#include <QMetaType>
+#include <QString>
+#include <QSqlDatabase>
+
+/// Resultado de una pasada de mantenimiento sobre un archivo
+struct MaintenanceReport {
+    QString path;
+    qint64 reclaimedBytes = 0;     ///< Páginas libres devueltas al sistema de archivos
+    int vacuumSteps = 0;
+    int checkpointedFrames = 0;
+    bool integrityChecked = false;
+    bool integrityOk = true;
+    QString integrityMessage;
+    qint64 optimizeMs = 0;
+    qint64 vacuumMs = 0;
+    qint64 checkpointMs = 0;
+    qint64 checkMs = 0;
+    qint64 longestWriteMs = 0;     ///< Mayor tiempo con el bloqueo de escritura tomado
+    bool interrupted = false;      ///< Se cortó porque la aplicación volvió a escribir
+    bool conversionNeeded = false; ///< Sin auto_vacuum incremental: ver convertToIncrementalVacuum
+};
+Q_DECLARE_METATYPE(MaintenanceReport)
+
+/**
+ * Mantenimiento de SQLite en segundo plano: PRAGMA optimize, vacuum
+ * incremental, checkpoint del WAL y quick_check.
+ *
+ * Vive en su propio hilo y solo trabaja cuando no hubo escrituras durante un
+ * rato; abre una conexión por pasada y la cierra al terminar, así no deja el
+ * archivo abierto entre pasadas. El vacuum avanza en pasos cortos cuyo tamaño
+ * se ajusta para no retener el bloqueo de escritura más de unos milisegundos.
+ *
+ * Los archivos creados antes de auto_vacuum incremental no se tocan: la pasada
+ * informa conversionNeeded y la conversión (un VACUUM completo) es un paso
+ * explícito con la aplicación cerrada (--convert-vacuum).
+ */
+class MaintenanceScheduler : public QObject {
+    Q_OBJECT
+
+public:
+    MaintenanceScheduler(const QString& dbPath, const QString& sitesDir,
+                         QObject* parent = nullptr);
+    
+    /// Se puede llamar desde cualquier hilo (conectado a dataChanged)
+    void noteActivity();
+    
+    void setIdleThreshold(int ms) { idleMs = ms; }
+    void setInterval(int ms) { intervalMs = ms; }
+    
+    /// Pasa un archivo a auto_vacuum incremental con VACUUM, que lo reescribe entero y
+    /// bloquea cualquier otro acceso; solo con la aplicación cerrada y fuera del hilo de la GUI
+    static bool convertToIncrementalVacuum(const QString& path, QString* error = nullptr);
+
+public slots:
+    void start();
+    void stop();
+    void runNow();
+
+signals:
+    void maintenanceFinished(const MaintenanceReport& report);
+
+private:
+    void tick();
+    bool isIdle() const;
+    MaintenanceReport maintainFile(const QString& path);
+    void maintainConnection(QSqlDatabase& conn, MaintenanceReport* report);
+    
+    QString dbPath;
+    QString sitesDir;
+    QTimer* timer;
+    QAtomicInteger<qint64> lastActivityMs;
+    QAtomicInt stopping;
+    qint64 lastRunMs;
+    int idleMs;              ///< Tiempo sin escrituras para considerar la app inactiva
+    int intervalMs;          ///< Separación mínima entre pasadas
+    int vacuumStepPages;     ///< Páginas por paso de incremental_vacuum (adaptativo)
+};
+
+#endif // MAINTENANCESCHEDULER_H
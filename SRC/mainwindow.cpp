@@ -1,7 +1,10 @@
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
 #include <QMessageBox>
+#include <QAction>
+#include <QHeaderView>
 #include <QDate>
+#include <QTimer>
 #include <QDebug>
 
 MainWindow::MainWindow(QWidget *parent)
@@ -15,26 +18,51 @@ MainWindow::MainWindow(QWidget *parent)
     
     setWindowTitle("Gestor de Inventario - IoT Lab");
     
-    if (!inventoryManager->initialize()) {
-        QMessageBox::critical(this, "Error de Inicialización",
-            "No se pudo inicializar el sistema.\n"
-            "Verifique que SQLite esté instalado y tenga permisos de escritura.");
-    }
-    
     setupTable();
     
     connect(inventoryManager, &InventoryManager::lowStockAlert,
             this, &MainWindow::onLowStockAlert);
     connect(inventoryManager, &InventoryManager::error,
             this, &MainWindow::onError);
-    
-    refreshTable();
+    connect(inventoryManager, &InventoryManager::snapshotReconciled,
+            this, &MainWindow::onSnapshotReconciled);
+    
+    // Deshacer / rehacer en el menú Herramientas (Ctrl+Z / Ctrl+Y)
+    undoAction = ui->menuHerramientas->addAction("Deshacer", this, &MainWindow::onUndo);
+    undoAction->setShortcut(QKeySequence::Undo);
+    redoAction = ui->menuHerramientas->addAction("Rehacer", this, &MainWindow::onRedo);
+    redoAction->setShortcut(QKeySequence::Redo);
+    connect(inventoryManager, &InventoryManager::journalChanged,
+            this, &MainWindow::updateUndoActions);
+    updateUndoActions();
     
     ui->dateEdit->setDate(QDate::currentDate());
     
-    checkLowStock();
+    // La ventana se muestra con la instantánea (quizá desactualizada) sin esperar a
+    // SQLite; hasta abrir la BD solo se puede consultar
+    if (inventoryManager->openSnapshot()) {
+        refreshTable();
+    }
+    centralWidget()->setEnabled(false);
+    showStatusMessage("Abriendo la base de datos...");
+    QTimer::singleShot(0, this, &MainWindow::initializeInventory);
+}
+
+void MainWindow::initializeInventory() {
+    if (!inventoryManager->initialize()) {
+        QMessageBox::critical(this, "Error de Inicialización",
+            "No se pudo inicializar el sistema.\n"
+            "Verifique que SQLite esté instalado y tenga permisos de escritura.");
+    }
     
+    // Con la instantánea al día la tabla ya es correcta; si no, se lee de SQLite.
+    // El stock bajo al arrancar llega como primer resumen del agregador (onLowStockAlert)
+    if (!inventoryManager->isSnapshotFresh()) {
+        refreshTable();
+    }
+    centralWidget()->setEnabled(true);
     showStatusMessage("Sistema listo", 3000);
+    emit inventoryReady();
 }
 
 MainWindow::~MainWindow() {
@@ -156,10 +184,6 @@ void MainWindow::on_addButton_clicked() {
         QMessageBox::information(this, "Éxito", "Componente agregado correctamente");
         clearForm();
         refreshTable();
-        
-        if (component.getQuantity() <= 5) {
-            checkLowStock();
-        }
     }
 }
 
@@ -184,7 +208,6 @@ void MainWindow::on_updateButton_clicked() {
         QMessageBox::information(this, "Éxito", "Componente actualizado correctamente");
         clearForm();
         refreshTable();
-        checkLowStock();
     }
 }
 
@@ -220,6 +243,13 @@ void MainWindow::on_searchEdit_textChanged(const QString &text) {
     
     QVector<Component> components = inventoryManager->searchComponents(text);
     
+    // Sin coincidencias exactas: probar búsqueda tolerante a errores de tipeo
+    bool fuzzy = false;
+    if (components.isEmpty() && text.size() >= 3) {
+        components = inventoryManager->searchComponents(text, SearchMode::Fuzzy);
+        fuzzy = true;
+    }
+    
     for (const Component& component : components) {
         QList<QStandardItem*> row;
         row << new QStandardItem(QString::number(component.getId()));
@@ -236,7 +266,8 @@ void MainWindow::on_searchEdit_textChanged(const QString &text) {
         tableModel->appendRow(row);
     }
     
-    showStatusMessage(QString("Búsqueda: %1 resultados").arg(components.size()));
+    showStatusMessage(QString(fuzzy ? "Búsqueda aproximada: %1 resultados"
+                                    : "Búsqueda: %1 resultados").arg(components.size()));
 }
 
 void MainWindow::on_tableView_clicked(const QModelIndex &index) {
@@ -264,17 +295,67 @@ void MainWindow::onLowStockAlert(const QVector<Component>& components) {
     
     QString message = QString("⚠️ ALERTA: %1 componentes con stock bajo\n\n").arg(components.size());
     
-    for (const Component& comp : components) {
-        message += QString("• %1 (%2): %3 unidades\n")
+    const int shown = qMin(components.size(), 20);
+    for (int i = 0; i < shown; ++i) {
+        const Component& comp = components[i];
+        const QString site = DatabaseManager::isMainSite(comp.getSite())
+            ? QString() : QString(" [%1]").arg(comp.getSite());
+        message += QString("• %1 (%2)%3: %4 unidades\n")
             .arg(comp.getName())
             .arg(comp.getType())
+            .arg(site)
             .arg(comp.getQuantity());
     }
+    if (components.size() > shown) {
+        message += QString("… y %1 más\n").arg(components.size() - shown);
+    }
     
-    QMessageBox::warning(this, "Alerta de Stock Bajo", message);
+    // Un único aviso no modal: si sigue abierto se actualiza en lugar de apilar otro
+    if (!lowStockBox) {
+        lowStockBox = new QMessageBox(QMessageBox::Warning, "Alerta de Stock Bajo",
+                                      QString(), QMessageBox::Ok, this);
+        lowStockBox->setModal(false);
+        lowStockBox->setAttribute(Qt::WA_DeleteOnClose);
+    }
+    lowStockBox->setText(message);
+    lowStockBox->show();
     showStatusMessage(QString("Alerta: %1 componentes con stock bajo").arg(components.size()), 10000);
 }
 
+void MainWindow::onSnapshotReconciled() {
+    // La tabla pudo cargarse de una instantánea anterior; no pisar una búsqueda en curso
+    if (ui->searchEdit->text().isEmpty()) {
+        refreshTable();
+    }
+}
+
+void MainWindow::onUndo() {
+    const QString label = inventoryManager->undoText();
+    if (inventoryManager->undo()) {
+        clearForm();
+        refreshTable();
+        showStatusMessage("Deshecho: " + label, 5000);
+    }
+}
+
+void MainWindow::onRedo() {
+    const QString label = inventoryManager->redoText();
+    if (inventoryManager->redo()) {
+        clearForm();
+        refreshTable();
+        showStatusMessage("Rehecho: " + label, 5000);
+    }
+}
+
+void MainWindow::updateUndoActions() {
+    undoAction->setEnabled(inventoryManager->canUndo());
+    undoAction->setText(inventoryManager->canUndo()
+                        ? "Deshacer " + inventoryManager->undoText() : "Deshacer");
+    redoAction->setEnabled(inventoryManager->canRedo());
+    redoAction->setText(inventoryManager->canRedo()
+                        ? "Rehacer " + inventoryManager->redoText() : "Rehacer");
+}
+
 void MainWindow::onError(const QString& errorMessage) {
     QMessageBox::critical(this, "Error del Sistema", errorMessage);
     showStatusMessage("Error: " + errorMessage, 10000);
@@ -3,6 +3,9 @@
 
 #include <QMainWindow>
 #include <QStandardItemModel>
+#include <QAction>
+#include <QMessageBox>
+#include <QPointer>
 #include "component.h"
 #include "inventory_manager.h"
 
@@ -17,16 +20,43 @@ public:
     MainWindow(QWidget *parent = nullptr);
     ~MainWindow();
     
+    InventoryManager* getInventoryManager() const { return inventoryManager; }
+    
+signals:
+    /// La base de datos quedó abierta (la ventana ya se mostró con la instantánea)
+    void inventoryReady();
+    
 private slots:
+    void initializeInventory();
     void on_addButton_clicked();
+    void on_updateButton_clicked();
+    void on_deleteButton_clicked();
     void on_searchEdit_textChanged(const QString &text);
+    void on_tableView_clicked(const QModelIndex &index);
+    void on_checkStockButton_clicked();
+    void on_clearButton_clicked();
+    void onLowStockAlert(const QVector<Component>& components);
+    void onError(const QString& errorMessage);
+    void onSnapshotReconciled();
+    void onUndo();
+    void onRedo();
+    void updateUndoActions();
     
 private:
     Ui::MainWindow *ui;
     InventoryManager* inventoryManager;
     QStandardItemModel* tableModel;
+    int currentComponentId;
+    QAction* undoAction;
+    QAction* redoAction;
+    QPointer<QMessageBox> lowStockBox;  ///< Aviso no modal, reutilizado mientras esté abierto
     void setupTable();
     void refreshTable();
+    void clearForm();
+    void loadComponentToForm(const Component& component);
+    Component getComponentFromForm() const;
+    void showStatusMessage(const QString& message, int timeout = 0);
+    void checkLowStock();
 };
 
 #endif // MAINWINDOW_H
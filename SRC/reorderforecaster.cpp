@@ -0,0 +1,190 @@
+#include "reorderforecaster.h"
+#include <QtConcurrent>
+#include <algorithm>
+#include <cmath>
+#include <QDebug>
+
+namespace {
+const double kMsPerDay = 86400000.0;
+
+// Edad mínima de una serie para la corrección de arranque: un único retiro
+// cuenta como el consumo de un día, no como un ritmo infinito
+const double kMinAgeDays = 1.0;
+}
+
+ReorderForecaster::ReorderForecaster(DatabaseManager* dbManager, QObject* parent)
+    : QObject(parent), dbManager(dbManager),
+      tauDays(30.0), leadTimeDays(7), coverageDays(30) {
+    
+    flushTimer.setInterval(5000);
+    connect(&flushTimer, &QTimer::timeout, this, &ReorderForecaster::flush);
+}
+
+bool ReorderForecaster::load() {
+    states = dbManager->getConsumptionStates();
+    dirty.clear();
+    flushTimer.start();
+    qDebug() << "Estado de consumo cargado:" << states.size() << "componentes";
+    return true;
+}
+
+bool ReorderForecaster::flush() {
+    if (dirty.isEmpty()) {
+        return true;
+    }
+    
+    QHash<int, ConsumptionState> changed;
+    QVector<int> removed;
+    for (int id : qAsConst(dirty)) {
+        auto it = states.constFind(id);
+        if (it != states.constEnd()) {
+            changed.insert(id, it.value());
+        } else {
+            removed.append(id);
+        }
+    }
+    
+    if (!dbManager->saveConsumptionStates(changed, removed)) {
+        return false;   // Se reintenta en el próximo ciclo
+    }
+    dirty.clear();
+    return true;
+}
+
+void ReorderForecaster::recordConsumption(int componentId, int units, qint64 timestampMs) {
+    if (units <= 0) {
+        return;
+    }
+    
+    // Decaer lo acumulado hasta ahora y sumar el nuevo consumo: O(1)
+    ConsumptionState& state = states[componentId];
+    if (state.lastEventMs == 0) {
+        state.firstEventMs = timestampMs;   // Serie nueva
+    }
+    if (state.lastEventMs > 0 && timestampMs > state.lastEventMs) {
+        const double elapsedDays = (timestampMs - state.lastEventMs) / kMsPerDay;
+        state.decayedUnits *= std::exp(-elapsedDays / tauDays);
+    }
+    state.decayedUnits += units;
+    state.lastEventMs = qMax(state.lastEventMs, timestampMs);
+    dirty.insert(componentId);
+}
+
+void ReorderForecaster::revertConsumption(int componentId, int units, qint64 timestampMs) {
+    auto it = states.find(componentId);
+    if (units <= 0 || it == states.end()) {
+        return;
+    }
+    
+    // Aproximado: se resta el retiro completo aunque ya haya decaído; nunca baja de cero
+    ConsumptionState& state = it.value();
+    if (timestampMs > state.lastEventMs) {
+        const double elapsedDays = (timestampMs - state.lastEventMs) / kMsPerDay;
+        state.decayedUnits *= std::exp(-elapsedDays / tauDays);
+        state.lastEventMs = timestampMs;
+    }
+    state.decayedUnits = qMax(0.0, state.decayedUnits - units);
+    dirty.insert(componentId);
+}
+
+void ReorderForecaster::forgetComponent(int componentId) {
+    if (states.remove(componentId) > 0) {
+        dirty.insert(componentId);
+    }
+}
+
+double ReorderForecaster::dailyRate(int componentId, qint64 nowMs) const {
+    auto it = states.constFind(componentId);
+    if (it == states.constEnd()) {
+        return 0.0;
+    }
+    return rateAt(it.value(), nowMs, tauDays);
+}
+
+double ReorderForecaster::rateAt(const ConsumptionState& state, qint64 nowMs, double tauDays) {
+    const double elapsedDays = qMax<qint64>(0, nowMs - state.lastEventMs) / kMsPerDay;
+    const double decayed = state.decayedUnits * std::exp(-elapsedDays / tauDays);
+    if (state.firstEventMs <= 0) {
+        return decayed / tauDays;   // Serie anterior a la corrección: se supone madura
+    }
+    
+    // Con ritmo constante r desde el inicio, el acumulado vale r·tau·(1 − e^(−edad/tau))
+    const double ageDays = qMax(kMinAgeDays, (nowMs - state.firstEventMs) / kMsPerDay);
+    return decayed / (tauDays * (1.0 - std::exp(-ageDays / tauDays)));
+}
+
+ReorderForecast ReorderForecaster::forecast(const Component& component, qint64 nowMs) const {
+    auto it = states.constFind(component.getId());
+    return computeForecast(component, it != states.constEnd() ? &it.value() : nullptr,
+                           nowMs, tauDays, leadTimeDays, coverageDays);
+}
+
+ReorderForecast ReorderForecaster::computeForecast(const Component& component,
+                                                   const ConsumptionState* state,
+                                                   qint64 nowMs, double tauDays,
+                                                   int leadTimeDays, int coverageDays) {
+    ReorderForecast result;
+    result.componentId = component.getId();
+    result.name = component.getName();
+    result.quantity = component.getQuantity();
+    
+    if (!state || state->decayedUnits <= 0.0) {
+        return result;
+    }
+    
+    result.dailyRate = rateAt(*state, nowMs, tauDays);
+    if (result.dailyRate <= 0.0) {
+        return result;
+    }
+    
+    result.daysUntilStockout = result.quantity / result.dailyRate;
+    const int target = int(std::ceil(result.dailyRate * (leadTimeDays + coverageDays)));
+    result.suggestedOrder = qMax(0, target - result.quantity);
+    return result;
+}
+
+QFuture<QVector<ReorderForecast>> ReorderForecaster::forecastAll(
+        const QVector<Component>& components) const {
+    // Copias implícitamente compartidas: el hilo de la GUI puede seguir escribiendo
+    const QHash<int, ConsumptionState> stateCopy = states;
+    const qint64 nowMs = QDateTime::currentMSecsSinceEpoch();
+    const double tau = tauDays;
+    const int lead = leadTimeDays;
+    const int coverage = coverageDays;
+    
+    return QtConcurrent::run([components, stateCopy, nowMs, tau, lead, coverage]() {
+        const int chunkSize = 16384;
+        QVector<int> chunks;
+        for (int start = 0; start < components.size(); start += chunkSize) {
+            chunks.append(start);
+        }
+        
+        QVector<QVector<ReorderForecast>> parts(chunks.size());
+        QVector<ReorderForecast>* partData = parts.data();   // Cada tarea escribe solo su trozo
+        QtConcurrent::blockingMap(chunks, [&](int& start) {
+            QVector<ReorderForecast>& part = partData[start / chunkSize];
+            const int end = qMin(start + chunkSize, components.size());
+            for (int i = start; i < end; ++i) {
+                auto it = stateCopy.constFind(components[i].getId());
+                if (it == stateCopy.constEnd()) {
+                    continue;
+                }
+                ReorderForecast f = computeForecast(components[i], &it.value(),
+                                                    nowMs, tau, lead, coverage);
+                if (f.daysUntilStockout >= 0.0 && f.daysUntilStockout <= lead) {
+                    part.append(f);
+                }
+            }
+        });
+        
+        QVector<ReorderForecast> urgent;
+        for (const QVector<ReorderForecast>& part : parts) {
+            urgent += part;
+        }
+        std::sort(urgent.begin(), urgent.end(),
+                  [](const ReorderForecast& a, const ReorderForecast& b) {
+                      return a.daysUntilStockout < b.daysUntilStockout;
+                  });
+        return urgent;
+    });
+}
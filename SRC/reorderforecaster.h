@@ -0,0 +1,71 @@
+#ifndef REORDERFORECASTER_H
+#define REORDERFORECASTER_H
+
+#include <QObject>
+#include <QHash>
+#include <QSet>
+#include <QTimer>
+#include <QFuture>
+#include "databasemanager.h"
+
+/// Pronóstico de reposición para un componente
+struct ReorderForecast {
+    int componentId = -1;
+    QString name;
+    int quantity = 0;
+    double dailyRate = 0.0;          ///< Unidades consumidas por día (estimado)
+    double daysUntilStockout = -1.0; ///< -1 si no hay consumo registrado
+    int suggestedOrder = 0;
+};
+
+/**
+ * Estima el ritmo de consumo por componente con una media exponencial
+ * ponderada en el tiempo: cada retiro suma sus unidades a un acumulado que
+ * decae con constante 'tau'. Registrar un consumo es O(1) y el ritmo sale de
+ * acumulado / tau, sin recorrer el historial. En una serie joven (edad < tau)
+ * el acumulado aún no se ha llenado y se divide por tau·(1 − e^(−edad/tau)).
+ * El estado se guarda por lotes en la tabla 'consumo'.
+ */
+class ReorderForecaster : public QObject {
+    Q_OBJECT
+
+public:
+    explicit ReorderForecaster(DatabaseManager* dbManager, QObject* parent = nullptr);
+    
+    bool load();
+    bool flush();
+    
+    void recordConsumption(int componentId, int units,
+                           qint64 timestampMs = QDateTime::currentMSecsSinceEpoch());
+    /// Descuenta un consumo ya registrado (p. ej. al deshacer un retiro)
+    void revertConsumption(int componentId, int units,
+                           qint64 timestampMs = QDateTime::currentMSecsSinceEpoch());
+    void forgetComponent(int componentId);
+    
+    double dailyRate(int componentId, qint64 nowMs = QDateTime::currentMSecsSinceEpoch()) const;
+    ReorderForecast forecast(const Component& component,
+                             qint64 nowMs = QDateTime::currentMSecsSinceEpoch()) const;
+    
+    /// Pronóstico en paralelo; devuelve los que se agotan antes del plazo de reposición
+    QFuture<QVector<ReorderForecast>> forecastAll(const QVector<Component>& components) const;
+    
+    void setLeadTimeDays(int days) { leadTimeDays = days; }
+    void setCoverageDays(int days) { coverageDays = days; }
+
+private:
+    static double rateAt(const ConsumptionState& state, qint64 nowMs, double tauDays);
+    static ReorderForecast computeForecast(const Component& component,
+                                           const ConsumptionState* state,
+                                           qint64 nowMs, double tauDays,
+                                           int leadTimeDays, int coverageDays);
+    
+    DatabaseManager* dbManager;
+    QHash<int, ConsumptionState> states;
+    QSet<int> dirty;
+    QTimer flushTimer;
+    double tauDays;        ///< Constante de tiempo de la media (días)
+    int leadTimeDays;      ///< Plazo típico del proveedor
+    int coverageDays;      ///< Días de stock a cubrir con cada pedido
+};
+
+#endif // REORDERFORECASTER_H
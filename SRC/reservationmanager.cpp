@@ -0,0 +1,328 @@
+#include "reservationmanager.h"
+#include <QDebug>
+
+ReservationManager::ReservationManager(DatabaseManager* dbManager, QObject* parent)
+    : QObject(parent), dbManager(dbManager), nextId(1), dirty(false), failedFlushes(0) {
+    
+    // Los cambios se acumulan en memoria y se vuelcan en una sola transacción
+    flushTimer.setInterval(1000);
+    connect(&flushTimer, &QTimer::timeout, this, &ReservationManager::flush);
+}
+
+bool ReservationManager::load() {
+    QVector<Reservation> stored = dbManager->getReservations();
+    QHash<int, quint32> reservedByComponent;
+    qint64 maxId = 0;
+    
+    for (const Reservation& reservation : stored) {
+        shardFor(reservation.id).open.insert(reservation.id, reservation);
+        reservedByComponent[reservation.componentId] += reservation.quantity;
+        maxId = qMax(maxId, reservation.id);
+    }
+    nextId = maxId + 1;
+    
+    // Un contador por componente desde el arranque: reservar, consultar o
+    // ajustar nunca lee la BD, ni puede hacerlo con una cantidad a medio escribir
+    const QVector<QPair<int, int>> quantities = dbManager->getQuantities();
+    QWriteLocker locker(&countersLock);
+    counters.clear();
+    counters.reserve(size_t(quantities.size()));
+    for (const QPair<int, int>& entry : quantities) {
+        counters.try_emplace(entry.first, pack(quint32(qMax(0, entry.second)),
+                                               reservedByComponent.value(entry.first)));
+    }
+    
+    flushTimer.start();
+    qDebug() << "Reservas cargadas:" << stored.size() << "contadores:" << counters.size();
+    return true;
+}
+
+bool ReservationManager::flush() {
+    if (!dirty.exchange(false)) {
+        return true;
+    }
+    
+    Batch batch;
+    for (Shard& shard : shards) {
+        QMutexLocker locker(&shard.mutex);
+        take(shard, batch);
+    }
+    
+    if (persist(batch) || persistInParts(batch)) {
+        return true;
+    }
+    
+    // Reintentar en el próximo ciclo sin perder el lote
+    QMutexLocker locker(&shards[0].mutex);
+    requeue(shards[0], batch);
+    return false;
+}
+
+bool ReservationManager::writeQuantity(int componentId, int quantity,
+                                       const std::function<bool()>& write) {
+    // Un commit toma el mutex de su fragmento para encolar el consumo y ajustar el
+    // contador; con todos tomados, ninguno queda entre el volcado y la cantidad absoluta
+    for (Shard& shard : shards) {
+        shard.mutex.lock();
+    }
+    dirty = false;
+    Batch batch;
+    for (Shard& shard : shards) {
+        take(shard, batch);
+    }
+    
+    // Sin los consumos pendientes en la BD, la cantidad absoluta los pisaría
+    bool ok = batch.isEmpty() || persist(batch);
+    if (!ok) {
+        requeue(shards[0], batch);
+    }
+    ok = ok && write();
+    if (ok) {
+        setQuantity(componentId, quantity);
+    }
+    
+    for (Shard& shard : shards) {
+        shard.mutex.unlock();
+    }
+    return ok;
+}
+
+void ReservationManager::take(Shard& shard, Batch& batch) {
+    batch.added += shard.pendingAdded;
+    batch.released += shard.pendingReleased;
+    batch.committed += shard.pendingCommitted;
+    shard.pendingAdded.clear();
+    shard.pendingReleased.clear();
+    shard.pendingCommitted.clear();
+}
+
+bool ReservationManager::persist(const Batch& batch) {
+    // Cada reserva consumida se cierra en la misma transacción que su consumo
+    QVector<qint64> removed = batch.released;
+    QHash<int, int> consumed;
+    for (const Reservation& reservation : batch.committed) {
+        removed.append(reservation.id);
+        consumed[reservation.componentId] += reservation.quantity;
+    }
+    if (!dbManager->persistReservations(batch.added, removed, consumed)) {
+        return false;
+    }
+    failedFlushes = 0;
+    return true;
+}
+
+bool ReservationManager::persistInParts(Batch& batch) {
+    if (++failedFlushes < kMaxFlushAttempts) {
+        return false;
+    }
+    
+    // Un lote que sigue fallando (p. ej. un CHECK) no puede bloquear a los
+    // siguientes: se guarda por partes, un componente consumido cada vez
+    failedFlushes = 0;
+    
+    // Las reservas nuevas deben existir antes de cerrarse: si no se guardan, nada avanza
+    Batch rest;
+    rest.added = batch.added;
+    rest.released = batch.released;
+    if (!rest.isEmpty() && !persist(rest)) {
+        return false;
+    }
+    batch.added.clear();
+    batch.released.clear();
+    
+    QHash<int, QVector<Reservation>> byComponent;
+    for (const Reservation& reservation : batch.committed) {
+        byComponent[reservation.componentId].append(reservation);
+    }
+    batch.committed.clear();
+    for (auto it = byComponent.constBegin(); it != byComponent.constEnd(); ++it) {
+        Batch single;
+        single.committed = it.value();
+        if (persist(single)) {
+            continue;
+        }
+        
+        // El consumo sigue en cola y la reserva abierta en la BD hasta que se guarde
+        int units = 0;
+        for (const Reservation& reservation : it.value()) {
+            units += reservation.quantity;
+        }
+        QString message = QString("No se pudo guardar el consumo de %1 unidades del componente %2; "
+                                  "se reintentará").arg(units).arg(it.key());
+        qCritical() << message;
+        emit error(message);
+        batch.committed += it.value();
+    }
+    return batch.isEmpty();
+}
+
+void ReservationManager::requeue(Shard& retry, const Batch& batch) {
+    retry.pendingAdded = batch.added + retry.pendingAdded;
+    retry.pendingReleased = batch.released + retry.pendingReleased;
+    retry.pendingCommitted = batch.committed + retry.pendingCommitted;
+    dirty = true;
+}
+
+qint64 ReservationManager::reserve(int componentId, int quantity, const QString& project) {
+    if (quantity <= 0) {
+        return -1;
+    }
+    
+    StockCounter* counter = counterFor(componentId);
+    if (!counter) {
+        return -1;   // No existe en la sede principal
+    }
+    
+    quint64 current = counter->state.load(std::memory_order_acquire);
+    quint64 next;
+    do {
+        if (qint64(reservedOf(current)) + quantity > qint64(quantityOf(current))) {
+            return -1;   // No sobrevender
+        }
+        next = pack(quantityOf(current), reservedOf(current) + quint32(quantity));
+    } while (!counter->state.compare_exchange_weak(current, next, std::memory_order_acq_rel));
+    
+    Reservation reservation;
+    reservation.id = nextId.fetch_add(1);
+    reservation.componentId = componentId;
+    reservation.quantity = quantity;
+    reservation.project = project;
+    reservation.createdAt = QDateTime::currentDateTime();
+    
+    Shard& shard = shardFor(reservation.id);
+    {
+        QMutexLocker locker(&shard.mutex);
+        shard.open.insert(reservation.id, reservation);
+        shard.pendingAdded.append(reservation);
+    }
+    dirty = true;
+    return reservation.id;
+}
+
+bool ReservationManager::release(qint64 reservationId) {
+    return closeReservation(reservationId, false);
+}
+
+bool ReservationManager::commit(qint64 reservationId, Reservation* committed) {
+    return closeReservation(reservationId, true, committed);
+}
+
+bool ReservationManager::closeReservation(qint64 reservationId, bool consume, Reservation* closed) {
+    if (reservationId < 0) {
+        return false;
+    }
+    
+    Reservation reservation;
+    Shard& shard = shardFor(reservationId);
+    {
+        // Sacarla del fragmento primero evita liberar o consumir dos veces
+        QMutexLocker locker(&shard.mutex);
+        auto it = shard.open.find(reservationId);
+        if (it == shard.open.end()) {
+            return false;
+        }
+        reservation = it.value();
+        shard.open.erase(it);
+        if (consume) {
+            shard.pendingCommitted.append(reservation);
+        } else {
+            shard.pendingReleased.append(reservationId);
+        }
+        
+        // El contador se ajusta con el mutex tomado: writeQuantity no puede fijar
+        // una cantidad absoluta entre el consumo encolado y su descuento
+        StockCounter* counter = counterFor(reservation.componentId);
+        if (counter) {
+            quint64 current = counter->state.load(std::memory_order_acquire);
+            quint64 next;
+            do {
+                quint32 quantity = quantityOf(current);
+                quint32 reserved = reservedOf(current) - quint32(reservation.quantity);
+                if (consume) {
+                    quantity -= quint32(reservation.quantity);
+                }
+                next = pack(quantity, reserved);
+            } while (!counter->state.compare_exchange_weak(current, next, std::memory_order_acq_rel));
+        }
+    }
+    
+    if (closed) {
+        *closed = reservation;
+    }
+    dirty = true;
+    return true;
+}
+
+int ReservationManager::available(int componentId) {
+    StockCounter* counter = counterFor(componentId);
+    if (!counter) {
+        return 0;
+    }
+    quint64 state = counter->state.load(std::memory_order_acquire);
+    return qMax(0, int(quantityOf(state)) - int(reservedOf(state)));
+}
+
+int ReservationManager::reserved(int componentId) {
+    StockCounter* counter = counterFor(componentId);
+    return counter ? int(reservedOf(counter->state.load(std::memory_order_acquire))) : 0;
+}
+
+bool ReservationManager::tryAdjust(int componentId, int delta) {
+    StockCounter* counter = counterFor(componentId);
+    if (!counter) {
+        return true;   // No existe en la sede principal: la BD rechazará la escritura
+    }
+    
+    quint64 current = counter->state.load(std::memory_order_acquire);
+    quint64 next;
+    do {
+        qint64 quantity = qint64(quantityOf(current)) + delta;
+        if (quantity < 0 || quantity < qint64(reservedOf(current))) {
+            return false;
+        }
+        next = pack(quint32(quantity), reservedOf(current));
+    } while (!counter->state.compare_exchange_weak(current, next, std::memory_order_acq_rel));
+    return true;
+}
+
+void ReservationManager::addQuantity(int componentId, int quantity) {
+    StockCounter* counter = counterFor(componentId);
+    if (!counter || quantity <= 0) {
+        return;
+    }
+    
+    quint64 current = counter->state.load(std::memory_order_acquire);
+    while (!counter->state.compare_exchange_weak(
+               current, pack(quantityOf(current) + quint32(quantity), reservedOf(current)),
+               std::memory_order_acq_rel)) {
+    }
+}
+
+void ReservationManager::setQuantity(int componentId, int quantity) {
+    StockCounter* counter = counterFor(componentId);
+    if (!counter) {
+        // Componente nuevo (o restaurado): se crea con la cantidad ya escrita
+        QWriteLocker locker(&countersLock);
+        counter = &counters.try_emplace(componentId, pack(0, 0)).first->second;
+    }
+    
+    quint64 current = counter->state.load(std::memory_order_acquire);
+    while (!counter->state.compare_exchange_weak(
+               current, pack(quint32(qMax(0, quantity)), reservedOf(current)),
+               std::memory_order_acq_rel)) {
+    }
+}
+
+void ReservationManager::forgetComponent(int componentId) {
+    // El contador no se borra: otros hilos pueden tener aún su puntero
+    StockCounter* counter = counterFor(componentId);
+    if (counter) {
+        counter->state.store(0, std::memory_order_release);
+    }
+}
+
+ReservationManager::StockCounter* ReservationManager::counterFor(int componentId) {
+    QReadLocker locker(&countersLock);
+    auto it = counters.find(componentId);
+    return it != counters.end() ? &it->second : nullptr;
+}
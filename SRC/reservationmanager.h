@@ -0,0 +1,114 @@
+#ifndef RESERVATIONMANAGER_H
+#define RESERVATIONMANAGER_H
+
+#include <QObject>
+#include <QHash>
+#include <QMutex>
+#include <QReadWriteLock>
+#include <QTimer>
+#include <atomic>
+#include <functional>
+#include <unordered_map>
+#include "databasemanager.h"
+
+/**
+ * Reservas de stock con contadores atómicos por componente.
+ *
+ * Cantidad y reservado se empaquetan en una sola palabra de 64 bits, de modo
+ * que reservar es un compare-and-swap que nunca deja available < 0. load()
+ * crea un contador por componente de la sede principal con una sola consulta;
+ * después ninguna operación consulta SQLite. Las reservas abiertas viven en
+ * fragmentos con su propio mutex y los cambios se vuelcan a SQLite por lotes
+ * desde el hilo de la GUI.
+ *
+ * Un consumo que no se puede guardar sigue en cola (y su reserva abierta en
+ * la BD) y se avisa con error(); nunca se descarta.
+ *
+ * reserve/release/commit/available son seguros desde cualquier hilo;
+ * load(), flush() y writeQuantity() deben llamarse desde el hilo de DatabaseManager.
+ */
+class ReservationManager : public QObject {
+    Q_OBJECT
+
+public:
+    explicit ReservationManager(DatabaseManager* dbManager, QObject* parent = nullptr);
+    
+    bool load();
+    bool flush();
+    
+    /// Devuelve el ID de la reserva o -1 si no hay stock disponible suficiente
+    qint64 reserve(int componentId, int quantity, const QString& project);
+    bool release(qint64 reservationId);
+    bool commit(qint64 reservationId, Reservation* committed = nullptr);
+    
+    int available(int componentId);
+    int reserved(int componentId);
+    
+    /// Descuenta una salida antes de escribirla en la BD; falla si invadiría lo reservado
+    bool tryAdjust(int componentId, int delta);
+    
+    /// Suma unidades ya confirmadas en la BD, o devuelve una salida que no se
+    /// escribió; nunca falla, así ninguna reserva cuenta con unidades sin confirmar
+    void addQuantity(int componentId, int quantity);
+    
+    /// Cantidad absoluta tras escribirla; crea el contador de un componente nuevo
+    void setQuantity(int componentId, int quantity);
+    void forgetComponent(int componentId);
+    
+    /// Escribe una cantidad absoluta con write() sin que se cuele un commit concurrente:
+    /// con todos los fragmentos bloqueados vuelca lo pendiente, escribe y fija el contador
+    bool writeQuantity(int componentId, int quantity, const std::function<bool()>& write);
+
+signals:
+    void error(const QString& message);
+
+private:
+    struct StockCounter {
+        std::atomic<quint64> state;   ///< (cantidad << 32) | reservado
+        explicit StockCounter(quint64 initial) : state(initial) {}
+    };
+    
+    struct Shard {
+        QMutex mutex;
+        QHash<qint64, Reservation> open;
+        QVector<Reservation> pendingAdded;
+        QVector<qint64> pendingReleased;
+        QVector<Reservation> pendingCommitted;
+    };
+    
+    /// Cambios tomados de los fragmentos para guardarlos juntos
+    struct Batch {
+        QVector<Reservation> added;
+        QVector<qint64> released;
+        QVector<Reservation> committed;
+        bool isEmpty() const { return added.isEmpty() && released.isEmpty() && committed.isEmpty(); }
+    };
+    
+    static const int kShardCount = 16;
+    static const int kMaxFlushAttempts = 5;   ///< Después se guarda por partes
+    
+    static quint64 pack(quint32 quantity, quint32 reserved) {
+        return (quint64(quantity) << 32) | reserved;
+    }
+    static quint32 quantityOf(quint64 state) { return quint32(state >> 32); }
+    static quint32 reservedOf(quint64 state) { return quint32(state); }
+    
+    StockCounter* counterFor(int componentId);
+    Shard& shardFor(qint64 reservationId) { return shards[reservationId % kShardCount]; }
+    bool closeReservation(qint64 reservationId, bool consume, Reservation* closed = nullptr);
+    static void take(Shard& shard, Batch& batch);
+    bool persist(const Batch& batch);
+    bool persistInParts(Batch& batch);
+    void requeue(Shard& retry, const Batch& batch);
+    
+    DatabaseManager* dbManager;
+    QReadWriteLock countersLock;      ///< Solo se toma en escritura al crear un contador
+    std::unordered_map<int, StockCounter> counters;   ///< Nodos estables: punteros válidos
+    Shard shards[kShardCount];
+    std::atomic<qint64> nextId;
+    std::atomic<bool> dirty;
+    int failedFlushes;                ///< Fallos seguidos del mismo lote
+    QTimer flushTimer;
+};
+
+#endif // RESERVATIONMANAGER_H
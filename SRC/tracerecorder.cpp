@@ -0,0 +1,365 @@
+#include "tracerecorder.h"
+#include <QDateTime>
+#include <QDebug>
+
+namespace {
+// Tamaño mínimo serializado de cada elemento de la cabecera (cadenas vacías):
+// un recuento mayor que lo que queda por leer indica una traza dañada
+const qint64 kMinSiteBytes = 4;
+const qint64 kMinComponentBytes = 32;
+const qint64 kMinReservationBytes = 33;
+const qint64 kMinLotBytes = 36;
+const qint64 kMinConsumptionBytes = 28;
+
+/// Llamadas anidadas en curso en este hilo: solo se graba la más externa
+thread_local int callDepth = 0;
+
+void writeComponent(QDataStream& stream, const Component& component) {
+    stream << qint32(component.getId()) << component.getName() << component.getType()
+           << qint32(component.getQuantity()) << component.getLocation()
+           << component.getPurchaseDate() << component.getSite();
+}
+
+Component readComponent(QDataStream& stream) {
+    qint32 id = -1;
+    qint32 quantity = 0;
+    QString name, type, location, site;
+    QDate date;
+    stream >> id >> name >> type >> quantity >> location >> date >> site;
+    Component component(id, name, type, quantity, location, date);
+    component.setSite(site);
+    return component;
+}
+
+/// Lee el número de elementos de una sección y comprueba que caben en lo que queda
+bool readCount(QDataStream& in, qint64 minBytes, quint32* count) {
+    in >> *count;
+    const qint64 left = in.device()->size() - in.device()->pos();
+    return in.status() == QDataStream::Ok && qint64(*count) <= left / minBytes;
+}
+
+void writeSnapshot(QDataStream& stream, const TraceSnapshot& state) {
+    stream << quint32(state.sites.size());
+    for (const QString& site : state.sites) {
+        stream << site;
+    }
+    stream << quint32(state.components.size());
+    for (const Component& component : state.components) {
+        writeComponent(stream, component);
+    }
+    stream << quint32(state.reservations.size());
+    for (const Reservation& reservation : state.reservations) {
+        stream << reservation.id << qint32(reservation.componentId) << qint32(reservation.quantity)
+               << reservation.project << reservation.createdAt;
+    }
+    stream << quint32(state.lots.size());
+    for (const Lot& lot : state.lots) {
+        stream << lot.id << qint32(lot.componentId) << qint32(lot.received)
+               << qint32(lot.remaining) << lot.purchaseDate << lot.unitCost;
+    }
+    stream << quint32(state.consumption.size());
+    for (auto it = state.consumption.constBegin(); it != state.consumption.constEnd(); ++it) {
+        stream << qint32(it.key()) << it->decayedUnits << it->lastEventMs << it->firstEventMs;
+    }
+}
+
+/// Cabecera de una traza; la versión 1 solo tiene los componentes de la sede principal
+bool readSnapshot(QDataStream& in, quint16 version, TraceSnapshot* state) {
+    *state = TraceSnapshot();
+    quint32 count = 0;
+    if (version >= 2) {
+        if (!readCount(in, kMinSiteBytes, &count)) {
+            return false;
+        }
+        for (quint32 i = 0; i < count; ++i) {
+            QString site;
+            in >> site;
+            state->sites.append(site);
+        }
+    }
+    
+    if (!readCount(in, kMinComponentBytes, &count)) {
+        return false;
+    }
+    state->components.reserve(int(count));
+    for (quint32 i = 0; i < count; ++i) {
+        state->components.append(readComponent(in));
+    }
+    if (version < 2) {
+        return in.status() == QDataStream::Ok;
+    }
+    
+    if (!readCount(in, kMinReservationBytes, &count)) {
+        return false;
+    }
+    state->reservations.reserve(int(count));
+    for (quint32 i = 0; i < count; ++i) {
+        Reservation reservation;
+        qint32 componentId = -1;
+        qint32 quantity = 0;
+        in >> reservation.id >> componentId >> quantity >> reservation.project
+           >> reservation.createdAt;
+        reservation.componentId = componentId;
+        reservation.quantity = quantity;
+        state->reservations.append(reservation);
+    }
+    
+    if (!readCount(in, kMinLotBytes, &count)) {
+        return false;
+    }
+    state->lots.reserve(int(count));
+    for (quint32 i = 0; i < count; ++i) {
+        Lot lot;
+        qint32 componentId = -1;
+        qint32 received = 0;
+        qint32 remaining = 0;
+        in >> lot.id >> componentId >> received >> remaining >> lot.purchaseDate >> lot.unitCost;
+        lot.componentId = componentId;
+        lot.received = received;
+        lot.remaining = remaining;
+        state->lots.append(lot);
+    }
+    
+    if (!readCount(in, kMinConsumptionBytes, &count)) {
+        return false;
+    }
+    state->consumption.reserve(int(count));
+    for (quint32 i = 0; i < count; ++i) {
+        qint32 componentId = -1;
+        ConsumptionState consumption;
+        in >> componentId >> consumption.decayedUnits >> consumption.lastEventMs
+           >> consumption.firstEventMs;
+        state->consumption.insert(componentId, consumption);
+    }
+    return in.status() == QDataStream::Ok;
+}
+
+/// Decodifica los argumentos de un registro según su operación
+void readPayload(TraceEvent& event, const QByteArray& payload) {
+    QDataStream in(payload);
+    in.setVersion(QDataStream::Qt_5_12);
+    qint32 id = -1;
+    qint32 value = 0;
+    quint8 mode = 0;
+    
+    switch (event.op) {
+    case TraceOp::Add: {
+        QString name, type, location;
+        QDate date;
+        in >> name >> type >> value >> location >> date >> event.text;
+        if (!in.atEnd()) {
+            in >> id;   // Sin ID si la llamada falló
+        }
+        event.component = Component(id, name, type, value, location, date);
+        event.component.setSite(event.text);
+        event.id = id;
+        break;
+    }
+    case TraceOp::Update:
+        event.component = readComponent(in);
+        event.id = event.component.getId();
+        break;
+    case TraceOp::Remove:
+        in >> id >> event.text;
+        event.id = id;
+        break;
+    case TraceOp::Adjust:
+        in >> id >> value >> event.text;
+        if (!in.atEnd()) {
+            in >> event.site;   // Trazas anteriores a las sedes: principal
+        }
+        event.id = id;
+        event.value = value;
+        break;
+    case TraceOp::Search:
+        in >> event.text >> mode;
+        event.value = mode;
+        break;
+    case TraceOp::LowStock:
+        in >> value;
+        event.value = value;
+        break;
+    case TraceOp::GetById:
+        in >> id;
+        if (!in.atEnd()) {
+            in >> event.site;
+        }
+        event.id = id;
+        break;
+    case TraceOp::Available:
+    case TraceOp::Forecast:
+        in >> id;
+        event.id = id;
+        break;
+    case TraceOp::Reserve:
+        in >> id >> value >> event.text;
+        if (!in.atEnd()) {
+            in >> event.reservationId;
+        }
+        event.id = id;
+        event.value = value;
+        break;
+    case TraceOp::Release:
+    case TraceOp::Commit:
+        in >> event.reservationId;
+        break;
+    case TraceOp::Receive: {
+        QDate date;
+        in >> id >> value >> date >> event.unitCost;
+        event.component.setPurchaseDate(date);
+        event.id = id;
+        event.value = value;
+        break;
+    }
+    case TraceOp::GetAll:
+    case TraceOp::Undo:
+    case TraceOp::Redo:
+        break;
+    }
+}
+}
+
+TraceRecorder::Call::Call(TraceRecorder* recorder, TraceOp op)
+    : recorder(recorder), op(op), startNs(0), counted(false), active(false),
+      stream(&payload, QIODevice::WriteOnly) {
+    
+    if (recorder && recorder->isOpen()) {
+        counted = true;
+        active = callDepth++ == 0;
+        startNs = recorder->clock.nsecsElapsed();
+        stream.setVersion(QDataStream::Qt_5_12);
+    }
+}
+
+TraceRecorder::Call::~Call() {
+    if (!counted) {
+        return;
+    }
+    --callDepth;
+    if (active) {
+        recorder->write(op, startNs, recorder->clock.nsecsElapsed(), payload);
+    }
+}
+
+TraceRecorder::Call& TraceRecorder::Call::operator<<(const Component& component) {
+    if (active) {
+        writeComponent(stream, component);
+    }
+    return *this;
+}
+
+TraceRecorder::TraceRecorder()
+    : lastStartNs(0), records(0) {
+}
+
+TraceRecorder::~TraceRecorder() {
+    close();
+}
+
+bool TraceRecorder::open(const QString& path, const TraceSnapshot& initialState) {
+    close();
+    QMutexLocker locker(&lock);
+    file.setFileName(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning() << "No se pudo crear la traza:" << file.errorString();
+        return false;
+    }
+    
+    out.setDevice(&file);
+    out.setVersion(QDataStream::Qt_5_12);
+    out << kMagic << kVersion << qint64(QDateTime::currentMSecsSinceEpoch());
+    writeSnapshot(out, initialState);
+    
+    clock.start();
+    lastStartNs = 0;
+    records = 0;
+    recording.storeRelease(1);
+    qDebug() << "Grabando traza en" << path << "con" << initialState.components.size()
+             << "componentes," << initialState.reservations.size() << "reservas y"
+             << initialState.lots.size() << "lotes iniciales";
+    return true;
+}
+
+void TraceRecorder::close() {
+    QMutexLocker locker(&lock);
+    recording.storeRelease(0);
+    if (file.isOpen()) {
+        out.setDevice(nullptr);
+        file.close();
+        qDebug() << "Traza cerrada:" << records << "llamadas";
+    }
+}
+
+qint64 TraceRecorder::recordCount() const {
+    QMutexLocker locker(&lock);
+    return records;
+}
+
+void TraceRecorder::write(TraceOp op, qint64 startNs, qint64 endNs, const QByteArray& payload) {
+    QMutexLocker locker(&lock);
+    if (!file.isOpen()) {
+        return;   // Cerrada mientras la llamada estaba en curso
+    }
+    
+    // Tiempos relativos en µs: caben en 32 bits salvo pausas de más de una hora.
+    // Con varios hilos una llamada puede empezar antes que la última grabada: delta 0
+    const qint64 deltaUs = qMax<qint64>(0, (startNs - lastStartNs) / 1000);
+    lastStartNs = qMax(lastStartNs, startNs);
+    out << quint8(op) << quint32(qMin<qint64>(deltaUs, 0xFFFFFFFF))
+        << quint32(qMin<qint64>((endNs - startNs) / 1000, 0xFFFFFFFF)) << payload;
+    ++records;
+}
+
+bool TraceRecorder::read(const QString& path, TraceSnapshot* initialState,
+                         QVector<TraceEvent>* events, QString* error) {
+    QFile input(path);
+    if (!input.open(QIODevice::ReadOnly)) {
+        if (error) {
+            *error = "No se pudo abrir la traza: " + input.errorString();
+        }
+        return false;
+    }
+    
+    // Las trazas se leen enteras: la reproducción no debe tocar el disco
+    const QByteArray data = input.readAll();
+    QDataStream in(data);
+    in.setVersion(QDataStream::Qt_5_12);
+    
+    quint32 magic = 0;
+    quint16 version = 0;
+    qint64 startedMs = 0;
+    in >> magic >> version >> startedMs;
+    if (magic != kMagic || version < 1 || version > kVersion) {
+        if (error) {
+            *error = "Formato de traza desconocido";
+        }
+        return false;
+    }
+    
+    if (!readSnapshot(in, version, initialState)) {
+        if (error) {
+            *error = "Cabecera de traza dañada o incompleta";
+        }
+        return false;
+    }
+    
+    events->clear();
+    qint64 atUs = 0;
+    while (!in.atEnd() && in.status() == QDataStream::Ok) {
+        quint8 op = 0;
+        quint32 deltaUs = 0;
+        TraceEvent event;
+        QByteArray payload;
+        in >> op >> deltaUs >> event.durationUs >> payload;
+        if (in.status() != QDataStream::Ok) {
+            break;   // Último registro incompleto (grabación interrumpida)
+        }
+        
+        atUs += deltaUs;
+        event.op = TraceOp(op);
+        event.atUs = atUs;
+        readPayload(event, payload);
+        events->append(event);
+    }
+    return true;
+}
@@ -0,0 +1,121 @@
+#ifndef TRACERECORDER_H
+#define TRACERECORDER_H
+
+#include <QFile>
+#include <QDataStream>
+#include <QElapsedTimer>
+#include <QVector>
+#include <QMutex>
+#include <QAtomicInt>
+#include "component.h"
+#include "databasemanager.h"
+
+/// Operaciones de InventoryManager que se graban en la traza
+enum class TraceOp : quint8 {
+    Add = 1,
+    Update,
+    Remove,
+    Adjust,
+    GetAll,
+    Search,
+    LowStock,
+    GetById,
+    Reserve,
+    Release,
+    Commit,
+    Available,
+    Undo,
+    Redo,
+    Forecast,
+    Receive
+};
+
+/// Llamada leída de una traza
+struct TraceEvent {
+    TraceOp op = TraceOp::GetAll;
+    qint64 atUs = 0;            ///< Desde el inicio de la grabación
+    quint32 durationUs = 0;     ///< Duración original de la llamada
+    Component component;        ///< Add / Update (Receive: solo la fecha de compra)
+    int id = -1;                ///< Componente (en Add, el ID asignado)
+    int value = 0;              ///< Delta, cantidad, umbral o modo de búsqueda
+    qint64 reservationId = -1;
+    double unitCost = 0.0;      ///< Receive
+    QString text;               ///< Motivo, texto buscado, proyecto o sede
+    QString site;               ///< Adjust / GetById; vacío = sede principal
+};
+
+/// Estado inicial de una traza: lo necesario para reproducirla sobre una BD vacía
+struct TraceSnapshot {
+    QStringList sites;                          ///< Sedes adicionales, en orden de bloque de IDs
+    QVector<Component> components;              ///< Todas las sedes (ver Component::getSite)
+    QVector<Reservation> reservations;          ///< Reservas abiertas
+    QVector<Lot> lots;                          ///< Lotes con existencias
+    QHash<int, ConsumptionState> consumption;   ///< Estado del pronóstico
+};
+
+/**
+ * Graba las llamadas a InventoryManager en una traza binaria (QDataStream).
+ *
+ * Cabecera con el estado inicial (TraceSnapshot) y después un registro por
+ * llamada: operación, µs desde la anterior, duración y argumentos. Solo se
+ * graban las llamadas externas; las que InventoryManager se hace a sí mismo
+ * quedan dentro de la duración de la llamada que las originó. Se puede grabar
+ * desde varios hilos a la vez: cada registro se escribe entero y en orden de
+ * finalización.
+ */
+class TraceRecorder {
+public:
+    /// Graba una llamada al salir de ámbito; sin grabador activo no hace nada.
+    /// El anidamiento se cuenta por hilo y los argumentos van a un búfer propio
+    class Call {
+    public:
+        Call(TraceRecorder* recorder, TraceOp op);
+        ~Call();
+        
+        template <typename T>
+        Call& operator<<(const T& value) {
+            if (active) {
+                stream << value;
+            }
+            return *this;
+        }
+        Call& operator<<(const Component& component);
+    
+    private:
+        TraceRecorder* recorder;
+        TraceOp op;
+        qint64 startNs;
+        bool counted;
+        bool active;
+        QByteArray payload;
+        QDataStream stream;
+    };
+    
+    TraceRecorder();
+    ~TraceRecorder();
+    
+    bool open(const QString& path, const TraceSnapshot& initialState);
+    void close();
+    bool isOpen() const { return recording.loadAcquire() != 0; }
+    qint64 recordCount() const;
+    
+    /// Lee una traza entera; también las de versión 1 (solo componentes de la sede principal)
+    static bool read(const QString& path, TraceSnapshot* initialState,
+                     QVector<TraceEvent>* events, QString* error = nullptr);
+
+private:
+    void write(TraceOp op, qint64 startNs, qint64 endNs, const QByteArray& payload);
+    
+    static const quint32 kMagic = 0x494E5654;   // "INVT"
+    static const quint16 kVersion = 2;
+    
+    mutable QMutex lock;    ///< Protege el archivo, lastStartNs y records
+    QAtomicInt recording;   ///< Consultado sin bloqueo al empezar cada llamada
+    QFile file;
+    QDataStream out;
+    QElapsedTimer clock;
+    qint64 lastStartNs;
+    qint64 records;
+};
+
+#endif // TRACERECORDER_H
@@ -0,0 +1,323 @@
+#include "tracereplayer.h"
+#include "inventory_manager.h"
+#include <QSemaphore>
+#include <QSqlQuery>
+#include <QTextStream>
+#include <QThread>
+#include <algorithm>
+#include <memory>
+
+namespace {
+const char* opName(TraceOp op) {
+    switch (op) {
+    case TraceOp::Add: return "alta";
+    case TraceOp::Update: return "edición";
+    case TraceOp::Remove: return "baja";
+    case TraceOp::Adjust: return "ajuste";
+    case TraceOp::GetAll: return "listar";
+    case TraceOp::Search: return "búsqueda";
+    case TraceOp::LowStock: return "stock bajo";
+    case TraceOp::GetById: return "por ID";
+    case TraceOp::Reserve: return "reserva";
+    case TraceOp::Release: return "liberar";
+    case TraceOp::Commit: return "consumir";
+    case TraceOp::Available: return "disponible";
+    case TraceOp::Undo: return "deshacer";
+    case TraceOp::Redo: return "rehacer";
+    case TraceOp::Forecast: return "pronóstico";
+    case TraceOp::Receive: return "recepción";
+    }
+    return "?";
+}
+
+QString micros(const QVector<qint64>& sortedNs, double p) {
+    if (sortedNs.isEmpty()) {
+        return "-";
+    }
+    const int index = qMin(sortedNs.size() - 1, int(p * sortedNs.size()));
+    return QString::number(sortedNs[index] / 1000.0, 'f', 0);
+}
+}
+
+/// Consultas preparadas de un hilo para las lecturas que no pasan por InventoryManager
+struct TraceReplayer::ReadStatements {
+    explicit ReadStatements(const QSqlDatabase& conn)
+        : byId(conn), search(conn), lowStock(conn), all(conn) {
+        byId.prepare("SELECT * FROM componentes WHERE id = :id");
+        search.prepare("SELECT * FROM componentes WHERE "
+                       "name LIKE :search OR type LIKE :search OR location LIKE :search "
+                       "ORDER BY name");
+        lowStock.prepare("SELECT * FROM componentes WHERE quantity <= :threshold ORDER BY quantity");
+        all.prepare("SELECT * FROM componentes ORDER BY name");
+    }
+    
+    QSqlQuery byId;
+    QSqlQuery search;
+    QSqlQuery lowStock;
+    QSqlQuery all;
+};
+
+TraceReplayer::TraceReplayer(InventoryManager* inventory, const Options& options, QObject* parent)
+    : QObject(parent), inventory(inventory), options(options), runningWorkers(0) {
+}
+
+bool TraceReplayer::load(const QString& path, QString* error) {
+    return TraceRecorder::read(path, &seed, &events, error);
+}
+
+QVector<QVector<int>> TraceReplayer::partitionEvents(const QVector<TraceEvent>& events,
+                                                     int threads) {
+    QVector<QVector<int>> result(qMax(1, threads));
+    QHash<qint64, int> reservationComponent;
+    int roundRobin = 0;
+    for (int i = 0; i < events.size(); ++i) {
+        const TraceEvent& event = events[i];
+        if (event.op == TraceOp::Undo || event.op == TraceOp::Redo) {
+            // Actúan sobre la última entrada del historial, sea del componente que sea:
+            // repartidas entre hilos podrían ejecutarse en otro orden que el grabado
+            result[0].append(i);
+            continue;
+        }
+        
+        int key = event.id;
+        if (event.op == TraceOp::Reserve) {
+            reservationComponent.insert(event.reservationId, event.id);
+        } else if (event.op == TraceOp::Release || event.op == TraceOp::Commit) {
+            key = reservationComponent.value(event.reservationId, -1);
+        }
+        const int partition = key >= 0 ? key % result.size() : roundRobin++ % result.size();
+        result[partition].append(i);
+    }
+    return result;
+}
+
+void TraceReplayer::start() {
+    partitions = partitionEvents(events, options.threads);
+    
+    samples = QVector<QVector<Sample>>(partitions.size());
+    for (int t = 0; t < partitions.size(); ++t) {
+        samples[t].reserve(partitions[t].size());
+    }
+    componentMap.clear();
+    reservationMap.clear();
+    runningWorkers = partitions.size();
+    
+    const QString dbPath = DatabaseManager::getInstance()->getDatabasePath();
+    clock.start();
+    for (int t = 0; t < partitions.size(); ++t) {
+        QVector<Sample>* out = &samples[t];   // Cada hilo escribe solo su vector
+        QThread* thread = QThread::create([this, t, out, dbPath]() {
+            runWorker(t, out, dbPath);
+        });
+        connect(thread, &QThread::finished, this, &TraceReplayer::onWorkerFinished);
+        connect(thread, &QThread::finished, thread, &QObject::deleteLater);
+        thread->start();
+    }
+}
+
+void TraceReplayer::runWorker(int index, QVector<Sample>* out, const QString& dbPath) {
+    std::unique_ptr<ReadStatements> statements;
+    if (options.threads > 1) {
+        statements.reset(new ReadStatements(DatabaseManager::connectionForThread(dbPath)));
+    }
+    
+    const QVector<TraceEvent>& all = events;
+    for (int i : partitions.at(index)) {
+        const TraceEvent& event = all[i];
+        const qint64 scheduledNs = event.atUs * 1000;
+        if (!options.fast) {
+            const qint64 waitNs = scheduledNs - clock.nsecsElapsed();
+            if (waitNs > 0) {
+                QThread::usleep(quint64(waitNs / 1000));
+            }
+        }
+        
+        // A velocidad original se mide desde la hora programada: si el hilo va
+        // retrasado, ese retraso cuenta como latencia (evita la omisión coordinada)
+        const qint64 beginNs = options.fast ? clock.nsecsElapsed() : scheduledNs;
+        bool ok = true;
+        if (!statements || !executeRead(event, *statements, &ok)) {
+            ok = executeOnManager(event);
+        }
+        out->append({event.op, clock.nsecsElapsed() - beginNs, event.durationUs, ok});
+    }
+}
+
+bool TraceReplayer::executeRead(const TraceEvent& event, ReadStatements& statements, bool* ok) {
+    QSqlQuery* query = nullptr;
+    switch (event.op) {
+    case TraceOp::GetById:
+        if (!DatabaseManager::isMainSite(event.site)) {
+            return false;   // Las sentencias preparadas solo cubren la sede principal
+        }
+        query = &statements.byId;
+        query->bindValue(":id", mapComponent(event.id));
+        break;
+    case TraceOp::Search:
+        if (SearchMode(event.value) != SearchMode::Exact) {
+            return false;   // La búsqueda aproximada necesita el índice de InventoryManager
+        }
+        if (event.text.isEmpty()) {
+            query = &statements.all;
+        } else {
+            query = &statements.search;
+            query->bindValue(":search", "%" + event.text + "%");
+        }
+        break;
+    case TraceOp::LowStock:
+        query = &statements.lowStock;
+        query->bindValue(":threshold", event.value);
+        break;
+    case TraceOp::GetAll:
+        query = &statements.all;
+        break;
+    default:
+        return false;
+    }
+    
+    QVector<Component> components;
+    *ok = query->exec();
+    while (*ok && query->next()) {
+        components.append(DatabaseManager::queryToComponent(*query));
+    }
+    query->finish();
+    if (event.op == TraceOp::GetById) {
+        *ok = *ok && !components.isEmpty();
+    }
+    return true;
+}
+
+bool TraceReplayer::executeOnManager(const TraceEvent& event) {
+    // InventoryManager no es seguro entre hilos: la llamada se ejecuta en su hilo
+    QSemaphore done;
+    bool ok = false;
+    QMetaObject::invokeMethod(inventory, [this, &event, &done, &ok]() {
+        ok = apply(event);
+        done.release();
+    }, Qt::QueuedConnection);
+    done.acquire();
+    return ok;
+}
+
+bool TraceReplayer::apply(const TraceEvent& event) {
+    switch (event.op) {
+    case TraceOp::Add: {
+        const Component& c = event.component;
+        int newId = -1;
+        const bool ok = inventory->addComponent(c.getName(), c.getType(), c.getQuantity(),
+                                                c.getLocation(), c.getPurchaseDate(),
+                                                event.text, &newId);
+        if (ok && event.id >= 0) {
+            QMutexLocker locker(&mapLock);
+            componentMap.insert(event.id, newId);
+        }
+        return ok;
+    }
+    case TraceOp::Update: {
+        Component component = event.component;
+        component.setId(mapComponent(component.getId()));
+        return inventory->updateComponent(component);
+    }
+    case TraceOp::Remove:
+        return inventory->removeComponent(mapComponent(event.id), event.text);
+    case TraceOp::Adjust:
+        return inventory->adjustQuantity(mapComponent(event.id), event.value, event.text,
+                                         event.site);
+    case TraceOp::GetAll:
+        inventory->getAllComponents();
+        return true;
+    case TraceOp::Search:
+        inventory->searchComponents(event.text, SearchMode(event.value));
+        return true;
+    case TraceOp::LowStock:
+        inventory->getLowStockAlert(event.value);
+        return true;
+    case TraceOp::GetById:
+        return inventory->getComponentById(mapComponent(event.id), event.site).getId() != -1;
+    case TraceOp::Reserve: {
+        const qint64 reservationId = inventory->reserveComponent(mapComponent(event.id),
+                                                                 event.value, event.text);
+        if (reservationId >= 0 && event.reservationId >= 0) {
+            QMutexLocker locker(&mapLock);
+            reservationMap.insert(event.reservationId, reservationId);
+        }
+        return reservationId >= 0;
+    }
+    case TraceOp::Release:
+        return inventory->releaseReservation(mapReservation(event.reservationId));
+    case TraceOp::Commit:
+        return inventory->commitReservation(mapReservation(event.reservationId));
+    case TraceOp::Available:
+        inventory->getAvailableQuantity(mapComponent(event.id));
+        return true;
+    case TraceOp::Undo:
+        return inventory->undo();
+    case TraceOp::Redo:
+        return inventory->redo();
+    case TraceOp::Forecast:
+        inventory->getReorderForecast(mapComponent(event.id));
+        return true;
+    case TraceOp::Receive:
+        return inventory->receiveLot(mapComponent(event.id), event.value,
+                                     event.component.getPurchaseDate(), event.unitCost);
+    }
+    return false;
+}
+
+int TraceReplayer::mapComponent(int recordedId) const {
+    QMutexLocker locker(&mapLock);
+    return componentMap.value(recordedId, recordedId);
+}
+
+qint64 TraceReplayer::mapReservation(qint64 recordedId) const {
+    QMutexLocker locker(&mapLock);
+    return reservationMap.value(recordedId, recordedId);
+}
+
+void TraceReplayer::onWorkerFinished() {
+    if (--runningWorkers == 0) {
+        emit finished(buildReport(clock.nsecsElapsed()));
+    }
+}
+
+QString TraceReplayer::buildReport(qint64 elapsedNs) const {
+    QHash<int, QVector<qint64>> replayed;
+    QHash<int, QVector<qint64>> original;
+    int total = 0;
+    int failed = 0;
+    for (const QVector<Sample>& part : samples) {
+        for (const Sample& sample : part) {
+            replayed[int(sample.op)].append(sample.latencyNs);
+            original[int(sample.op)].append(qint64(sample.originalUs) * 1000);
+            failed += sample.ok ? 0 : 1;
+            ++total;
+        }
+    }
+    
+    const double seconds = elapsedNs / 1e9;
+    QString report;
+    QTextStream out(&report);
+    out << "Reproducidas " << total << " llamadas en " << QString::number(seconds, 'f', 2)
+        << " s (" << QString::number(total / qMax(seconds, 1e-9), 'f', 0) << " ops/s), hilos: "
+        << partitions.size() << ", modo: " << (options.fast ? "máxima velocidad" : "tiempo original")
+        << ", fallidas: " << failed << "\n";
+    out << QString("%1 %2 %3 %4 %5 | %6 %7\n")
+           .arg("operación", -12).arg("n", 8).arg("p50 us", 9).arg("p99 us", 9)
+           .arg("máx us", 9).arg("orig p50", 9).arg("orig p99", 9);
+    
+    for (int op = int(TraceOp::Add); op <= int(TraceOp::Receive); ++op) {
+        if (!replayed.contains(op)) {
+            continue;
+        }
+        QVector<qint64>& latencies = replayed[op];
+        QVector<qint64>& recorded = original[op];
+        std::sort(latencies.begin(), latencies.end());
+        std::sort(recorded.begin(), recorded.end());
+        out << QString("%1 %2 %3 %4 %5 | %6 %7\n")
+               .arg(QString::fromUtf8(opName(TraceOp(op))), -12).arg(latencies.size(), 8)
+               .arg(micros(latencies, 0.50), 9).arg(micros(latencies, 0.99), 9)
+               .arg(micros(latencies, 1.0), 9)
+               .arg(micros(recorded, 0.50), 9).arg(micros(recorded, 0.99), 9);
+    }
+    return report;
+}
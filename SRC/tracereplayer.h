@@ -0,0 +1,84 @@
+#ifndef TRACEREPLAYER_H
+#define TRACEREPLAYER_H
+
+#include <QObject>
+#include <QHash>
+#include <QMutex>
+#include <QElapsedTimer>
+#include <QVector>
+#include "tracerecorder.h"
+
+class InventoryManager;
+class QSqlQuery;
+
+/**
+ * Reproduce una traza de TraceRecorder contra InventoryManager.
+ *
+ * Con un hilo, todas las llamadas pasan por InventoryManager en el orden
+ * grabado (resultado determinista, incluye instantánea e índice). Con varios,
+ * las llamadas se reparten por componente para conservar su orden relativo:
+ * las lecturas simples usan la conexión SQLite de cada hilo y el resto se
+ * envía al hilo de InventoryManager, como hace HttpService. Deshacer y rehacer
+ * dependen del orden global del historial y van siempre al mismo hilo.
+ */
+class TraceReplayer : public QObject {
+    Q_OBJECT
+
+public:
+    struct Options {
+        int threads = 1;
+        bool fast = false;      ///< false = respetar los tiempos originales
+    };
+    
+    TraceReplayer(InventoryManager* inventory, const Options& options, QObject* parent = nullptr);
+    
+    bool load(const QString& path, QString* error = nullptr);
+    const TraceSnapshot& initialState() const { return seed; }
+    int eventCount() const { return events.size(); }
+    
+    void start();
+    
+    /// Índices de eventos por hilo: mismo componente -> mismo hilo, las reservas
+    /// siguen al componente reservado y deshacer/rehacer van al primer hilo
+    static QVector<QVector<int>> partitionEvents(const QVector<TraceEvent>& events, int threads);
+
+signals:
+    /// Informe legible con rendimiento y latencias por operación
+    void finished(const QString& report);
+
+private:
+    struct Sample {
+        TraceOp op;
+        qint64 latencyNs;
+        quint32 originalUs;
+        bool ok;
+    };
+    
+    struct ReadStatements;
+    
+    void runWorker(int index, QVector<Sample>* out, const QString& dbPath);
+    bool executeRead(const TraceEvent& event, ReadStatements& statements, bool* ok);
+    bool executeOnManager(const TraceEvent& event);
+    bool apply(const TraceEvent& event);
+    int mapComponent(int recordedId) const;
+    qint64 mapReservation(qint64 recordedId) const;
+    void onWorkerFinished();
+    QString buildReport(qint64 elapsedNs) const;
+    
+    InventoryManager* inventory;
+    Options options;
+    TraceSnapshot seed;
+    QVector<TraceEvent> events;
+    QVector<QVector<int>> partitions;      ///< Índices de eventos por hilo
+    QVector<QVector<Sample>> samples;      ///< Un vector por hilo, sin compartir
+    int runningWorkers;
+    
+    // IDs grabados -> IDs de esta reproducción (altas y reservas nuevas)
+    mutable QMutex mapLock;
+    QHash<int, int> componentMap;
+    QHash<qint64, qint64> reservationMap;
+    
+    QElapsedTimer clock;
+};
+
+#endif // TRACEREPLAYER_H
@@ -0,0 +1,214 @@
+#include "trigramindex.h"
+#include <algorithm>
+#include <memory>
+
+TrigramIndex::TrigramIndex()
+    : deadSlots(0) {
+}
+
+void TrigramIndex::clear() {
+    postings.clear();
+    idToSlot.clear();
+    slotIds.clear();
+    slotTrigramCount.clear();
+    deadSlots = 0;
+}
+
+void TrigramIndex::build(const QVector<Component>& components) {
+    clear();
+    idToSlot.reserve(components.size());
+    slotIds.reserve(components.size());
+    slotTrigramCount.reserve(components.size());
+    for (const Component& component : components) {
+        insert(component);
+    }
+}
+
+void TrigramIndex::insert(const Component& component) {
+    if (idToSlot.contains(component.getId())) {
+        remove(component.getId());
+    }
+    
+    const quint32 slot = static_cast<quint32>(slotIds.size());
+    const QVector<quint64> keys = trigrams(component.getName() + ' ' +
+                                           component.getType() + ' ' +
+                                           component.getLocation());
+    
+    idToSlot.insert(component.getId(), slot);
+    slotIds.append(component.getId());
+    slotTrigramCount.append(static_cast<quint16>(qMin(keys.size(), 0xFFFF)));
+    for (quint64 key : keys) {
+        postings[key].append(slot);
+    }
+}
+
+void TrigramIndex::update(const Component& component) {
+    insert(component);
+}
+
+void TrigramIndex::remove(int componentId) {
+    auto it = idToSlot.find(componentId);
+    if (it == idToSlot.end()) {
+        return;
+    }
+    
+    slotIds[it.value()] = -1;
+    idToSlot.erase(it);
+    ++deadSlots;
+    
+    if (deadSlots > 1024 && deadSlots * 4 > slotIds.size()) {
+        compact();
+    }
+}
+
+void TrigramIndex::compact() {
+    // Renumerar slots vivos y filtrar las listas; no hace falta el texto original
+    QVector<quint32> remap(slotIds.size(), quint32(-1));
+    QVector<int> ids;
+    QVector<quint16> counts;
+    ids.reserve(slotIds.size() - deadSlots);
+    counts.reserve(slotIds.size() - deadSlots);
+    
+    for (int slot = 0; slot < slotIds.size(); ++slot) {
+        if (slotIds[slot] != -1) {
+            remap[slot] = static_cast<quint32>(ids.size());
+            idToSlot[slotIds[slot]] = remap[slot];
+            ids.append(slotIds[slot]);
+            counts.append(slotTrigramCount[slot]);
+        }
+    }
+    
+    for (auto it = postings.begin(); it != postings.end();) {
+        QVector<quint32>& list = it.value();
+        int out = 0;
+        for (quint32 slot : list) {
+            if (remap[slot] != quint32(-1)) {
+                list[out++] = remap[slot];
+            }
+        }
+        list.resize(out);
+        if (list.isEmpty()) {
+            it = postings.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    
+    slotIds = ids;
+    slotTrigramCount = counts;
+    deadSlots = 0;
+}
+
+QVector<TrigramIndex::Match> TrigramIndex::search(const QString& text, int limit,
+                                                  float minScore) const {
+    QVector<Match> matches;
+    const QVector<quint64> query = trigrams(text);
+    if (query.isEmpty() || slotIds.isEmpty()) {
+        return matches;
+    }
+    
+    // Contadores propios de cada llamada (2 bytes por slot, ~2 MB con un millón):
+    // dos búsquedas a la vez no comparten estado
+    std::unique_ptr<quint16[]> hitCounts(new quint16[slotIds.size()]());
+    quint16* hits = hitCounts.get();
+    QVector<quint32> touched;
+    
+    // Primero los trigramas raros: cuando se llega al tope de candidatos, los
+    // comunes ya solo cuentan para los slots vistos, que conservan su puntaje exacto
+    QVector<const QVector<quint32>*> lists;
+    lists.reserve(query.size());
+    for (quint64 key : query) {
+        auto it = postings.constFind(key);
+        if (it != postings.constEnd()) {
+            lists.append(&it.value());
+        }
+    }
+    std::sort(lists.begin(), lists.end(), [](const QVector<quint32>* a, const QVector<quint32>* b) {
+        return a->size() < b->size();
+    });
+    
+    for (const QVector<quint32>* list : qAsConst(lists)) {
+        const quint32* slots = list->constData();
+        const int n = list->size();
+        if (touched.size() < kMaxCandidates) {
+            for (int i = 0; i < n; ++i) {
+                if (hits[slots[i]]++ == 0) {
+                    touched.append(slots[i]);
+                }
+            }
+        } else {
+            for (int i = 0; i < n; ++i) {
+                hits[slots[i]] += hits[slots[i]] != 0;
+            }
+        }
+    }
+    
+    // Puntaje: fracción de trigramas de la consulta presentes (prefiere contener
+    // la consulta) mezclada con Dice (penaliza textos mucho más largos)
+    const int n = touched.size();
+    const float queryCount = float(query.size());
+    const float invQuery = 1.0f / queryCount;
+    QVector<float> common(n);
+    QVector<float> docCount(n);
+    QVector<float> scores(n);
+    
+    for (int i = 0; i < n; ++i) {
+        common[i] = hits[touched[i]];
+        docCount[i] = slotTrigramCount[touched[i]];
+    }
+    const float* c = common.constData();
+    const float* d = docCount.constData();
+    float* s = scores.data();
+    for (int i = 0; i < n; ++i) {
+        s[i] = 0.7f * c[i] * invQuery + 0.3f * (2.0f * c[i] / (queryCount + d[i]));
+    }
+    
+    for (int i = 0; i < n; ++i) {
+        const int id = slotIds[touched[i]];
+        if (id != -1 && s[i] >= minScore) {
+            matches.append({id, s[i]});
+        }
+    }
+    
+    auto byScore = [](const Match& a, const Match& b) { return a.score > b.score; };
+    if (matches.size() > limit) {
+        std::partial_sort(matches.begin(), matches.begin() + limit, matches.end(), byScore);
+        matches.resize(limit);
+    } else {
+        std::sort(matches.begin(), matches.end(), byScore);
+    }
+    return matches;
+}
+
+QVector<quint64> TrigramIndex::trigrams(const QString& text) {
+    // Minúsculas y sin diacríticos: "Resistência" y "resistencia" comparten trigramas
+    const QString decomposed = text.toLower().normalized(QString::NormalizationForm_D);
+    QString folded;
+    folded.reserve(decomposed.size());
+    for (QChar ch : decomposed) {
+        if (ch.category() == QChar::Mark_NonSpacing) {
+            continue;
+        }
+        folded.append(ch.isLetterOrNumber() ? ch : QChar(' '));
+    }
+    
+    QVector<quint64> keys;
+    // Se filtran a mano las palabras vacías: Qt::SkipEmptyParts exige Qt 5.14
+    const QStringList words = folded.split(' ');
+    for (const QString& word : words) {
+        if (word.isEmpty()) {
+            continue;
+        }
+        // Relleno estilo pg_trgm: dos espacios al inicio y uno al final
+        const QString padded = "  " + word + ' ';
+        for (int i = 0; i + 3 <= padded.size(); ++i) {
+            keys.append((quint64(padded[i].unicode()) << 32) |
+                        (quint64(padded[i + 1].unicode()) << 16) |
+                        quint64(padded[i + 2].unicode()));
+        }
+    }
+    
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    return keys;
+}
@@ -0,0 +1,55 @@
+#ifndef TRIGRAMINDEX_H
+#define TRIGRAMINDEX_H
+
+#include <QHash>
+#include <QVector>
+#include <QString>
+#include "component.h"
+
+/**
+ * Índice de trigramas en memoria sobre nombre, tipo y ubicación.
+ *
+ * Cada componente ocupa un "slot" denso; las listas de postings guardan slots
+ * y la búsqueda cuenta coincidencias en un arreglo plano, de modo que el
+ * puntaje se calcula en un bucle contiguo que el compilador puede vectorizar.
+ * Las bajas marcan el slot como muerto y se compacta cuando hay muchos.
+ *
+ * search() es const y no comparte estado: admite búsquedas concurrentes
+ * mientras nadie modifique el índice.
+ */
+class TrigramIndex {
+public:
+    struct Match {
+        int componentId;
+        float score;
+    };
+    
+    TrigramIndex();
+    
+    void build(const QVector<Component>& components);
+    void insert(const Component& component);
+    void update(const Component& component);
+    void remove(int componentId);
+    void clear();
+    
+    int size() const { return idToSlot.size(); }
+    
+    /// Coincidencias aproximadas ordenadas por puntaje descendente
+    QVector<Match> search(const QString& text, int limit = 50, float minScore = 0.3f) const;
+    
+    static QVector<quint64> trigrams(const QString& text);
+    
+    /// Tope de candidatos por búsqueda; los trigramas más comunes solo suman a los ya vistos
+    static const int kMaxCandidates = 20000;
+
+private:
+    void compact();
+    
+    QHash<quint64, QVector<quint32>> postings;   ///< Trigrama -> slots
+    QHash<int, quint32> idToSlot;
+    QVector<int> slotIds;                        ///< Slot -> ID (-1 si está muerto)
+    QVector<quint16> slotTrigramCount;
+    int deadSlots;
+};
+
+#endif // TRIGRAMINDEX_H
@@ -0,0 +1,20 @@
+#ifndef TESTS_BENCHMARK_H
+#define TESTS_BENCHMARK_H
+
+#include <QtTest>
+
+/// Las pruebas de rendimiento solo corren con INVENTORY_BENCH=1, así make check sigue siendo rápido
+#define BENCHMARK_ONLY() \
+    do { \
+        if (!qEnvironmentVariableIsSet("INVENTORY_BENCH")) { \
+            QSKIP("Prueba de rendimiento: ejecutar con INVENTORY_BENCH=1"); \
+        } \
+    } while (0)
+
+/// Tamaño del conjunto de datos; INVENTORY_BENCH_ROWS lo sustituye
+inline int benchmarkRows(int defaultRows) {
+    return qEnvironmentVariableIsSet("INVENTORY_BENCH_ROWS")
+           ? qEnvironmentVariableIntValue("INVENTORY_BENCH_ROWS") : defaultRows;
+}
+
+#endif // TESTS_BENCHMARK_H
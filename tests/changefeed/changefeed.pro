@@ -0,0 +1,15 @@
+TARGET = tst_changefeed
+include(../tests.pri)
+
+QT += concurrent network
+
+SOURCES += \
+    tst_changefeed.cpp \
+    $$SRC_DIR/changefeed.cpp \
+    $$SRC_DIR/component.cpp \
+    $$SRC_DIR/databasemanager.cpp
+
+HEADERS += \
+    $$SRC_DIR/changefeed.h \
+    $$SRC_DIR/component.h \
+    $$SRC_DIR/databasemanager.h
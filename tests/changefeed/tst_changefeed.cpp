@@ -0,0 +1,99 @@
+#include <QtTest>
+#include <QFile>
+#include <QJsonDocument>
+#include <QSqlQuery>
+#include <QTemporaryDir>
+#include "changefeed.h"
+#include "databasemanager.h"
+
+class TestChangeFeed : public QObject {
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void exportResumesAfterTruncatedLine();
+    void gapReportedAfterPrune();
+
+private:
+    void addComponent(const QString& name);
+    QList<QJsonObject> exportedLines();
+    
+    QTemporaryDir dir;
+    DatabaseManager* db = nullptr;
+};
+
+void TestChangeFeed::initTestCase() {
+    QVERIFY(dir.isValid());
+    DatabaseManager::setDataDirectory(dir.path());
+    db = DatabaseManager::getInstance();
+    QVERIFY(db->initialize());
+}
+
+void TestChangeFeed::addComponent(const QString& name) {
+    int newId = -1;
+    QVERIFY(db->addComponent(Component(-1, name, "Resistencia", 5, "Cajón C3", QDate(2024, 4, 1)),
+                             &newId));
+}
+
+QList<QJsonObject> TestChangeFeed::exportedLines() {
+    QList<QJsonObject> lines;
+    QFile file(dir.filePath("cambios.jsonl"));
+    if (!file.open(QIODevice::ReadOnly)) {
+        return lines;
+    }
+    while (!file.atEnd()) {
+        lines.append(QJsonDocument::fromJson(file.readLine()).object());
+    }
+    return lines;
+}
+
+void TestChangeFeed::exportResumesAfterTruncatedLine() {
+    addComponent("R 1k");
+    addComponent("R 2k2");
+    {
+        ChangeFeedServer feed(db);
+        QVERIFY(feed.setExportFile(dir.filePath("cambios.jsonl")));
+    }
+    QCOMPARE(exportedLines().size(), 2);
+    
+    // Una escritura cortada a mitad de línea
+    QFile file(dir.filePath("cambios.jsonl"));
+    QVERIFY(file.open(QIODevice::WriteOnly | QIODevice::Append));
+    file.write("{\"seq\":3,\"op\":\"ins");
+    file.close();
+    
+    addComponent("R 4k7");
+    ChangeFeedServer feed(db);
+    QVERIFY(feed.setExportFile(dir.filePath("cambios.jsonl")));
+    
+    // Se reanuda tras la última línea completa, sin repetir ni pegar líneas
+    const QList<QJsonObject> lines = exportedLines();
+    QCOMPARE(lines.size(), 3);
+    for (int i = 0; i < lines.size(); ++i) {
+        QCOMPARE(lines[i].value("seq").toInt(), i + 1);
+    }
+}
+
+void TestChangeFeed::gapReportedAfterPrune() {
+    QFile::remove(dir.filePath("cambios.jsonl"));
+    addComponent("C 10u");
+    const qint64 last = db->getLastChangeSeq();
+    
+    // Todo lo anterior se depura antes de que el archivo lo lea
+    QSqlQuery query(DatabaseManager::connectionForThread(db->getDatabasePath()));
+    QVERIFY(query.exec("UPDATE cambios SET created_at = '2000-01-01T00:00:00.000Z'"));
+    QVERIFY(db->pruneChanges(last - 1, QDateTime::currentDateTimeUtc().addDays(-7)));
+    
+    ChangeFeedServer feed(db);
+    QVERIFY(feed.setExportFile(dir.filePath("cambios.jsonl")));
+    const QList<QJsonObject> lines = exportedLines();
+    QCOMPARE(lines.size(), 2);
+    QCOMPARE(lines[0].value("op").toString(), QString("gap"));
+    QCOMPARE(lines[0].value("data").toObject().value("from").toInt(), 1);
+    QCOMPARE(lines[0].value("data").toObject().value("to").toInt(), int(last - 1));
+    QVERIFY(lines[0].value("data").toObject().value("resync").toBool());
+    QCOMPARE(lines[1].value("seq").toInt(), int(last));
+}
+
+QTEST_GUILESS_MAIN(TestChangeFeed)
+#include "tst_changefeed.moc"
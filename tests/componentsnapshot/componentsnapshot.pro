@@ -0,0 +1,12 @@
+TARGET = tst_componentsnapshot
+include(../tests.pri)
+
+SOURCES += \
+    tst_componentsnapshot.cpp \
+    $$SRC_DIR/component.cpp \
+    $$SRC_DIR/componentsnapshot.cpp
+
+HEADERS += \
+    ../benchmark.h \
+    $$SRC_DIR/component.h \
+    $$SRC_DIR/componentsnapshot.h
@@ -0,0 +1,220 @@
+#include <QtTest>
+#include <QElapsedTimer>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QTemporaryDir>
+#include "componentsnapshot.h"
+#ifdef Q_OS_LINUX
+#include <fcntl.h>
+#endif
+#include "../benchmark.h"
+
+class TestComponentSnapshot : public QObject {
+    Q_OBJECT
+
+private slots:
+    void init();
+    void writeAndOpen();
+    void corruptBlockFailsOnRead();
+    void rejectsCorruptChecksumTable();
+    void rejectsOtherVersion();
+    void rebuildStoresDataVersion();
+    void toVectorSharesRepeatedStrings();
+    void benchmarkOpenAndList();
+
+private:
+    static QVector<Component> sample(int count);
+    void flipByte(qint64 offset);   ///< offset < 0 cuenta desde el final
+    
+    QTemporaryDir dir;
+    QString path;
+};
+
+QVector<Component> TestComponentSnapshot::sample(int count) {
+    // Pocos tipos y ubicaciones distintos, como en un inventario real
+    static const char* const types[] = {"Resistencia", "Capacitor", "Sensor", "Microcontrolador"};
+    static const char* const locations[] = {"Cajón A1", "Cajón A2", "Estante B", "Armario C"};
+    QVector<Component> components;
+    components.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        components.append(Component(i + 1, QString("Componente %1").arg(i, 7, 10, QChar('0')),
+                                    types[i % 4], i % 100, locations[(i / 4) % 4],
+                                    QDate(2024, 1, 1).addDays(i % 365)));
+    }
+    return components;
+}
+
+void TestComponentSnapshot::init() {
+    QVERIFY(dir.isValid());
+    path = dir.filePath("inventory.db.snapshot");
+    QFile::remove(path);
+}
+
+void TestComponentSnapshot::writeAndOpen() {
+    const QVector<Component> components = sample(10);
+    QVERIFY(ComponentSnapshot::write(path, components, 42));
+    
+    ComponentSnapshot snapshot;
+    QVERIFY(snapshot.open(path));
+    QCOMPARE(snapshot.count(), 10);
+    QCOMPARE(snapshot.dataVersion(), quint64(42));
+    
+    for (int i = 0; i < components.size(); ++i) {
+        const Component stored = snapshot.at(i);
+        QCOMPARE(stored.getId(), components[i].getId());
+        QCOMPARE(stored.getName(), components[i].getName());
+        QCOMPARE(stored.getType(), components[i].getType());
+        QCOMPARE(stored.getQuantity(), components[i].getQuantity());
+        QCOMPARE(stored.getLocation(), components[i].getLocation());
+        QCOMPARE(stored.getPurchaseDate(), components[i].getPurchaseDate());
+    }
+    QCOMPARE(snapshot.at(10).getId(), -1);
+}
+
+void TestComponentSnapshot::flipByte(qint64 offset) {
+    QFile file(path);
+    QVERIFY(file.open(QIODevice::ReadWrite));
+    if (offset < 0) {
+        offset += file.size();
+    }
+    file.seek(offset);
+    char byte = 0;
+    file.getChar(&byte);
+    file.seek(offset);
+    file.putChar(char(byte ^ 0x5A));
+}
+
+void TestComponentSnapshot::corruptBlockFailsOnRead() {
+    // ~1,4 MB de cuerpo: varios bloques de 256 KiB
+    const QVector<Component> components = sample(20000);
+    QVERIFY(ComponentSnapshot::write(path, components));
+    flipByte(-1);   // Último bloque del pool
+    
+    // Abrir no recorre el cuerpo: el daño aparece al leer el bloque afectado
+    ComponentSnapshot snapshot;
+    QVERIFY(snapshot.open(path));
+    QVERIFY(!snapshot.isCorrupt());
+    QCOMPARE(snapshot.at(0).getName(), components[0].getName());
+    QVERIFY(!snapshot.isCorrupt());
+    
+    QVERIFY(snapshot.toVector().isEmpty());
+    QVERIFY(snapshot.isCorrupt());
+    QCOMPARE(snapshot.at(components.size() - 1).getId(), -1);
+}
+
+void TestComponentSnapshot::rejectsCorruptChecksumTable() {
+    QVERIFY(ComponentSnapshot::write(path, sample(10)));
+    flipByte(40);   // Primera entrada de la tabla, justo tras la cabecera
+    
+    ComponentSnapshot snapshot;
+    QVERIFY(!snapshot.open(path));
+    QVERIFY(!snapshot.isOpen());
+}
+
+void TestComponentSnapshot::rejectsOtherVersion() {
+    QVERIFY(ComponentSnapshot::write(path, sample(3)));
+    
+    // La versión va justo después del magic
+    QFile file(path);
+    QVERIFY(file.open(QIODevice::ReadWrite));
+    file.seek(4);
+    const quint32 oldVersion = 1;
+    file.write(reinterpret_cast<const char*>(&oldVersion), sizeof(oldVersion));
+    file.close();
+    
+    ComponentSnapshot snapshot;
+    QVERIFY(!snapshot.open(path));
+}
+
+void TestComponentSnapshot::rebuildStoresDataVersion() {
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", "snapshot_test");
+        db.setDatabaseName(dir.filePath("inventory.db"));
+        QVERIFY(db.open());
+        QSqlQuery query(db);
+        QVERIFY(query.exec("CREATE TABLE componentes (id INTEGER PRIMARY KEY AUTOINCREMENT, "
+                           "name TEXT, type TEXT, quantity INTEGER, location TEXT, purchase_date TEXT)"));
+        QVERIFY(query.exec("CREATE TABLE cambios (seq INTEGER PRIMARY KEY AUTOINCREMENT, op TEXT)"));
+        
+        // Sin cambios registrados la versión es 0
+        QCOMPARE(ComponentSnapshot::currentDataVersion(db), quint64(0));
+        
+        QVERIFY(query.exec("INSERT INTO componentes (name, type, quantity, location, purchase_date) "
+                           "VALUES ('LED rojo', 'LED', 3, 'Cajón A1', '2024-05-01')"));
+        for (int i = 0; i < 3; ++i) {
+            QVERIFY(query.exec("INSERT INTO cambios (op) VALUES ('insert')"));
+        }
+        // Depurar el registro no hace retroceder la versión
+        QVERIFY(query.exec("DELETE FROM cambios"));
+        
+        QVERIFY(ComponentSnapshot::rebuild(path, db));
+        QCOMPARE(ComponentSnapshot::currentDataVersion(db), quint64(3));
+        db.close();
+    }
+    QSqlDatabase::removeDatabase("snapshot_test");
+    
+    ComponentSnapshot snapshot;
+    QVERIFY(snapshot.open(path));
+    QCOMPARE(snapshot.count(), 1);
+    QCOMPARE(snapshot.dataVersion(), quint64(3));
+    QCOMPARE(snapshot.at(0).getName(), QString("LED rojo"));
+    QCOMPARE(snapshot.at(0).getPurchaseDate(), QDate(2024, 5, 1));
+}
+
+void TestComponentSnapshot::toVectorSharesRepeatedStrings() {
+    QVERIFY(ComponentSnapshot::write(path, sample(64)));
+    ComponentSnapshot snapshot;
+    QVERIFY(snapshot.open(path));
+    
+    const QVector<Component> components = snapshot.toVector();
+    QCOMPARE(components.size(), 64);
+    // Mismo tipo -> mismos datos compartidos, no una copia por componente
+    QCOMPARE(components[0].getType(), components[4].getType());
+    QCOMPARE(components[0].getType().constData(), components[4].getType().constData());
+    QVERIFY(components[0].getName().constData() != components[4].getName().constData());
+}
+
+void TestComponentSnapshot::benchmarkOpenAndList() {
+    // Arranque en frío: mapear y validar el archivo y materializar la lista.
+    // Objetivo de la petición: listar 1M de componentes en menos de 200 ms
+    BENCHMARK_ONLY();
+    const int rows = benchmarkRows(1000000);
+    QVERIFY(ComponentSnapshot::write(path, sample(rows)));
+    
+#ifdef Q_OS_LINUX
+    {
+        // Sacar el archivo de la caché de páginas para medir de verdad en frío
+        QFile file(path);
+        QVERIFY(file.open(QIODevice::ReadOnly));
+        posix_fadvise(file.handle(), 0, 0, POSIX_FADV_DONTNEED);
+    }
+#endif
+    
+    QElapsedTimer timer;
+    timer.start();
+    ComponentSnapshot snapshot;
+    QVERIFY(snapshot.open(path));
+    const qint64 openUs = timer.nsecsElapsed() / 1000;
+    const Component first = snapshot.at(0);
+    const qint64 firstUs = timer.nsecsElapsed() / 1000;
+    const QVector<Component> components = snapshot.toVector();
+    const qint64 listMs = timer.elapsed();
+    qDebug() << rows << "componentes: open" << openUs << "µs, primer registro" << firstUs
+             << "µs, open + toVector" << listMs << "ms";
+    QCOMPARE(first.getId(), 1);
+    QCOMPARE(components.size(), rows);
+    snapshot.close();
+    if (rows >= 1000000 && listMs >= 200) {
+        QWARN(qPrintable(QString("Objetivo de 200 ms no alcanzado: %1 ms").arg(listMs)));
+    }
+    
+    QBENCHMARK {
+        ComponentSnapshot mapped;
+        mapped.open(path);
+        QVector<Component> list = mapped.toVector();
+        Q_UNUSED(list);
+    }
+}
+
+QTEST_GUILESS_MAIN(TestComponentSnapshot)
+#include "tst_componentsnapshot.moc"
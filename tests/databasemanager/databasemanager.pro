@@ -0,0 +1,16 @@
+TARGET = tst_databasemanager
+include(../tests.pri)
+
+QT += concurrent
+
+SOURCES += \
+    tst_databasemanager.cpp \
+    $$SRC_DIR/component.cpp \
+    $$SRC_DIR/databasemanager.cpp \
+    $$SRC_DIR/maintenancescheduler.cpp
+
+HEADERS += \
+    ../benchmark.h \
+    $$SRC_DIR/component.h \
+    $$SRC_DIR/databasemanager.h \
+    $$SRC_DIR/maintenancescheduler.h
@@ -0,0 +1,771 @@
+#include <QtTest>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QSignalSpy>
+#include <QSqlQuery>
+#include <QTemporaryDir>
+#include "databasemanager.h"
+#include "maintenancescheduler.h"
+#include "../benchmark.h"
+#include <algorithm>
+
+// DatabaseManager es un singleton: todas las pruebas comparten la BD del directorio temporal
+class TestDatabaseManager : public QObject {
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void ignoresInvalidSiteFiles();
+    void legacyFilesConvertedOnlyOnRequest();
+    void siteIdsDoNotOverlap();
+    void adjustsRoutedBySite();
+    void rejectsIdsFromOtherSite();
+    void siteChangesRelayedToMainLog();
+    void relaySkipsAlreadyCopiedChanges();
+    void limitsAttachedSites();
+    void pruneKeepsRecentChanges();
+    void pagesCoverEveryRowOnce();
+    void pageTokenStableAcrossInserts();
+    void pageFiltersCombine();
+    void invalidPageTokenRejected();
+    void visitorStopsEarly();
+    void fifoConsumesOldestLotsFirst();
+    void lotShortfallFails();
+    void lotsInRangeOrderedById();
+    void lotQueriesUseIndexes();
+    void lowStockQueryUsesIndex();
+    void journalModeOnlyAtStartup();
+    void threadConnectionsFollowProfile();
+    void benchmarkProfiles();
+    void benchmarkPagination();
+    void benchmarkLotQueries();
+
+private:
+    Component addTo(const QString& site, const QString& name, int quantity);
+    
+    QTemporaryDir dir;
+    DatabaseManager* db = nullptr;
+};
+
+void TestDatabaseManager::initTestCase() {
+    QVERIFY(dir.isValid());
+    QVERIFY(QDir(dir.path()).mkpath("sites"));
+    // Un archivo con un nombre que no sería un identificador SQL válido
+    QFile invalid(dir.filePath("sites/mal-nombre.db"));
+    QVERIFY(invalid.open(QIODevice::WriteOnly));
+    invalid.close();
+    
+    // Sede creada antes de auto_vacuum incremental
+    {
+        QSqlDatabase legacy = QSqlDatabase::addDatabase("QSQLITE", "legacy_site");
+        legacy.setDatabaseName(dir.filePath("sites/legado.db"));
+        QVERIFY(legacy.open());
+        QSqlQuery query(legacy);
+        QVERIFY(query.exec("CREATE TABLE notas (texto TEXT)"));
+        QVERIFY(query.exec("PRAGMA auto_vacuum") && query.next());
+        QCOMPARE(query.value(0).toInt(), 0);
+    }
+    QSqlDatabase::removeDatabase("legacy_site");
+    
+    DatabaseManager::setDataDirectory(dir.path());
+    db = DatabaseManager::getInstance();
+    QVERIFY(db->initialize());
+}
+
+Component TestDatabaseManager::addTo(const QString& site, const QString& name, int quantity) {
+    Component component(-1, name, "Resistencia", quantity, "Cajón A1", QDate(2024, 3, 1));
+    component.setSite(site);
+    int newId = -1;
+    if (db->addComponent(component, &newId)) {
+        component.setId(newId);
+    }
+    return component;
+}
+
+void TestDatabaseManager::ignoresInvalidSiteFiles() {
+    QVERIFY(!db->getSites().contains("mal-nombre"));
+    QVERIFY(!DatabaseManager::isValidSiteName("mal-nombre"));
+    QVERIFY(!DatabaseManager::isValidSiteName(DatabaseManager::kMainSite));
+    QVERIFY(DatabaseManager::isValidSiteName("norte_2"));
+    QVERIFY(db->getSitePath("../fuera").isEmpty());
+}
+
+void TestDatabaseManager::legacyFilesConvertedOnlyOnRequest() {
+    // Adjuntar una sede antigua no la reescribe: el VACUUM es un paso explícito
+    QVERIFY(db->getSites().contains("legado"));
+    auto autoVacuum = [](const QString& path) {
+        QSqlQuery query(DatabaseManager::connectionForThread(path));
+        return query.exec("PRAGMA auto_vacuum") && query.next() ? query.value(0).toInt() : -1;
+    };
+    QCOMPARE(autoVacuum(db->getSitePath(DatabaseManager::kMainSite)), 2);
+    QCOMPARE(autoVacuum(db->getSitePath("legado")), 0);
+    
+    // La pasada de mantenimiento lo señala en lugar de convertirlo
+    MaintenanceScheduler maintenance(db->getDatabasePath(), dir.filePath("sites"));
+    maintenance.setIdleThreshold(0);
+    QHash<QString, bool> conversionNeeded;
+    connect(&maintenance, &MaintenanceScheduler::maintenanceFinished, this,
+            [&conversionNeeded](const MaintenanceReport& report) {
+        conversionNeeded.insert(report.path, report.conversionNeeded);
+    });
+    maintenance.runNow();
+    QCOMPARE(conversionNeeded.value(db->getDatabasePath(), true), false);
+    QCOMPARE(conversionNeeded.value(db->getSitePath("legado"), false), true);
+    QCOMPARE(autoVacuum(db->getSitePath("legado")), 0);
+    
+    // Conversión fuera de línea, sobre un archivo que nadie tiene abierto
+    const QString offline = dir.filePath("antiguo.db");
+    {
+        QSqlDatabase legacy = QSqlDatabase::addDatabase("QSQLITE", "offline_legacy");
+        legacy.setDatabaseName(offline);
+        QVERIFY(legacy.open());
+        QSqlQuery query(legacy);
+        QVERIFY(query.exec("CREATE TABLE notas (texto TEXT)"));
+    }
+    QSqlDatabase::removeDatabase("offline_legacy");
+    QString error;
+    QVERIFY2(MaintenanceScheduler::convertToIncrementalVacuum(offline, &error), qPrintable(error));
+    QCOMPARE(autoVacuum(offline), 2);
+    DatabaseManager::releaseThreadConnection(offline);
+}
+
+void TestDatabaseManager::siteIdsDoNotOverlap() {
+    QVERIFY(db->addSite("norte"));
+    QVERIFY(db->addSite("sur"));
+    
+    const Component main = addTo(QString(), "R 10k", 5);
+    const Component north = addTo("norte", "R 10k", 7);
+    const Component south = addTo("sur", "R 10k", 9);
+    QVERIFY(main.getId() > 0);
+    QVERIFY(north.getId() > 0);
+    QVERIFY(south.getId() > 0);
+    QVERIFY(main.getId() != north.getId());
+    QVERIFY(north.getId() != south.getId());
+    QVERIFY(main.getId() != south.getId());
+}
+
+void TestDatabaseManager::adjustsRoutedBySite() {
+    const Component main = addTo(QString(), "C 100n", 10);
+    const Component north = addTo("norte", "C 100n", 4);
+    
+    int newQuantity = 0;
+    QVERIFY(db->updateQuantity(north.getId(), -3, "norte", &newQuantity));
+    QCOMPARE(newQuantity, 1);
+    QCOMPARE(db->getComponentById(north.getId(), "norte").getQuantity(), 1);
+    QCOMPARE(db->getComponentById(north.getId(), "norte").getSite(), QString("norte"));
+    // La fila de la principal no se toca
+    QCOMPARE(db->getComponentById(main.getId()).getQuantity(), 10);
+    
+    // El registro de cambios guarda la sede del ajuste
+    const QVector<ChangeEvent> changes = db->getChangesSince(db->getLastChangeSeq() - 1);
+    QCOMPARE(changes.size(), 1);
+    QCOMPARE(changes[0].site, QString("norte"));
+    QCOMPARE(changes[0].delta.toInt(), -3);
+}
+
+void TestDatabaseManager::siteChangesRelayedToMainLog() {
+    const Component north = addTo("norte", "Diodo", 3);
+    QVERIFY(db->updateQuantity(north.getId(), 2, "norte"));
+    
+    // Los cambios se anotan en el archivo de la sede y se copian al confirmar
+    QSqlQuery outbox(DatabaseManager::connectionForThread(db->getSitePath("norte")));
+    QVERIFY(outbox.exec("SELECT COUNT(*) FROM cambios_sede") && outbox.next());
+    QCOMPARE(outbox.value(0).toInt(), 0);
+    
+    const QVector<ChangeEvent> changes = db->getChangesSince(db->getLastChangeSeq() - 2);
+    QCOMPARE(changes.size(), 2);
+    QCOMPARE(changes[0].op, QString("insert"));
+    QCOMPARE(changes[1].site, QString("norte"));
+    QCOMPARE(changes[1].delta.toInt(), 2);
+}
+
+void TestDatabaseManager::relaySkipsAlreadyCopiedChanges() {
+    QSqlQuery main(DatabaseManager::connectionForThread(db->getDatabasePath()));
+    QVERIFY(main.exec("SELECT MAX(site_seq) FROM cambios WHERE site = 'norte'") && main.next());
+    const qint64 copied = main.value(0).toLongLong();
+    QVERIFY(copied > 0);
+    
+    // Una caída entre copiar y vaciar deja la entrada en el archivo de la sede
+    QSqlQuery outbox(DatabaseManager::connectionForThread(db->getSitePath("norte")));
+    outbox.prepare("INSERT INTO cambios_sede (seq, op, component_id, delta, payload, created_at) "
+                   "VALUES (:seq, 'adjust', 1, 1, '{}', '2024-03-01T00:00:00')");
+    outbox.bindValue(":seq", copied);
+    QVERIFY(outbox.exec());
+    
+    const Component north = addTo("norte", "Zener", 1);
+    QVERIFY(north.getId() > 0);
+    QVERIFY(main.exec(QString("SELECT COUNT(*) FROM cambios WHERE site = 'norte' AND site_seq = %1")
+                      .arg(copied)) && main.next());
+    QCOMPARE(main.value(0).toInt(), 1);
+    QVERIFY(outbox.exec("SELECT COUNT(*) FROM cambios_sede") && outbox.next());
+    QCOMPARE(outbox.value(0).toInt(), 0);
+}
+
+void TestDatabaseManager::rejectsIdsFromOtherSite() {
+    const Component main = addTo(QString(), "LED", 6);
+    const Component north = addTo("norte", "LED", 6);
+    QSignalSpy errors(db, &DatabaseManager::errorOccurred);
+    
+    QVERIFY(!db->updateQuantity(main.getId(), -1, "norte"));
+    QVERIFY(!db->updateQuantity(north.getId(), -1));
+    QVERIFY(!db->updateQuantity(north.getId(), -1, "sur"));
+    QVERIFY(!db->updateQuantity(north.getId(), -1, "desconocida"));
+    QVERIFY(!db->deleteComponent(north.getId()));
+    QCOMPARE(errors.count(), 5);
+    
+    QCOMPARE(db->getComponentById(north.getId()).getId(), -1);
+    QCOMPARE(db->getComponentById(main.getId(), "norte").getId(), -1);
+    QCOMPARE(db->getComponentById(main.getId()).getQuantity(), 6);
+    QCOMPARE(db->getComponentById(north.getId(), "norte").getQuantity(), 6);
+}
+
+void TestDatabaseManager::limitsAttachedSites() {
+    // legado, norte y sur ya están adjuntas; SQLite admite 10 por defecto
+    const int attached = db->getSites().size() - 1;
+    for (int i = attached; i < 10; ++i) {
+        QVERIFY(db->addSite(QString("sede%1").arg(i)));
+    }
+    QSignalSpy errors(db, &DatabaseManager::errorOccurred);
+    QVERIFY(!db->addSite("sobrante"));
+    QCOMPARE(errors.count(), 1);
+    QVERIFY(!db->getSites().contains("sobrante"));
+}
+
+void TestDatabaseManager::pruneKeepsRecentChanges() {
+    const qint64 start = db->getLastChangeSeq();
+    for (int i = 0; i < 3; ++i) {
+        QVERIFY(addTo(QString(), QString("Diodo %1").arg(i), 1).getId() > 0);
+    }
+    QCOMPARE(db->getLastChangeSeq(), start + 3);
+    
+    // Las dos primeras entradas pasan a ser antiguas
+    QSqlDatabase reader = DatabaseManager::connectionForThread(db->getDatabasePath());
+    QSqlQuery query(reader);
+    query.prepare("UPDATE cambios SET created_at = '2000-01-01T00:00:00.000Z' WHERE seq <= :seq");
+    query.bindValue(":seq", start + 2);
+    QVERIFY(query.exec());
+    
+    // Confirmadas hasta start + 3, pero solo se borra lo anterior al corte
+    QVERIFY(db->pruneChanges(start + 3, QDateTime::currentDateTimeUtc().addDays(-7)));
+    const QVector<ChangeEvent> left = DatabaseManager::readChangesSince(reader, start);
+    QCOMPARE(left.size(), 1);
+    QCOMPARE(left[0].seq, start + 3);
+    
+    // La secuencia no retrocede aunque se depure
+    QCOMPARE(db->getLastChangeSeq(), start + 3);
+}
+
+void TestDatabaseManager::pagesCoverEveryRowOnce() {
+    // Nombres repetidos: el desempate por ID evita saltar o repetir filas
+    QVector<int> expected;
+    for (int i = 0; i < 10; ++i) {
+        expected.append(addTo(QString(), QString("Paginado %1").arg(i % 4), 3).getId());
+    }
+    
+    ComponentQuery filter;
+    filter.searchText = "Paginado";
+    QVector<Component> seen;
+    QString token;
+    int pages = 0;
+    do {
+        const ComponentPage page = db->getComponentsPage(filter, token, 3);
+        QVERIFY(page.components.size() <= 3);
+        seen += page.components;
+        token = page.nextToken;
+        ++pages;
+    } while (!token.isEmpty() && pages < 10);
+    QCOMPARE(pages, 4);
+    QCOMPARE(seen.size(), expected.size());
+    
+    QVector<int> ids;
+    for (int i = 0; i < seen.size(); ++i) {
+        ids.append(seen[i].getId());
+        if (i > 0) {
+            const Component& prev = seen[i - 1];
+            QVERIFY(prev.getName() < seen[i].getName() ||
+                    (prev.getName() == seen[i].getName() && prev.getId() < seen[i].getId()));
+        }
+    }
+    std::sort(ids.begin(), ids.end());
+    std::sort(expected.begin(), expected.end());
+    QCOMPARE(ids, expected);
+}
+
+void TestDatabaseManager::pageTokenStableAcrossInserts() {
+    for (int i = 0; i < 6; ++i) {
+        QVERIFY(addTo(QString(), QString("Cursor %1").arg(i), 1).getId() > 0);
+    }
+    ComponentQuery filter;
+    filter.searchText = "Cursor";
+    const ComponentPage first = db->getComponentsPage(filter, QString(), 3);
+    QCOMPARE(first.components.size(), 3);
+    QCOMPARE(first.components.last().getName(), QString("Cursor 2"));
+    
+    // Altas antes y después del cursor entre dos páginas: sin duplicados ni saltos
+    QVERIFY(addTo(QString(), "Cursor 0b", 1).getId() > 0);
+    QVERIFY(addTo(QString(), "Cursor 4b", 1).getId() > 0);
+    const ComponentPage second = db->getComponentsPage(filter, first.nextToken, 10);
+    QStringList names;
+    for (const Component& component : second.components) {
+        names << component.getName();
+    }
+    QCOMPARE(names, QStringList({"Cursor 3", "Cursor 4", "Cursor 4b", "Cursor 5"}));
+    QVERIFY(second.nextToken.isEmpty());
+}
+
+void TestDatabaseManager::pageFiltersCombine() {
+    for (int i = 0; i < 5; ++i) {
+        QVERIFY(addTo(QString(), QString("Filtro %1").arg(i), i * 2).getId() > 0);
+    }
+    ComponentQuery filter;
+    filter.searchText = "Filtro";
+    filter.maxQuantity = 4;
+    const ComponentPage page = db->getComponentsPage(filter, QString(), 100);
+    QCOMPARE(page.components.size(), 3);
+    for (const Component& component : page.components) {
+        QVERIFY(component.getQuantity() <= 4);
+    }
+    QVERIFY(page.nextToken.isEmpty());
+}
+
+void TestDatabaseManager::invalidPageTokenRejected() {
+    QSignalSpy errors(db, &DatabaseManager::errorOccurred);
+    const ComponentPage page = db->getComponentsPage(ComponentQuery(), "no-es-un-token", 10);
+    QVERIFY(page.components.isEmpty());
+    QVERIFY(page.nextToken.isEmpty());
+    QCOMPARE(errors.count(), 1);
+    
+    // Un token válido de otra consulta se acepta: solo codifica la posición
+    ComponentQuery filter;
+    filter.searchText = "Paginado";
+    const ComponentPage first = db->getComponentsPage(filter, QString(), 1);
+    QVERIFY(!first.nextToken.isEmpty());
+    QVERIFY(!db->getComponentsPage(ComponentQuery(), first.nextToken, 1).components.isEmpty());
+    QCOMPARE(errors.count(), 1);
+}
+
+void TestDatabaseManager::visitorStopsEarly() {
+    ComponentQuery filter;
+    filter.searchText = "Paginado";
+    int visited = 0;
+    QVERIFY(db->visitComponents(filter, [&visited](const Component&) {
+        return ++visited < 5;
+    }, 2));
+    QCOMPARE(visited, 5);
+    
+    // Sin parar recorre lo mismo que las páginas
+    visited = 0;
+    QVERIFY(db->visitComponents(filter, [&visited](const Component&) {
+        ++visited;
+        return true;
+    }, 3));
+    QCOMPARE(visited, 10);
+}
+
+void TestDatabaseManager::fifoConsumesOldestLotsFirst() {
+    const Component component = addTo(QString(), "FIFO", 4);   // Lote del 2024-03-01
+    const int id = component.getId();
+    QVERIFY(db->updateQuantity(id, 5, QString(), nullptr, QDate(2024, 1, 1), 1.0));
+    QVERIFY(db->updateQuantity(id, 5, QString(), nullptr, QDate(2024, 5, 1), 2.0));
+    const QVector<Lot> lots = db->getLots(id);
+    QCOMPARE(lots.size(), 3);
+    QCOMPARE(lots[0].purchaseDate, QDate(2024, 1, 1));
+    
+    // Se vacía el de enero y se toman 2 del de marzo; los lotes tocados se devuelven
+    QVector<LotShift> shifts;
+    int quantity = 0;
+    QVERIFY(db->updateQuantity(id, -7, QString(), &quantity, QDate(), 0.0, &shifts));
+    QCOMPARE(quantity, 7);
+    QCOMPARE(shifts.size(), 2);
+    QCOMPARE(shifts[0].lotId, lots[0].id);
+    QCOMPARE(shifts[0].units, -5);
+    QCOMPARE(shifts[1].lotId, lots[1].id);
+    QCOMPARE(shifts[1].units, -2);
+    
+    const QVector<Lot> open = db->getLots(id);
+    QCOMPARE(open.size(), 2);
+    QCOMPARE(open[0].id, lots[1].id);
+    QCOMPARE(open[0].remaining, 2);
+    QCOMPARE(open[1].remaining, 5);
+    
+    // Los mismos movimientos invertidos devuelven las unidades a esos lotes
+    for (LotShift& shift : shifts) {
+        shift.units = -shift.units;
+    }
+    QVERIFY(db->updateQuantity(id, 7, QString(), &quantity, QDate(), 0.0, &shifts));
+    QCOMPARE(quantity, 14);
+    QCOMPARE(db->getLots(id).size(), 3);
+    QCOMPARE(db->getLots(id)[0].remaining, 5);
+}
+
+void TestDatabaseManager::lotShortfallFails() {
+    const Component component = addTo(QString(), "Lotes descuadrados", 5);
+    const int id = component.getId();
+    
+    // Lotes que ya no suman la cantidad (p. ej. editados a mano)
+    QSqlQuery query(DatabaseManager::connectionForThread(db->getDatabasePath()));
+    query.prepare("UPDATE lotes SET remaining = 1 WHERE component_id = :id");
+    query.bindValue(":id", id);
+    QVERIFY(query.exec());
+    
+    QSignalSpy errors(db, &DatabaseManager::errorOccurred);
+    QVERIFY(!db->updateQuantity(id, -3));
+    QCOMPARE(errors.count(), 1);
+    QCOMPARE(db->getComponentById(id).getQuantity(), 5);
+    QCOMPARE(db->getLots(id)[0].remaining, 1);
+    
+    // Lo que los lotes cubren se sigue pudiendo retirar
+    QVERIFY(db->updateQuantity(id, -1));
+    QCOMPARE(db->getComponentById(id).getQuantity(), 4);
+}
+
+void TestDatabaseManager::lotsInRangeOrderedById() {
+    // Varios lotes del mismo día: el orden no puede depender del plan de consulta
+    const QDate day(2031, 7, 15);
+    QVector<qint64> expected;
+    for (int i = 0; i < 4; ++i) {
+        const Component component = addTo(QString(), QString("Mismo día %1").arg(i), 0);
+        QVector<LotShift> shifts;
+        QVERIFY(db->updateQuantity(component.getId(), 10 - i, QString(), nullptr, day,
+                                   0.5, &shifts));
+        QCOMPARE(shifts.size(), 1);
+        QVERIFY(shifts[0].wholeLot);
+        expected.append(shifts[0].lotId);
+    }
+    
+    const QVector<Lot> lots = db->getLotsPurchasedBetween(day, day);
+    QVector<qint64> ids;
+    for (const Lot& lot : lots) {
+        ids.append(lot.id);
+    }
+    QCOMPARE(ids, expected);
+    QCOMPARE(db->getLotsPurchasedBetween(day, day, 2).size(), 2);
+    QCOMPARE(db->getLotsPurchasedBetween(day, day, 2)[1].id, expected[1]);
+    
+    const LotTotals totals = db->getPurchaseTotals(day, day);
+    QCOMPARE(totals.lots, 4);
+    QCOMPARE(totals.received, qint64(10 + 9 + 8 + 7));
+}
+
+void TestDatabaseManager::lotQueriesUseIndexes() {
+    // Los rangos de fechas y los más antiguos se resuelven por índice, sin ordenar aparte
+    const QVector<QPair<QString, QString>> plans = {
+        {"SELECT id, component_id, received, remaining, purchase_day, unit_cost FROM lotes "
+         "WHERE purchase_day BETWEEN 1 AND 2 ORDER BY purchase_day, id LIMIT 10", "idx_lotes_day_id"},
+        {"SELECT COUNT(*), TOTAL(received), TOTAL(remaining), TOTAL(received * unit_cost) "
+         "FROM lotes WHERE purchase_day BETWEEN 1 AND 2", "COVERING INDEX idx_lotes_day_id"},
+        {"SELECT id, component_id, received, remaining, purchase_day, unit_cost FROM lotes "
+         "WHERE remaining > 0 ORDER BY purchase_day, id LIMIT 10", "idx_lotes_open"},
+        {"SELECT id, remaining FROM lotes WHERE component_id = 1 AND remaining > 0 "
+         "ORDER BY purchase_day, id", "idx_lotes_component"}};
+    
+    QSqlQuery query(DatabaseManager::connectionForThread(db->getDatabasePath()));
+    for (const auto& plan : plans) {
+        QVERIFY(query.exec("EXPLAIN QUERY PLAN " + plan.first));
+        QString detail;
+        while (query.next()) {
+            detail += query.value(3).toString() + "\n";
+        }
+        QVERIFY2(detail.contains(plan.second), qPrintable(detail));
+        QVERIFY2(!detail.contains("TEMP B-TREE"), qPrintable(detail));
+    }
+}
+
+void TestDatabaseManager::lowStockQueryUsesIndex() {
+    // El resumen de stock bajo de cada sede no recorre la tabla entera
+    for (const QString& site : {DatabaseManager::kMainSite, QString("norte")}) {
+        QSqlQuery query(DatabaseManager::connectionForThread(db->getSitePath(site)));
+        QVERIFY(query.exec("EXPLAIN QUERY PLAN SELECT * FROM componentes WHERE quantity <= 5"));
+        QString detail;
+        while (query.next()) {
+            detail += query.value(3).toString() + "\n";
+        }
+        QVERIFY2(detail.contains("idx_componentes_quantity"), qPrintable(detail));
+    }
+}
+
+void TestDatabaseManager::journalModeOnlyAtStartup() {
+    // Con la BD abierta, salir de WAL fallaría con otras conexiones abiertas
+    QSignalSpy errors(db, &DatabaseManager::errorOccurred);
+    QVERIFY(!db->setPerformanceProfile(PerformanceProfile::Safe));
+    QCOMPARE(errors.count(), 1);
+    QCOMPARE(db->getPerformanceProfile(), PerformanceProfile::Balanced);
+    
+    QSqlQuery query(DatabaseManager::connectionForThread(db->getDatabasePath()));
+    QVERIFY(query.exec("PRAGMA journal_mode") && query.next());
+    QCOMPARE(query.value(0).toString().toLower(), QString("wal"));
+}
+
+void TestDatabaseManager::threadConnectionsFollowProfile() {
+    const QString path = db->getDatabasePath();
+    auto cacheSize = [path]() {
+        QSqlQuery query(DatabaseManager::connectionForThread(path));
+        return query.exec("PRAGMA cache_size") && query.next() ? query.value(0).toInt() : 0;
+    };
+    auto checkpointPages = [path]() {
+        QSqlQuery query(DatabaseManager::connectionForThread(path));
+        return query.exec("PRAGMA wal_autocheckpoint") && query.next() ? query.value(0).toInt() : 0;
+    };
+    const int balanced = cacheSize();
+    QVERIFY(balanced < 0);
+    QCOMPARE(checkpointPages(), 1000);
+    
+    // La conexión ya abierta de este hilo recoge la caché y el checkpoint del nuevo perfil
+    QVERIFY(db->setPerformanceProfile(PerformanceProfile::BulkLoad));
+    const int bulk = cacheSize();
+    QVERIFY(bulk < balanced);
+    QCOMPARE(checkpointPages(), 16384);
+    
+    QVERIFY(db->setPerformanceProfile(PerformanceProfile::Balanced));
+    QCOMPARE(cacheSize(), balanced);
+    QCOMPARE(checkpointPages(), 1000);
+}
+
+void TestDatabaseManager::benchmarkProfiles() {
+    // Misma carga con los PRAGMAs de cada perfil, sobre archivos nuevos: altas y
+    // ajustes de una fila por transacción, búsquedas e importación en lotes de
+    // 1000 filas (donde BulkLoad ahorra checkpoints)
+    BENCHMARK_ONLY();
+    const int rows = benchmarkRows(3000);
+    const int importRows = 200000;
+    const int importBatch = 1000;
+    const QVector<QPair<const char*, PerformanceProfile>> profiles = {
+        {"safe", PerformanceProfile::Safe},
+        {"balanced", PerformanceProfile::Balanced},
+        {"bulk", PerformanceProfile::BulkLoad}};
+    
+    for (const auto& profile : profiles) {
+        const QString name = QString("bench_%1").arg(profile.first);
+        {
+            const QString path = dir.filePath(name + ".db");
+            QFile::remove(path);
+            QSqlDatabase conn = QSqlDatabase::addDatabase("QSQLITE", name);
+            conn.setDatabaseName(path);
+            QVERIFY(conn.open());
+            QSqlQuery query(conn);
+            for (const QString& pragma : DatabaseManager::profilePragmas(profile.second, "main", true)) {
+                QVERIFY2(query.exec(pragma), qPrintable(pragma));
+            }
+            QVERIFY(query.exec("CREATE TABLE componentes (id INTEGER PRIMARY KEY AUTOINCREMENT, "
+                               "name TEXT NOT NULL, type TEXT NOT NULL, "
+                               "quantity INTEGER NOT NULL CHECK(quantity >= 0), "
+                               "location TEXT NOT NULL, purchase_date TEXT NOT NULL)"));
+            QVERIFY(query.exec("CREATE INDEX idx_componentes_name_id ON componentes(name, id)"));
+            QVERIFY(query.exec("CREATE TABLE cambios (seq INTEGER PRIMARY KEY AUTOINCREMENT, op TEXT, "
+                               "component_id INTEGER, site TEXT, delta INTEGER, payload TEXT, "
+                               "created_at TEXT)"));
+            
+            QSqlQuery insert(conn);
+            QSqlQuery log(conn);
+            QSqlQuery select(conn);
+            QSqlQuery update(conn);
+            QVERIFY(insert.prepare("INSERT INTO componentes (name, type, quantity, location, purchase_date) "
+                                   "VALUES (?, 'Resistencia', 100, 'Cajón A', '2024-01-01')"));
+            QVERIFY(log.prepare("INSERT INTO cambios (op, component_id, site, delta, payload, created_at) "
+                                "VALUES ('quantity', ?, 'principal', ?, '{\"id\":1}', "
+                                "'2026-01-01T00:00:00.000Z')"));
+            QVERIFY(select.prepare("SELECT quantity FROM componentes WHERE id = ?"));
+            QVERIFY(update.prepare("UPDATE componentes SET quantity = ? WHERE id = ?"));
+            
+            QElapsedTimer timer;
+            timer.start();
+            for (int i = 0; i < rows; ++i) {
+                conn.transaction();
+                insert.addBindValue(QString("Componente %1").arg(qint64(i) * 7919 % rows));
+                insert.exec();
+                log.addBindValue(i + 1);
+                log.addBindValue(1);
+                log.exec();
+                conn.commit();
+            }
+            const qint64 addMs = qMax<qint64>(1, timer.restart());
+            
+            for (int i = 0; i < rows; ++i) {
+                const int id = 1 + int(qint64(i) * 31 % rows);
+                conn.transaction();
+                select.addBindValue(id);
+                select.exec();
+                const int quantity = select.next() ? select.value(0).toInt() : 0;
+                select.finish();
+                update.addBindValue(quantity - 1);
+                update.addBindValue(id);
+                update.exec();
+                log.addBindValue(id);
+                log.addBindValue(-1);
+                log.exec();
+                conn.commit();
+            }
+            const qint64 adjustMs = qMax<qint64>(1, timer.restart());
+            
+            QSqlQuery search(conn);
+            search.setForwardOnly(true);
+            QVERIFY(search.prepare("SELECT * FROM componentes WHERE name LIKE :text "
+                                   "OR type LIKE :text OR location LIKE :text ORDER BY name"));
+            for (int i = 0; i < 200; ++i) {
+                search.bindValue(":text", "%nente 12%");
+                search.exec();
+                while (search.next()) {
+                }
+            }
+            const double searchMs = timer.restart() / 200.0;
+            
+            for (int i = 0; i < importRows; ++i) {
+                if (i % importBatch == 0) {
+                    conn.transaction();
+                }
+                insert.addBindValue(QString("Importado %1").arg(qint64(i) * 7919 % importRows));
+                insert.exec();
+                log.addBindValue(rows + i + 1);
+                log.addBindValue(1);
+                log.exec();
+                if (i % importBatch == importBatch - 1 || i == importRows - 1) {
+                    conn.commit();
+                }
+            }
+            const qint64 importMs = timer.elapsed();
+            
+            qDebug().noquote() << QString("%1: alta %2/s, ajuste %3/s, búsqueda %4 ms, "
+                                          "importar %5 filas %6 ms")
+                                  .arg(QLatin1String(profile.first), -8).arg(rows * 1000 / addMs)
+                                  .arg(rows * 1000 / adjustMs).arg(searchMs, 0, 'f', 2)
+                                  .arg(importRows).arg(importMs);
+        }
+        QSqlDatabase::removeDatabase(name);
+    }
+}
+
+void TestDatabaseManager::benchmarkPagination() {
+    // Recorrer todo el inventario: cargarlo entero, por páginas con clave (name, id),
+    // por páginas con OFFSET (lo que sustituye el token) y con el visitante
+    BENCHMARK_ONLY();
+    const int rows = benchmarkRows(200000);
+    const int pageSize = 500;
+    QVERIFY(db->beginTransaction());
+    for (int i = 0; i < rows; ++i) {
+        addTo(QString(), QString("Lote %1").arg(qint64(i) * 7919 % rows, 7, 10, QChar('0')), 10);
+    }
+    QVERIFY(db->commitTransaction());
+    
+    QElapsedTimer timer;
+    timer.start();
+    const int total = db->getAllComponents().size();
+    const qint64 allMs = timer.restart();
+    
+    int paged = 0;
+    int largestPage = 0;
+    QString token;
+    do {
+        const ComponentPage page = db->getComponentsPage(ComponentQuery(), token, pageSize);
+        paged += page.components.size();
+        largestPage = qMax(largestPage, page.components.size());
+        token = page.nextToken;
+    } while (!token.isEmpty());
+    const qint64 keysetMs = timer.restart();
+    QCOMPARE(paged, total);
+    QCOMPARE(largestPage, pageSize);
+    
+    QSqlQuery offsetQuery(DatabaseManager::connectionForThread(db->getDatabasePath()));
+    offsetQuery.setForwardOnly(true);
+    QVERIFY(offsetQuery.prepare("SELECT * FROM componentes ORDER BY name, id LIMIT :limit OFFSET :offset"));
+    int offsetRows = 0;
+    for (int offset = 0; offset < total; offset += pageSize) {
+        offsetQuery.bindValue(":limit", pageSize);
+        offsetQuery.bindValue(":offset", offset);
+        QVERIFY(offsetQuery.exec());
+        while (offsetQuery.next()) {
+            DatabaseManager::queryToComponent(offsetQuery);
+            ++offsetRows;
+        }
+    }
+    const qint64 offsetMs = timer.restart();
+    QCOMPARE(offsetRows, total);
+    
+    int visited = 0;
+    QVERIFY(db->visitComponents(ComponentQuery(), [&visited](const Component&) {
+        ++visited;
+        return true;
+    }));
+    const qint64 visitMs = timer.restart();
+    QCOMPARE(visited, total);
+    
+    // Las primeras páginas de una búsqueda amplia no dependen del tamaño total
+    ComponentQuery broad;
+    broad.searchText = "a";
+    for (int i = 0; i < 100; ++i) {
+        db->getComponentsPage(broad, QString(), 50);
+    }
+    const double firstPageMs = timer.restart() / 100.0;
+    
+    qDebug().noquote() << QString("%1 filas: completo %2 ms (%1 en memoria), páginas de %3 "
+                                  "por clave %4 ms, por OFFSET %5 ms, visitante %6 ms, "
+                                  "primera página de búsqueda amplia %7 ms")
+                          .arg(total).arg(allMs).arg(pageSize).arg(keysetMs).arg(offsetMs)
+                          .arg(visitMs).arg(firstPageMs, 0, 'f', 2);
+}
+
+void TestDatabaseManager::benchmarkLotQueries() {
+    // Consultas de lotes sobre millones de filas: "comprado en el tercer trimestre",
+    // sus totales, los más antiguos con existencias y un retiro FIFO
+    BENCHMARK_ONLY();
+    const int rows = benchmarkRows(2000000);
+    const int components = 5000;
+    const qint64 firstDay = QDate(2021, 1, 1).toJulianDay();
+    {
+        QSqlDatabase conn = DatabaseManager::connectionForThread(db->getDatabasePath());
+        QSqlQuery insert(conn);
+        QVERIFY(insert.prepare("INSERT INTO lotes (component_id, received, remaining, purchase_day, "
+                               "unit_cost) VALUES (?, 10, ?, ?, 0.25)"));
+        QVERIFY(conn.transaction());
+        for (int i = 0; i < rows; ++i) {
+            insert.addBindValue(1000000 + i % components);
+            insert.addBindValue(i % 11);
+            insert.addBindValue(firstDay + qint64(i) * 7919 % 1461);   // Cuatro años
+            QVERIFY(insert.exec());
+        }
+        QVERIFY(conn.commit());
+    }
+    
+    // Un componente real con muchos lotes abiertos para el retiro FIFO
+    const int id = addTo(QString(), "FIFO masivo", 0).getId();
+    QVERIFY(db->beginTransaction());
+    for (int i = 0; i < 1000; ++i) {
+        QVERIFY(db->updateQuantity(id, 5, QString(), nullptr, QDate(2022, 1, 1).addDays(i), 1.0));
+    }
+    QVERIFY(db->commitTransaction());
+    
+    const QDate from(2023, 7, 1);
+    const QDate to(2023, 9, 30);
+    const int runs = 100;
+    QElapsedTimer timer;
+    timer.start();
+    int found = 0;
+    for (int i = 0; i < runs; ++i) {
+        found = db->getLotsPurchasedBetween(from, to).size();
+    }
+    const double rangeMs = timer.restart() / double(runs);
+    LotTotals totals;
+    for (int i = 0; i < 10; ++i) {
+        totals = db->getPurchaseTotals(from, to);
+    }
+    const double totalsMs = timer.restart() / 10.0;
+    for (int i = 0; i < runs; ++i) {
+        db->getOldestLots(100);
+    }
+    const double oldestMs = timer.restart() / double(runs);
+    for (int i = 0; i < runs; ++i) {
+        QVERIFY(db->updateQuantity(id, -7));
+    }
+    const double fifoMs = timer.restart() / double(runs);
+    
+    QVERIFY(found > 0);
+    qDebug().noquote() << QString("%1 lotes: rango trimestral (hasta 1000 filas) %2 ms, totales del "
+                                  "trimestre (%3 lotes) %4 ms, 100 más antiguos %5 ms, "
+                                  "retiro FIFO %6 ms")
+                          .arg(rows).arg(rangeMs, 0, 'f', 3).arg(totals.lots)
+                          .arg(totalsMs, 0, 'f', 2).arg(oldestMs, 0, 'f', 3)
+                          .arg(fifoMs, 0, 'f', 3);
+}
+
+QTEST_GUILESS_MAIN(TestDatabaseManager)
+#include "tst_databasemanager.moc"
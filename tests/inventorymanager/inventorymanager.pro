@@ -0,0 +1,38 @@
+TARGET = tst_inventorymanager
+include(../tests.pri)
+
+QT += concurrent network
+
+SOURCES += \
+    tst_inventorymanager.cpp \
+    $$SRC_DIR/changefeed.cpp \
+    $$SRC_DIR/commandjournal.cpp \
+    $$SRC_DIR/component.cpp \
+    $$SRC_DIR/componentsnapshot.cpp \
+    $$SRC_DIR/databasemanager.cpp \
+    $$SRC_DIR/httpservice.cpp \
+    $$SRC_DIR/inventory_manager.cpp \
+    $$SRC_DIR/lowstockaggregator.cpp \
+    $$SRC_DIR/maintenancescheduler.cpp \
+    $$SRC_DIR/reorderforecaster.cpp \
+    $$SRC_DIR/reservationmanager.cpp \
+    $$SRC_DIR/tracerecorder.cpp \
+    $$SRC_DIR/tracereplayer.cpp \
+    $$SRC_DIR/trigramindex.cpp
+
+HEADERS += \
+    ../benchmark.h \
+    $$SRC_DIR/changefeed.h \
+    $$SRC_DIR/commandjournal.h \
+    $$SRC_DIR/component.h \
+    $$SRC_DIR/componentsnapshot.h \
+    $$SRC_DIR/databasemanager.h \
+    $$SRC_DIR/httpservice.h \
+    $$SRC_DIR/inventory_manager.h \
+    $$SRC_DIR/lowstockaggregator.h \
+    $$SRC_DIR/maintenancescheduler.h \
+    $$SRC_DIR/reorderforecaster.h \
+    $$SRC_DIR/reservationmanager.h \
+    $$SRC_DIR/tracerecorder.h \
+    $$SRC_DIR/tracereplayer.h \
+    $$SRC_DIR/trigramindex.h
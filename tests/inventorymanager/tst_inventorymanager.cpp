@@ -0,0 +1,406 @@
+#include <QtTest>
+#include <QElapsedTimer>
+#include <QSignalSpy>
+#include <QTemporaryDir>
+#include "inventory_manager.h"
+#include "tracereplayer.h"
+#include "../benchmark.h"
+
+class TestInventoryManager : public QObject {
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void adjustCommandStoresNoComponents();
+    void undoRedoAdd();
+    void undoRedoAdjust();
+    void redoCrossingLowStockAlerted();
+    void undoUpdateKeepsLaterConsumption();
+    void undoBlockedByReservation();
+    void undoRedoBatch();
+    void adjustErrorReturnedToCaller();
+    void undoRedoAdjustKeepsLots();
+    void undoRemoveRestoresLots();
+    void undoBlockedByChangedLot();
+    void traceHeaderHasFullState();
+    void undoRedoReplayOnOnePartition();
+    void benchmarkBulkUndo();
+
+private:
+    int addComponent(const QString& name, int quantity);
+    int quantityOf(int id);
+    
+    QTemporaryDir dir;
+    InventoryManager* inventory = nullptr;
+};
+
+void TestInventoryManager::initTestCase() {
+    QVERIFY(dir.isValid());
+    DatabaseManager::setDataDirectory(dir.path());
+    inventory = new InventoryManager();
+    QVERIFY(inventory->initialize());
+}
+
+void TestInventoryManager::cleanupTestCase() {
+    delete inventory;
+    inventory = nullptr;
+}
+
+int TestInventoryManager::addComponent(const QString& name, int quantity) {
+    int id = -1;
+    inventory->addComponent(name, "Resistencia", quantity, "Cajón A1", QDate(2024, 3, 1),
+                            QString(), &id);
+    return id;
+}
+
+int TestInventoryManager::quantityOf(int id) {
+    return DatabaseManager::getInstance()->getComponentById(id).getQuantity();
+}
+
+void TestInventoryManager::adjustCommandStoresNoComponents() {
+    const InventoryCommand adjust = InventoryCommand::adjusted(7, -3);
+    QVERIFY(!adjust.change);
+    QCOMPARE(adjust.before().getId(), -1);
+    
+    Component before(7, "LED", "LED", 10, "A1", QDate(2024, 1, 1));
+    Component after = before;
+    after.setQuantity(4);
+    const InventoryCommand update = InventoryCommand::updated(before, after);
+    QCOMPARE(update.delta, -6);
+    QCOMPARE(update.after().getQuantity(), 4);
+}
+
+void TestInventoryManager::undoRedoAdd() {
+    const int id = addComponent("Resistencia 220", 8);
+    QVERIFY(id > 0);
+    
+    QVERIFY(inventory->undo());
+    QCOMPARE(DatabaseManager::getInstance()->getComponentById(id).getId(), -1);
+    QCOMPARE(inventory->getAvailableQuantity(id), 0);
+    
+    // Rehacer restaura el mismo ID
+    QVERIFY(inventory->redo());
+    QCOMPARE(quantityOf(id), 8);
+    QCOMPARE(inventory->getAvailableQuantity(id), 8);
+}
+
+void TestInventoryManager::undoRedoAdjust() {
+    const int id = addComponent("Resistencia 1k", 10);
+    QVERIFY(inventory->adjustQuantity(id, -3, "Prueba"));
+    QCOMPARE(quantityOf(id), 7);
+    
+    QVERIFY(inventory->undo());
+    QCOMPARE(quantityOf(id), 10);
+    QCOMPARE(inventory->getAvailableQuantity(id), 10);
+    QVERIFY(inventory->redo());
+    QCOMPARE(quantityOf(id), 7);
+    QCOMPARE(inventory->getAvailableQuantity(id), 7);
+}
+
+void TestInventoryManager::redoCrossingLowStockAlerted() {
+    const int id = addComponent("Potenciómetro 10k", 20);
+    QSignalSpy alerts(inventory, &InventoryManager::lowStockAlert);
+    auto alerted = [&alerts, id]() {
+        // Los resúmenes salen cada pocos segundos; esperar uno que incluya el componente
+        QElapsedTimer timer;
+        timer.start();
+        while (timer.elapsed() < 15000) {
+            for (const QList<QVariant>& alert : qAsConst(alerts)) {
+                for (const Component& component : alert.first().value<QVector<Component>>()) {
+                    if (component.getId() == id) {
+                        alerts.clear();
+                        return true;
+                    }
+                }
+            }
+            alerts.clear();
+            alerts.wait(1000);
+        }
+        return false;
+    };
+    
+    QVERIFY(inventory->adjustQuantity(id, -17, "Prueba"));
+    QVERIFY(alerted());
+    
+    // Deshacer y rehacer cruzan el umbral otra vez: el aviso vuelve a salir
+    QVERIFY(inventory->undo());
+    QVERIFY(inventory->redo());
+    QCOMPARE(quantityOf(id), 3);
+    QVERIFY(alerted());
+}
+
+void TestInventoryManager::undoUpdateKeepsLaterConsumption() {
+    const int id = addComponent("Resistencia 10k", 10);
+    Component edited = DatabaseManager::getInstance()->getComponentById(id);
+    edited.setName("Resistencia 10k 1%");
+    edited.setQuantity(7);
+    QVERIFY(inventory->updateComponent(edited));
+    
+    // Consumo fuera del diario (reserva confirmada) tras la edición
+    const qint64 reservation = inventory->reserveComponent(id, 2, "Proyecto");
+    QVERIFY(reservation > 0);
+    QVERIFY(inventory->commitReservation(reservation));
+    
+    // Deshacer devuelve los 3 retirados al editar sin borrar los 2 consumidos
+    QVERIFY(inventory->undo());
+    const Component restored = DatabaseManager::getInstance()->getComponentById(id);
+    QCOMPARE(restored.getName(), QString("Resistencia 10k"));
+    QCOMPARE(restored.getQuantity(), 8);
+    QCOMPARE(inventory->getAvailableQuantity(id), 8);
+    
+    QVERIFY(inventory->redo());
+    QCOMPARE(quantityOf(id), 5);
+    QCOMPARE(inventory->getAvailableQuantity(id), 5);
+}
+
+void TestInventoryManager::undoBlockedByReservation() {
+    const int id = addComponent("Resistencia 47k", 10);
+    Component edited = DatabaseManager::getInstance()->getComponentById(id);
+    edited.setQuantity(12);
+    QVERIFY(inventory->updateComponent(edited));
+    QVERIFY(inventory->reserveComponent(id, 11, "Proyecto") > 0);
+    
+    // Deshacer quitaría 2 unidades de las que 11 están reservadas
+    QVERIFY(!inventory->undo());
+    QCOMPARE(quantityOf(id), 12);
+    QCOMPARE(inventory->getAvailableQuantity(id), 1);
+    QVERIFY(inventory->canUndo());
+}
+
+void TestInventoryManager::undoRedoBatch() {
+    QVector<int> ids;
+    for (int i = 0; i < 5; ++i) {
+        ids.append(addComponent(QString("Capacitor %1").arg(i), 20));
+    }
+    
+    inventory->beginBatch("Retiro en lote");
+    for (int id : qAsConst(ids)) {
+        QVERIFY(inventory->adjustQuantity(id, -4));
+    }
+    inventory->endBatch();
+    QCOMPARE(inventory->undoText(), QString("Retiro en lote"));
+    
+    QVERIFY(inventory->undo());
+    for (int id : qAsConst(ids)) {
+        QCOMPARE(quantityOf(id), 20);
+    }
+    QVERIFY(inventory->redo());
+    for (int id : qAsConst(ids)) {
+        QCOMPARE(quantityOf(id), 16);
+        QCOMPARE(inventory->getAvailableQuantity(id), 16);
+    }
+}
+
+void TestInventoryManager::adjustErrorReturnedToCaller() {
+    const int id = addComponent("Potenciómetro", 2);
+    QSignalSpy errors(inventory, &InventoryManager::error);
+    
+    // Como lo llama el servicio HTTP: el error vuelve al llamante, sin señal
+    QString message;
+    QVERIFY(!inventory->adjustQuantity(id, -5, "HTTP", QString(), &message));
+    QVERIFY(!message.isEmpty());
+    QVERIFY(!inventory->adjustQuantity(id, -1, "HTTP", "desconocida", &message));
+    QVERIFY(message.contains("desconocida"));
+    QCOMPARE(errors.count(), 0);
+    QCOMPARE(quantityOf(id), 2);
+    QCOMPARE(inventory->getAvailableQuantity(id), 2);
+    
+    // Sin destino, se sigue emitiendo error()
+    QVERIFY(!inventory->adjustQuantity(id, -5));
+    QCOMPARE(errors.count(), 1);
+}
+
+void TestInventoryManager::undoRedoAdjustKeepsLots() {
+    const int id = addComponent("Regulador", 0);
+    QVERIFY(inventory->receiveLot(id, 5, QDate(2024, 1, 10), 1.0));
+    QVERIFY(inventory->receiveLot(id, 5, QDate(2024, 2, 10), 2.0));
+    const QVector<Lot> received = inventory->getLots(id);
+    QCOMPARE(received.size(), 2);
+    
+    QVERIFY(inventory->adjustQuantity(id, -7));
+    QCOMPARE(inventory->getLots(id).size(), 1);
+    QCOMPARE(inventory->getLots(id)[0].remaining, 3);
+    
+    // Deshacer devuelve las unidades a los lotes de los que salieron, sin lote nuevo
+    QVERIFY(inventory->undo());
+    QVector<Lot> lots = inventory->getLots(id, false);
+    QCOMPARE(lots.size(), 2);
+    for (int i = 0; i < lots.size(); ++i) {
+        QCOMPARE(lots[i].id, received[i].id);
+        QCOMPARE(lots[i].remaining, 5);
+    }
+    QVERIFY(inventory->redo());
+    QCOMPARE(inventory->getLots(id, false)[0].remaining, 0);
+    QCOMPARE(inventory->getLots(id, false)[1].remaining, 3);
+    
+    // Deshacer una recepción elimina su lote; rehacerla lo recrea con el mismo ID, fecha y coste
+    QVERIFY(inventory->undo());
+    QVERIFY(inventory->undo());
+    QCOMPARE(inventory->getLots(id, false).size(), 1);
+    QCOMPARE(quantityOf(id), 5);
+    QVERIFY(inventory->redo());
+    lots = inventory->getLots(id, false);
+    QCOMPARE(lots.size(), 2);
+    QCOMPARE(lots[1].id, received[1].id);
+    QCOMPARE(lots[1].purchaseDate, QDate(2024, 2, 10));
+    QCOMPARE(lots[1].unitCost, 2.0);
+    QCOMPARE(quantityOf(id), 10);
+}
+
+void TestInventoryManager::undoRemoveRestoresLots() {
+    const int id = addComponent("Optoacoplador", 4);
+    QVERIFY(inventory->receiveLot(id, 6, QDate(2024, 4, 1), 0.3));
+    QVERIFY(inventory->adjustQuantity(id, -5));
+    const QVector<Lot> before = inventory->getLots(id, false);
+    QCOMPARE(before.size(), 2);
+    
+    QVERIFY(inventory->removeComponent(id));
+    QVERIFY(inventory->getLots(id, false).isEmpty());
+    QVERIFY(inventory->undo());
+    
+    const QVector<Lot> after = inventory->getLots(id, false);
+    QCOMPARE(after.size(), before.size());
+    for (int i = 0; i < after.size(); ++i) {
+        QCOMPARE(after[i].id, before[i].id);
+        QCOMPARE(after[i].received, before[i].received);
+        QCOMPARE(after[i].remaining, before[i].remaining);
+        QCOMPARE(after[i].purchaseDate, before[i].purchaseDate);
+        QCOMPARE(after[i].unitCost, before[i].unitCost);
+    }
+    
+    // El ajuste anterior a la baja se sigue deshaciendo sobre los mismos lotes
+    QVERIFY(inventory->undo());
+    QCOMPARE(quantityOf(id), 10);
+    QCOMPARE(inventory->getLots(id)[0].remaining, 4);
+    QCOMPARE(inventory->getLots(id)[1].remaining, 6);
+}
+
+void TestInventoryManager::undoBlockedByChangedLot() {
+    const int id = addComponent("Cristal 16 MHz", 10);
+    QVERIFY(inventory->receiveLot(id, 8, QDate(2023, 1, 1), 0.5));   // El lote más antiguo
+    
+    // Una reserva consumida fuera del diario sale de ese lote: deshacer la
+    // recepción ya no puede eliminarlo entero y no se aplica a medias
+    const qint64 reservation = inventory->reserveComponent(id, 3, "Reloj");
+    QVERIFY(reservation > 0);
+    QVERIFY(inventory->commitReservation(reservation));
+    QVERIFY(inventory->getReservationManager()->flush());
+    QCOMPARE(inventory->getLots(id)[0].remaining, 5);
+    
+    QVERIFY(!inventory->undo());
+    QVERIFY(inventory->canUndo());
+    QCOMPARE(quantityOf(id), 15);
+    QCOMPARE(inventory->getLots(id)[0].remaining, 5);
+    QCOMPARE(inventory->getAvailableQuantity(id), 15);
+}
+
+void TestInventoryManager::traceHeaderHasFullState() {
+    DatabaseManager* db = DatabaseManager::getInstance();
+    QVERIFY(db->addSite("almacen"));
+    int remoteId = -1;
+    QVERIFY(inventory->addComponent("Relé", "Relé", 6, "R1", QDate(2024, 5, 2), "almacen", &remoteId));
+    const int id = addComponent("Transistor", 30);
+    QVERIFY(inventory->receiveLot(id, 10, QDate(2024, 6, 1), 0.15));
+    QVERIFY(inventory->adjustQuantity(id, -4));
+    const qint64 reservation = inventory->reserveComponent(id, 5, "Brazo robótico");
+    QVERIFY(reservation > 0);
+    
+    // La cabecera recoge lo que aún no se había volcado a disco
+    const QString path = dir.filePath("estado.trace");
+    QVERIFY(inventory->startTraceRecording(path));
+    QVERIFY(inventory->adjustQuantity(id, -1));
+    inventory->stopTraceRecording();
+    
+    TraceSnapshot state;
+    QVector<TraceEvent> events;
+    QString error;
+    QVERIFY2(TraceRecorder::read(path, &state, &events, &error), qPrintable(error));
+    QVERIFY(state.sites.contains("almacen"));
+    QVERIFY(!state.sites.contains(DatabaseManager::kMainSite));
+    
+    bool remoteFound = false;
+    for (const Component& component : qAsConst(state.components)) {
+        remoteFound = remoteFound || (component.getId() == remoteId &&
+                                      component.getSite() == "almacen");
+    }
+    QVERIFY(remoteFound);
+    
+    bool reservationFound = false;
+    for (const Reservation& stored : qAsConst(state.reservations)) {
+        reservationFound = reservationFound || (stored.id == reservation && stored.quantity == 5);
+    }
+    QVERIFY(reservationFound);
+    
+    int remaining = 0;
+    for (const Lot& lot : qAsConst(state.lots)) {
+        remaining += lot.componentId == id ? lot.remaining : 0;
+    }
+    QCOMPARE(remaining, 36);
+    QVERIFY(state.consumption.contains(id));
+    
+    QCOMPARE(events.size(), 1);
+    QCOMPARE(events[0].op, TraceOp::Adjust);
+    QCOMPARE(events[0].id, id);
+}
+
+void TestInventoryManager::undoRedoReplayOnOnePartition() {
+    // Deshacer/rehacer siguen el historial global: con varios hilos no se reparten
+    QVector<TraceEvent> events;
+    for (int i = 0; i < 12; ++i) {
+        TraceEvent event;
+        event.op = i % 3 == 0 ? TraceOp::Adjust : (i % 3 == 1 ? TraceOp::Undo : TraceOp::Redo);
+        event.id = event.op == TraceOp::Adjust ? i : -1;
+        events.append(event);
+    }
+    
+    const QVector<QVector<int>> partitions = TraceReplayer::partitionEvents(events, 4);
+    QCOMPARE(partitions.size(), 4);
+    QVector<int> history;
+    for (int i : partitions[0]) {
+        if (events[i].op != TraceOp::Adjust) {
+            history.append(i);
+        }
+    }
+    QCOMPARE(history, QVector<int>({1, 2, 4, 5, 7, 8, 10, 11}));
+    for (int t = 1; t < partitions.size(); ++t) {
+        for (int i : partitions[t]) {
+            QCOMPARE(events[i].op, TraceOp::Adjust);
+            QCOMPARE(events[i].id % 4, t);
+        }
+    }
+}
+
+void TestInventoryManager::benchmarkBulkUndo() {
+    // Deshacer/rehacer un ajuste masivo: sentencias preparadas una vez, una transacción
+    BENCHMARK_ONLY();
+    const int rows = benchmarkRows(10000);
+    QVector<int> ids;
+    ids.reserve(rows);
+    inventory->beginBatch("Importación");
+    for (int i = 0; i < rows; ++i) {
+        ids.append(addComponent(QString("Componente %1").arg(i, 7, 10, QChar('0')), 100));
+    }
+    inventory->endBatch();
+    
+    inventory->beginBatch("Ajuste masivo");
+    for (int id : qAsConst(ids)) {
+        inventory->adjustQuantity(id, -1);
+    }
+    inventory->endBatch();
+    
+    QElapsedTimer timer;
+    timer.start();
+    QVERIFY(inventory->undo());
+    const qint64 undoMs = timer.restart();
+    QVERIFY(inventory->redo());
+    qDebug() << rows << "ajustes: deshacer" << undoMs << "ms, rehacer" << timer.elapsed() << "ms";
+    
+    QBENCHMARK {
+        inventory->undo();
+        inventory->redo();
+    }
+}
+
+QTEST_GUILESS_MAIN(TestInventoryManager)
+#include "tst_inventorymanager.moc"
@@ -0,0 +1,15 @@
+TARGET = tst_lowstockaggregator
+include(../tests.pri)
+
+QT += concurrent
+
+SOURCES += \
+    tst_lowstockaggregator.cpp \
+    $$SRC_DIR/component.cpp \
+    $$SRC_DIR/databasemanager.cpp \
+    $$SRC_DIR/lowstockaggregator.cpp
+
+HEADERS += \
+    $$SRC_DIR/component.h \
+    $$SRC_DIR/databasemanager.h \
+    $$SRC_DIR/lowstockaggregator.h
@@ -0,0 +1,109 @@
+#include <QtTest>
+#include <QSignalSpy>
+#include <QTemporaryDir>
+#include "databasemanager.h"
+#include "lowstockaggregator.h"
+
+class TestLowStockAggregator : public QObject {
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void startupSummaryCoversAllSites();
+    void siteCrossingReported();
+    void restockedBeforeSummaryDropped();
+
+private:
+    int addTo(const QString& site, const QString& name, int quantity);
+    void startAggregator(LowStockAggregator& aggregator, QSignalSpy& summaries);
+    
+    QTemporaryDir dir;
+    DatabaseManager* db = nullptr;
+};
+
+void TestLowStockAggregator::initTestCase() {
+    QVERIFY(dir.isValid());
+    qRegisterMetaType<QVector<Component>>();
+    DatabaseManager::setDataDirectory(dir.path());
+    db = DatabaseManager::getInstance();
+    QVERIFY(db->initialize());
+    QVERIFY(db->addSite("norte"));
+}
+
+int TestLowStockAggregator::addTo(const QString& site, const QString& name, int quantity) {
+    Component component(-1, name, "Sensor", quantity, "Cajón C3", QDate(2024, 5, 1));
+    component.setSite(site);
+    int newId = -1;
+    db->addComponent(component, &newId);
+    return newId;
+}
+
+void TestLowStockAggregator::startAggregator(LowStockAggregator& aggregator,
+                                             QSignalSpy& summaries) {
+    // Sin hilo propio: el timer queda en el de la prueba y spy.wait() lo hace avanzar
+    aggregator.setInterval(50);
+    for (const QString& site : db->getSites()) {
+        aggregator.addSite(site, db->getSitePath(site));
+    }
+    aggregator.start();
+    QVERIFY(summaries.wait(2000));   // Resumen inicial
+}
+
+void TestLowStockAggregator::startupSummaryCoversAllSites() {
+    const int mainId = addTo(QString(), "DHT11", 2);
+    const int northId = addTo("norte", "DHT22", 1);
+    addTo("norte", "BMP280", 40);
+    
+    LowStockAggregator aggregator;
+    QSignalSpy summaries(&aggregator, &LowStockAggregator::summaryReady);
+    startAggregator(aggregator, summaries);
+    
+    const QVector<Component> components = summaries.first().first().value<QVector<Component>>();
+    QHash<int, QString> sites;
+    for (const Component& component : components) {
+        sites.insert(component.getId(), component.getSite());
+    }
+    QCOMPARE(sites.value(mainId), DatabaseManager::kMainSite);
+    QCOMPARE(sites.value(northId), QString("norte"));
+    QCOMPARE(components.size(), 2);
+    QVERIFY(components.first().getQuantity() <= components.last().getQuantity());
+}
+
+void TestLowStockAggregator::siteCrossingReported() {
+    const int id = addTo("norte", "MQ-2", 12);
+    
+    LowStockAggregator aggregator;
+    QSignalSpy summaries(&aggregator, &LowStockAggregator::summaryReady);
+    startAggregator(aggregator, summaries);
+    summaries.clear();
+    
+    int newQuantity = 0;
+    QVERIFY(db->updateQuantity(id, -9, "norte", &newQuantity));
+    QVERIFY(aggregator.isRelevant(12, newQuantity));
+    aggregator.quantityChanged(id, 12, newQuantity, "norte", db->getSitePath("norte"));
+    QVERIFY(summaries.wait(2000));
+    
+    const QVector<Component> components = summaries.first().first().value<QVector<Component>>();
+    QCOMPARE(components.size(), 1);
+    QCOMPARE(components.first().getId(), id);
+    QCOMPARE(components.first().getSite(), QString("norte"));
+    QCOMPARE(components.first().getQuantity(), 3);
+}
+
+void TestLowStockAggregator::restockedBeforeSummaryDropped() {
+    const int id = addTo(QString(), "HC-SR04", 9);
+    
+    LowStockAggregator aggregator;
+    QSignalSpy summaries(&aggregator, &LowStockAggregator::summaryReady);
+    startAggregator(aggregator, summaries);
+    summaries.clear();
+    
+    // Cruza el umbral y se repone antes de que venza el intervalo: no hay aviso
+    const QString path = db->getSitePath(QString());
+    aggregator.quantityChanged(id, 9, 3, DatabaseManager::kMainSite, path);
+    aggregator.quantityChanged(id, 3, 9, DatabaseManager::kMainSite, path);
+    QVERIFY(!summaries.wait(300));
+}
+
+QTEST_GUILESS_MAIN(TestLowStockAggregator)
+#include "tst_lowstockaggregator.moc"
@@ -0,0 +1,15 @@
+TARGET = tst_reorderforecaster
+include(../tests.pri)
+
+QT += concurrent
+
+SOURCES += \
+    tst_reorderforecaster.cpp \
+    $$SRC_DIR/component.cpp \
+    $$SRC_DIR/databasemanager.cpp \
+    $$SRC_DIR/reorderforecaster.cpp
+
+HEADERS += \
+    $$SRC_DIR/component.h \
+    $$SRC_DIR/databasemanager.h \
+    $$SRC_DIR/reorderforecaster.h
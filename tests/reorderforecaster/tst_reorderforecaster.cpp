@@ -0,0 +1,152 @@
+#include <QtTest>
+#include <QTemporaryDir>
+#include "reorderforecaster.h"
+
+namespace {
+const qint64 kDayMs = 86400000;
+const qint64 kStartMs = 1704067200000;   // 2024-01-01T00:00:00Z
+}
+
+class TestReorderForecaster : public QObject {
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void youngSeriesIsCorrected();
+    void matureSeriesConverges();
+    void rateDecaysWithoutConsumption();
+    void singleWithdrawalIsBounded();
+    void revertUndoesConsumption();
+    void forecastSuggestsOrder();
+    void forecastAllReturnsUrgentOnly();
+    void stateSurvivesReload();
+
+private:
+    /// 'units' al día durante 'days' días, empezando en kStartMs
+    static void consumeDaily(ReorderForecaster& forecaster, int id, int units, int days);
+    
+    QTemporaryDir dir;
+    DatabaseManager* db = nullptr;
+};
+
+void TestReorderForecaster::initTestCase() {
+    QVERIFY(dir.isValid());
+    DatabaseManager::setDataDirectory(dir.path());
+    db = DatabaseManager::getInstance();
+    QVERIFY(db->initialize());
+}
+
+void TestReorderForecaster::consumeDaily(ReorderForecaster& forecaster, int id, int units, int days) {
+    for (int day = 0; day < days; ++day) {
+        forecaster.recordConsumption(id, units, kStartMs + day * kDayMs);
+    }
+}
+
+void TestReorderForecaster::youngSeriesIsCorrected() {
+    // Cinco días a 10/día con tau = 30: sin corrección saldría ~1.5/día
+    ReorderForecaster forecaster(db);
+    consumeDaily(forecaster, 1, 10, 5);
+    const double rate = forecaster.dailyRate(1, kStartMs + 5 * kDayMs);
+    QVERIFY2(qAbs(rate - 10.0) < 1.0, qPrintable(QString::number(rate)));
+}
+
+void TestReorderForecaster::matureSeriesConverges() {
+    ReorderForecaster forecaster(db);
+    consumeDaily(forecaster, 2, 10, 200);
+    const double rate = forecaster.dailyRate(2, kStartMs + 200 * kDayMs);
+    QVERIFY2(qAbs(rate - 10.0) < 0.5, qPrintable(QString::number(rate)));
+}
+
+void TestReorderForecaster::rateDecaysWithoutConsumption() {
+    ReorderForecaster forecaster(db);
+    consumeDaily(forecaster, 3, 10, 200);
+    const double steady = forecaster.dailyRate(3, kStartMs + 200 * kDayMs);
+    // Un tau (30 días) sin retiros: el ritmo cae a ~1/e
+    const double later = forecaster.dailyRate(3, kStartMs + 230 * kDayMs);
+    QVERIFY(later < steady);
+    QVERIFY2(qAbs(later / steady - std::exp(-1.0)) < 0.05, qPrintable(QString::number(later)));
+}
+
+void TestReorderForecaster::singleWithdrawalIsBounded() {
+    // Un único retiro recién hecho cuenta como el consumo de un día
+    ReorderForecaster forecaster(db);
+    forecaster.recordConsumption(4, 12, kStartMs);
+    const double rate = forecaster.dailyRate(4, kStartMs);
+    QVERIFY(rate > 0.0);
+    QVERIFY2(rate <= 12.5, qPrintable(QString::number(rate)));
+}
+
+void TestReorderForecaster::revertUndoesConsumption() {
+    ReorderForecaster forecaster(db);
+    consumeDaily(forecaster, 5, 10, 60);
+    const qint64 now = kStartMs + 60 * kDayMs;
+    const double before = forecaster.dailyRate(5, now);
+    forecaster.recordConsumption(5, 500, now);
+    QVERIFY(forecaster.dailyRate(5, now) > before);
+    forecaster.revertConsumption(5, 500, now);
+    QVERIFY(qAbs(forecaster.dailyRate(5, now) - before) < 1e-6);
+    
+    forecaster.forgetComponent(5);
+    QCOMPARE(forecaster.dailyRate(5, now), 0.0);
+}
+
+void TestReorderForecaster::forecastSuggestsOrder() {
+    ReorderForecaster forecaster(db);
+    forecaster.setLeadTimeDays(7);
+    forecaster.setCoverageDays(30);
+    consumeDaily(forecaster, 6, 10, 400);
+    const qint64 now = kStartMs + 400 * kDayMs;
+    
+    const ReorderForecast forecast = forecaster.forecast(
+        Component(6, "Fusible 1A", "Fusible", 50, "Cajón C3", QDate(2024, 1, 1)), now);
+    QCOMPARE(forecast.componentId, 6);
+    QVERIFY(qAbs(forecast.daysUntilStockout - 5.0) < 0.3);
+    // ~10/día durante plazo + cobertura (37 días) menos lo que hay
+    QVERIFY(qAbs(forecast.suggestedOrder - 320) <= 12);
+    
+    // Sin consumo registrado no hay pronóstico
+    const ReorderForecast idle = forecaster.forecast(
+        Component(99, "Sin uso", "Varios", 5, "Cajón C3", QDate(2024, 1, 1)), now);
+    QCOMPARE(idle.daysUntilStockout, -1.0);
+    QCOMPARE(idle.suggestedOrder, 0);
+}
+
+void TestReorderForecaster::forecastAllReturnsUrgentOnly() {
+    ReorderForecaster forecaster(db);
+    forecaster.setLeadTimeDays(7);
+    // Ritmo actual: consumos que acaban ahora (forecastAll usa la hora real)
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    for (int day = 100; day > 0; --day) {
+        forecaster.recordConsumption(7, 10, now - day * kDayMs);
+        forecaster.recordConsumption(8, 1, now - day * kDayMs);
+    }
+    
+    QFuture<QVector<ReorderForecast>> future = forecaster.forecastAll({
+        Component(7, "Urgente", "Varios", 20, "A", QDate(2024, 1, 1)),
+        Component(8, "Holgado", "Varios", 500, "A", QDate(2024, 1, 1))});
+    future.waitForFinished();
+    const QVector<ReorderForecast> urgent = future.result();
+    QCOMPARE(urgent.size(), 1);
+    QCOMPARE(urgent.first().componentId, 7);
+}
+
+void TestReorderForecaster::stateSurvivesReload() {
+    const qint64 now = kStartMs + 10 * kDayMs;
+    double rate = 0.0;
+    {
+        ReorderForecaster forecaster(db);
+        QVERIFY(forecaster.load());
+        consumeDaily(forecaster, 9, 4, 10);
+        rate = forecaster.dailyRate(9, now);
+        QVERIFY(forecaster.flush());
+    }
+    
+    // El inicio de la serie se guarda: la corrección sigue aplicándose
+    ReorderForecaster reloaded(db);
+    QVERIFY(reloaded.load());
+    QVERIFY(qAbs(reloaded.dailyRate(9, now) - rate) < 1e-9);
+    QVERIFY(qAbs(rate - 4.0) < 0.5);
+}
+
+QTEST_GUILESS_MAIN(TestReorderForecaster)
+#include "tst_reorderforecaster.moc"
@@ -0,0 +1,15 @@
+TARGET = tst_reservationmanager
+include(../tests.pri)
+
+QT += concurrent
+
+SOURCES += \
+    tst_reservationmanager.cpp \
+    $$SRC_DIR/component.cpp \
+    $$SRC_DIR/databasemanager.cpp \
+    $$SRC_DIR/reservationmanager.cpp
+
+HEADERS += \
+    $$SRC_DIR/component.h \
+    $$SRC_DIR/databasemanager.h \
+    $$SRC_DIR/reservationmanager.h
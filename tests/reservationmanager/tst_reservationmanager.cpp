@@ -0,0 +1,196 @@
+#include <QtTest>
+#include <QTemporaryDir>
+#include <QtConcurrent>
+#include <QAtomicInt>
+#include <QSignalSpy>
+#include "databasemanager.h"
+#include "reservationmanager.h"
+
+class TestReservationManager : public QObject {
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void reserveNeverOversells();
+    void concurrentReservesNeverOversell();
+    void withdrawalCannotTakeReserved();
+    void unknownComponentHasNoCounter();
+    void commitIsPersistedAndReloaded();
+    void failingCommitStaysQueued();
+    void absoluteWriteKeepsConcurrentCommits();
+
+private:
+    int addComponent(int quantity);
+    
+    QTemporaryDir dir;
+    DatabaseManager* db = nullptr;
+};
+
+void TestReservationManager::initTestCase() {
+    QVERIFY(dir.isValid());
+    DatabaseManager::setDataDirectory(dir.path());
+    db = DatabaseManager::getInstance();
+    QVERIFY(db->initialize());
+}
+
+int TestReservationManager::addComponent(int quantity) {
+    int newId = -1;
+    db->addComponent(Component(-1, "Relé 5V", "Relé", quantity, "Cajón B2", QDate(2024, 2, 1)),
+                     &newId);
+    return newId;
+}
+
+void TestReservationManager::reserveNeverOversells() {
+    const int id = addComponent(10);
+    ReservationManager reservations(db);
+    QVERIFY(reservations.load());
+    
+    QVERIFY(reservations.reserve(id, 6, "Prototipo") >= 0);
+    QCOMPARE(reservations.reserve(id, 5, "Serie"), qint64(-1));
+    QCOMPARE(reservations.available(id), 4);
+    QCOMPARE(reservations.reserved(id), 6);
+}
+
+void TestReservationManager::concurrentReservesNeverOversell() {
+    const int id = addComponent(500);
+    ReservationManager reservations(db);
+    QVERIFY(reservations.load());
+    
+    QAtomicInt granted(0);
+    QVector<int> workers(8);
+    QtConcurrent::blockingMap(workers, [&](int&) {
+        for (int i = 0; i < 1000; ++i) {
+            if (reservations.reserve(id, 1, "Carga") >= 0) {
+                granted.fetchAndAddRelaxed(1);
+            }
+        }
+    });
+    QCOMPARE(granted.loadAcquire(), 500);
+    QCOMPARE(reservations.available(id), 0);
+}
+
+void TestReservationManager::withdrawalCannotTakeReserved() {
+    const int id = addComponent(10);
+    ReservationManager reservations(db);
+    QVERIFY(reservations.load());
+    QVERIFY(reservations.reserve(id, 6, "Prototipo") >= 0);
+    
+    // La salida se descuenta antes de escribir y no puede invadir lo reservado
+    QVERIFY(!reservations.tryAdjust(id, -5));
+    QVERIFY(reservations.tryAdjust(id, -4));
+    QCOMPARE(reservations.available(id), 0);
+    
+    // Si la escritura falla se devuelve; una entrada solo cuenta tras confirmarse
+    reservations.addQuantity(id, 4);
+    QCOMPARE(reservations.available(id), 4);
+    reservations.addQuantity(id, 3);
+    QCOMPARE(reservations.available(id), 7);
+}
+
+void TestReservationManager::unknownComponentHasNoCounter() {
+    ReservationManager reservations(db);
+    QVERIFY(reservations.load());
+    
+    const int id = addComponent(3);   // Alta posterior a load()
+    QCOMPARE(reservations.reserve(id, 1, "Prototipo"), qint64(-1));
+    QCOMPARE(reservations.available(id), 0);
+    
+    // InventoryManager crea el contador al dar de alta el componente
+    reservations.setQuantity(id, 3);
+    QVERIFY(reservations.reserve(id, 3, "Prototipo") >= 0);
+    QCOMPARE(reservations.available(id), 0);
+}
+
+void TestReservationManager::commitIsPersistedAndReloaded() {
+    const int id = addComponent(8);
+    qint64 kept = -1;
+    {
+        ReservationManager reservations(db);
+        QVERIFY(reservations.load());
+        const qint64 consumed = reservations.reserve(id, 3, "Montaje");
+        kept = reservations.reserve(id, 2, "Reparación");
+        QVERIFY(consumed >= 0 && kept >= 0);
+        
+        Reservation committed;
+        QVERIFY(reservations.commit(consumed, &committed));
+        QCOMPARE(committed.quantity, 3);
+        QVERIFY(!reservations.commit(consumed));   // No se consume dos veces
+        QVERIFY(reservations.flush());
+    }
+    QCOMPARE(db->getComponentById(id).getQuantity(), 5);
+    
+    ReservationManager reloaded(db);
+    QVERIFY(reloaded.load());
+    QCOMPARE(reloaded.reserved(id), 2);
+    QCOMPARE(reloaded.available(id), 3);
+    QVERIFY(reloaded.release(kept));
+    QCOMPARE(reloaded.available(id), 5);
+    QVERIFY(reloaded.flush());
+}
+
+void TestReservationManager::failingCommitStaysQueued() {
+    const int id = addComponent(5);
+    const int other = addComponent(5);
+    ReservationManager reservations(db);
+    QVERIFY(reservations.load());
+    QSignalSpy errors(&reservations, &ReservationManager::error);
+    
+    // El contador cree que hay más que la BD: el consumo viola CHECK(quantity >= 0)
+    reservations.setQuantity(id, 100);
+    Reservation committed;
+    QVERIFY(reservations.commit(reservations.reserve(id, 50, "Serie"), &committed));
+    QVERIFY(reservations.commit(reservations.reserve(other, 2, "Montaje")));
+    QCOMPARE(reservations.available(id), 50);
+    
+    for (int i = 0; i < 10; ++i) {
+        QVERIFY(!reservations.flush());
+    }
+    // Tras los reintentos se guarda por partes: el otro componente avanza y el
+    // consumo que falla no se descarta, sigue en cola con la reserva abierta
+    QVERIFY(errors.count() > 0);
+    QCOMPARE(db->getComponentById(other).getQuantity(), 3);
+    QCOMPARE(db->getComponentById(id).getQuantity(), 5);
+    QCOMPARE(reservations.available(id), 50);
+    bool open = false;
+    for (const Reservation& reservation : db->getReservations()) {
+        open = open || reservation.id == committed.id;
+    }
+    QVERIFY(open);
+    
+    // Con stock suficiente en la BD, el consumo en cola se guarda
+    Component component = db->getComponentById(id);
+    component.setQuantity(100);
+    QVERIFY(db->updateComponent(component));
+    QVERIFY(reservations.flush());
+    QCOMPARE(db->getComponentById(id).getQuantity(), 50);
+}
+
+void TestReservationManager::absoluteWriteKeepsConcurrentCommits() {
+    const int id = addComponent(20);
+    ReservationManager reservations(db);
+    QVERIFY(reservations.load());
+    const qint64 queued = reservations.reserve(id, 4, "Montaje");
+    const qint64 racing = reservations.reserve(id, 3, "Montaje");
+    QVERIFY(reservations.commit(queued));
+    
+    // Un commit desde otro hilo mientras se escribe la cantidad absoluta espera a que termine
+    QFuture<bool> concurrent;
+    Component component = db->getComponentById(id);
+    QVERIFY(reservations.writeQuantity(id, 30, [&]() {
+        if (db->getComponentById(id).getQuantity() != 16) {
+            return false;   // El consumo pendiente debía volcarse antes
+        }
+        concurrent = QtConcurrent::run([&reservations, racing]() {
+            return reservations.commit(racing);
+        });
+        component.setQuantity(30);
+        return db->updateComponent(component);
+    }));
+    QVERIFY(concurrent.result());
+    QVERIFY(reservations.flush());
+    QCOMPARE(db->getComponentById(id).getQuantity(), 27);
+    QCOMPARE(reservations.available(id), 27);
+}
+
+QTEST_GUILESS_MAIN(TestReservationManager)
+#include "tst_reservationmanager.moc"
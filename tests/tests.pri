@@ -0,0 +1,20 @@
+######################################################################
+# tests.pri - Configuración común de las pruebas
+######################################################################
+
+QT += core sql testlib
+QT -= gui
+
+CONFIG += c++17 warn_on console testcase
+CONFIG -= app_bundle
+
+TEMPLATE = app
+
+# Las pruebas compilan directamente los fuentes de la aplicación
+SRC_DIR = $$PWD/../src
+INCLUDEPATH += $$SRC_DIR
+
+linux-g++ {
+    QMAKE_CXXFLAGS += -O2 -Wall -Wextra
+    LIBS += -lsqlite3
+}
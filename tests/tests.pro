@@ -0,0 +1,21 @@
+######################################################################
+# tests.pro - Pruebas unitarias y de rendimiento (QtTest)
+#
+# Compilar y ejecutar:  qmake && make check
+# Las pruebas de rendimiento (benchmark*) se omiten salvo con INVENTORY_BENCH=1;
+# INVENTORY_BENCH_ROWS cambia el tamaño de los datos. P. ej.:
+#   INVENTORY_BENCH=1 ./componentsnapshot/tst_componentsnapshot benchmarkOpenAndList
+######################################################################
+
+TEMPLATE = subdirs
+
+SUBDIRS += \
+    changefeed \
+    componentsnapshot \
+    databasemanager \
+    inventorymanager \
+    lowstockaggregator \
+    reorderforecaster \
+    reservationmanager \
+    tracerecorder \
+    trigramindex
@@ -0,0 +1,11 @@
+TARGET = tst_tracerecorder
+include(../tests.pri)
+
+SOURCES += \
+    tst_tracerecorder.cpp \
+    $$SRC_DIR/component.cpp \
+    $$SRC_DIR/tracerecorder.cpp
+
+HEADERS += \
+    $$SRC_DIR/component.h \
+    $$SRC_DIR/tracerecorder.h
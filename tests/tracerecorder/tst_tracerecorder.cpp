@@ -0,0 +1,226 @@
+#include <QtTest>
+#include <QTemporaryDir>
+#include <QThread>
+#include "tracerecorder.h"
+
+class TestTraceRecorder : public QObject {
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void roundTripKeepsStateAndCalls();
+    void nestedCallsRecordedOnce();
+    void concurrentCallsAreComplete();
+    void corruptCountIsRejected();
+    void readsVersion1();
+
+private:
+    static TraceSnapshot sampleState();
+    
+    QTemporaryDir dir;
+};
+
+void TestTraceRecorder::initTestCase() {
+    QVERIFY(dir.isValid());
+}
+
+TraceSnapshot TestTraceRecorder::sampleState() {
+    TraceSnapshot state;
+    state.sites = {"norte", "sur"};
+    state.components.append(Component(1, "Resistencia 10k", "Resistencia", 40, "A1",
+                                      QDate(2024, 1, 10)));
+    Component remote(16777217, "LED rojo", "LED", 5, "B2", QDate(2024, 2, 1));
+    remote.setSite("norte");
+    state.components.append(remote);
+    
+    Reservation reservation;
+    reservation.id = 3;
+    reservation.componentId = 1;
+    reservation.quantity = 7;
+    reservation.project = "Estación meteorológica";
+    reservation.createdAt = QDateTime(QDate(2024, 3, 1), QTime(9, 30), Qt::UTC);
+    state.reservations.append(reservation);
+    
+    Lot lot;
+    lot.id = 11;
+    lot.componentId = 1;
+    lot.received = 50;
+    lot.remaining = 40;
+    lot.purchaseDate = QDate(2024, 1, 10);
+    lot.unitCost = 0.02;
+    state.lots.append(lot);
+    
+    ConsumptionState consumption;
+    consumption.decayedUnits = 12.5;
+    consumption.lastEventMs = 1709280000000;
+    consumption.firstEventMs = 1704067200000;
+    state.consumption.insert(1, consumption);
+    return state;
+}
+
+void TestTraceRecorder::roundTripKeepsStateAndCalls() {
+    const QString path = dir.filePath("roundtrip.trace");
+    TraceRecorder recorder;
+    QVERIFY(recorder.open(path, sampleState()));
+    {
+        TraceRecorder::Call trace(&recorder, TraceOp::Add);
+        trace << QString("Condensador") << QString("Condensador") << 20 << QString("C3")
+              << QDate(2024, 4, 2) << QString() << 2;
+    }
+    {
+        TraceRecorder::Call trace(&recorder, TraceOp::Adjust);
+        trace << 1 << -3 << QString("Prototipo") << QString("norte");
+    }
+    {
+        TraceRecorder::Call trace(&recorder, TraceOp::Reserve);
+        trace << 1 << 4 << QString("Robot") << qint64(4);
+    }
+    {
+        TraceRecorder::Call trace(&recorder, TraceOp::Undo);
+    }
+    QCOMPARE(recorder.recordCount(), qint64(4));
+    recorder.close();
+    
+    TraceSnapshot state;
+    QVector<TraceEvent> events;
+    QString error;
+    QVERIFY2(TraceRecorder::read(path, &state, &events, &error), qPrintable(error));
+    
+    const TraceSnapshot expected = sampleState();
+    QCOMPARE(state.sites, expected.sites);
+    QCOMPARE(state.components.size(), 2);
+    QCOMPARE(state.components[1].getId(), 16777217);
+    QCOMPARE(state.components[1].getSite(), QString("norte"));
+    QCOMPARE(state.components[0].getQuantity(), 40);
+    QCOMPARE(state.reservations.size(), 1);
+    QCOMPARE(state.reservations[0].id, qint64(3));
+    QCOMPARE(state.reservations[0].quantity, 7);
+    QCOMPARE(state.reservations[0].project, expected.reservations[0].project);
+    QCOMPARE(state.reservations[0].createdAt, expected.reservations[0].createdAt);
+    QCOMPARE(state.lots.size(), 1);
+    QCOMPARE(state.lots[0].id, qint64(11));
+    QCOMPARE(state.lots[0].remaining, 40);
+    QCOMPARE(state.lots[0].purchaseDate, QDate(2024, 1, 10));
+    QCOMPARE(state.lots[0].unitCost, 0.02);
+    QCOMPARE(state.consumption.size(), 1);
+    QCOMPARE(state.consumption[1].decayedUnits, 12.5);
+    QCOMPARE(state.consumption[1].firstEventMs, qint64(1704067200000));
+    
+    QCOMPARE(events.size(), 4);
+    QCOMPARE(events[0].op, TraceOp::Add);
+    QCOMPARE(events[0].id, 2);
+    QCOMPARE(events[0].component.getName(), QString("Condensador"));
+    QCOMPARE(events[1].op, TraceOp::Adjust);
+    QCOMPARE(events[1].value, -3);
+    QCOMPARE(events[1].site, QString("norte"));
+    QCOMPARE(events[2].op, TraceOp::Reserve);
+    QCOMPARE(events[2].reservationId, qint64(4));
+    QCOMPARE(events[3].op, TraceOp::Undo);
+    for (int i = 1; i < events.size(); ++i) {
+        QVERIFY(events[i].atUs >= events[i - 1].atUs);
+    }
+}
+
+void TestTraceRecorder::nestedCallsRecordedOnce() {
+    // Una llamada que InventoryManager hace dentro de otra no se graba aparte
+    TraceRecorder recorder;
+    QVERIFY(recorder.open(dir.filePath("nested.trace"), TraceSnapshot()));
+    {
+        TraceRecorder::Call outer(&recorder, TraceOp::Undo);
+        TraceRecorder::Call inner(&recorder, TraceOp::Adjust);
+        inner << 1 << 1 << QString() << QString();
+    }
+    QCOMPARE(recorder.recordCount(), qint64(1));
+}
+
+void TestTraceRecorder::concurrentCallsAreComplete() {
+    const QString path = dir.filePath("threads.trace");
+    const int threadCount = 4;
+    const int callsPerThread = 2000;
+    TraceRecorder recorder;
+    QVERIFY(recorder.open(path, TraceSnapshot()));
+    
+    QVector<QThread*> threads;
+    for (int t = 0; t < threadCount; ++t) {
+        threads.append(QThread::create([&recorder, t]() {
+            for (int i = 0; i < callsPerThread; ++i) {
+                TraceRecorder::Call trace(&recorder, TraceOp::Adjust);
+                trace << t << i << QString("hilo") << QString();
+            }
+        }));
+        threads.last()->start();
+    }
+    for (QThread* thread : threads) {
+        QVERIFY(thread->wait(30000));
+        delete thread;
+    }
+    recorder.close();
+    
+    TraceSnapshot state;
+    QVector<TraceEvent> events;
+    QVERIFY(TraceRecorder::read(path, &state, &events));
+    QCOMPARE(events.size(), threadCount * callsPerThread);
+    
+    // Cada registro llega entero y, dentro de un hilo, en orden
+    QVector<int> next(threadCount, 0);
+    for (const TraceEvent& event : events) {
+        QCOMPARE(event.op, TraceOp::Adjust);
+        QVERIFY(event.id >= 0 && event.id < threadCount);
+        QCOMPARE(event.value, next[event.id]);
+        ++next[event.id];
+        QCOMPARE(event.text, QString("hilo"));
+    }
+}
+
+void TestTraceRecorder::corruptCountIsRejected() {
+    // Un recuento enorme no debe reservar memoria para millones de componentes
+    const QString path = dir.filePath("corrupt.trace");
+    QFile file(path);
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_12);
+    out << quint32(0x494E5654) << quint16(2) << qint64(0) << quint32(0) << quint32(0xFFFFFFF0);
+    file.close();
+    
+    TraceSnapshot state;
+    QVector<TraceEvent> events;
+    QString error;
+    QVERIFY(!TraceRecorder::read(path, &state, &events, &error));
+    QVERIFY(!error.isEmpty());
+    QVERIFY(state.components.isEmpty());
+}
+
+void TestTraceRecorder::readsVersion1() {
+    // Versión 1: solo los componentes de la sede principal en la cabecera
+    const QString path = dir.filePath("v1.trace");
+    QFile file(path);
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_12);
+    out << quint32(0x494E5654) << quint16(1) << qint64(0) << quint32(1)
+        << qint32(5) << QString("Sensor") << QString("Sensor") << qint32(3) << QString("D4")
+        << QDate(2023, 6, 1) << QString();
+    
+    QByteArray payload;
+    QDataStream args(&payload, QIODevice::WriteOnly);
+    args.setVersion(QDataStream::Qt_5_12);
+    args << qint32(5);
+    out << quint8(TraceOp::GetById) << quint32(10) << quint32(2) << payload;
+    file.close();
+    
+    TraceSnapshot state;
+    QVector<TraceEvent> events;
+    QString error;
+    QVERIFY2(TraceRecorder::read(path, &state, &events, &error), qPrintable(error));
+    QCOMPARE(state.components.size(), 1);
+    QCOMPARE(state.components[0].getName(), QString("Sensor"));
+    QVERIFY(state.sites.isEmpty());
+    QVERIFY(state.lots.isEmpty());
+    QCOMPARE(events.size(), 1);
+    QCOMPARE(events[0].op, TraceOp::GetById);
+    QCOMPARE(events[0].id, 5);
+    QVERIFY(events[0].site.isEmpty());
+}
+
+QTEST_GUILESS_MAIN(TestTraceRecorder)
+#include "tst_tracerecorder.moc"
@@ -0,0 +1,14 @@
+TARGET = tst_trigramindex
+include(../tests.pri)
+
+QT += concurrent
+
+SOURCES += \
+    tst_trigramindex.cpp \
+    $$SRC_DIR/component.cpp \
+    $$SRC_DIR/trigramindex.cpp
+
+HEADERS += \
+    ../benchmark.h \
+    $$SRC_DIR/component.h \
+    $$SRC_DIR/trigramindex.h
@@ -0,0 +1,170 @@
+#include <QtTest>
+#include <QElapsedTimer>
+#include <QtConcurrent>
+#include <numeric>
+#include "trigramindex.h"
+#include "../benchmark.h"
+
+class TestTrigramIndex : public QObject {
+    Q_OBJECT
+
+private slots:
+    void findsMisspelledNames();
+    void foldsCaseAndAccents();
+    void ignoresRepeatedSeparators();
+    void removedComponentsAreNotFound();
+    void rareTermsSurviveCandidateCap();
+    void concurrentSearchesAgree();
+    void benchmarkSearch();
+
+private:
+    static QVector<Component> catalog(int count);
+    static Component make(int id, const QString& name, const QString& type,
+                          const QString& location = "Cajón A1");
+};
+
+Component TestTrigramIndex::make(int id, const QString& name, const QString& type,
+                                 const QString& location) {
+    return Component(id, name, type, 1, location, QDate(2024, 1, 1));
+}
+
+QVector<Component> TestTrigramIndex::catalog(int count) {
+    // Vocabulario reducido: muchos trigramas compartidos, como en un inventario real
+    static const char* const families[] = {"Resistencia", "Capacitor cerámico", "Diodo Zener",
+                                           "Transistor MOSFET", "Sensor de temperatura",
+                                           "Microcontrolador", "Regulador lineal", "Conector JST"};
+    static const char* const locations[] = {"Cajón A1", "Cajón B4", "Estante C", "Armario D2"};
+    QVector<Component> components;
+    components.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        const QString family = families[i % 8];
+        components.append(make(i + 1, QString("%1 %2").arg(family).arg(i * 7919 % 100000),
+                               family.section(' ', 0, 0), locations[(i / 8) % 4]));
+    }
+    return components;
+}
+
+void TestTrigramIndex::findsMisspelledNames() {
+    TrigramIndex index;
+    index.build({make(1, "Resistencia 10k", "Resistencia"),
+                 make(2, "Capacitor cerámico 100nF", "Capacitor"),
+                 make(3, "Microcontrolador ATmega328", "Microcontrolador")});
+    
+    const QVector<TrigramIndex::Match> matches = index.search("resistensia");
+    QVERIFY(!matches.isEmpty());
+    QCOMPARE(matches.first().componentId, 1);
+    
+    const QVector<TrigramIndex::Match> typo = index.search("atmega 328");
+    QVERIFY(!typo.isEmpty());
+    QCOMPARE(typo.first().componentId, 3);
+    for (int i = 1; i < typo.size(); ++i) {
+        QVERIFY(typo[i - 1].score >= typo[i].score);
+    }
+}
+
+void TestTrigramIndex::foldsCaseAndAccents() {
+    QCOMPARE(TrigramIndex::trigrams("Resistência CERÁMICA"),
+             TrigramIndex::trigrams("resistencia ceramica"));
+    
+    TrigramIndex index;
+    index.insert(make(7, "Capacitor cerámico", "Capacitor"));
+    const QVector<TrigramIndex::Match> matches = index.search("CERAMICO");
+    QCOMPARE(matches.size(), 1);
+    QCOMPARE(matches.first().componentId, 7);
+}
+
+void TestTrigramIndex::ignoresRepeatedSeparators() {
+    QCOMPARE(TrigramIndex::trigrams("  diodo -- zener  "), TrigramIndex::trigrams("diodo zener"));
+    QVERIFY(TrigramIndex::trigrams(" - ").isEmpty());
+}
+
+void TestTrigramIndex::removedComponentsAreNotFound() {
+    TrigramIndex index;
+    index.build(catalog(4000));
+    
+    // Más de 1024 bajas y de un cuarto de los slots: fuerza la compactación
+    for (int id = 1; id <= 3000; ++id) {
+        index.remove(id);
+    }
+    QCOMPARE(index.size(), 1000);
+    index.update(make(3500, "Zumbador piezoeléctrico", "Zumbador"));
+    
+    const QVector<TrigramIndex::Match> matches = index.search("zumbador piezo");
+    QVERIFY(!matches.isEmpty());
+    QCOMPARE(matches.first().componentId, 3500);
+    for (const TrigramIndex::Match& match : index.search("resistencia", 1000, 0.1f)) {
+        QVERIFY(match.componentId > 3000);
+    }
+}
+
+void TestTrigramIndex::rareTermsSurviveCandidateCap() {
+    // Todos comparten los trigramas comunes: sin el orden por rareza, el tope
+    // de candidatos se llenaría antes de ver el componente buscado
+    const int count = TrigramIndex::kMaxCandidates * 3;
+    QVector<Component> components = catalog(count);
+    components.append(make(count + 1, "Resistencia zafiro", "Resistencia"));
+    
+    TrigramIndex index;
+    index.build(components);
+    const QVector<TrigramIndex::Match> matches = index.search("resistencia zafiro");
+    QVERIFY(!matches.isEmpty());
+    QCOMPARE(matches.first().componentId, count + 1);
+}
+
+void TestTrigramIndex::concurrentSearchesAgree() {
+    TrigramIndex index;
+    index.build(catalog(20000));
+    const QStringList queries = {"resistensia 42", "capacitor ceramco", "mosfet", "cajon b4",
+                                 "sensor temperatura", "regulador", "jst 77", "zener diodo"};
+    
+    QVector<QVector<TrigramIndex::Match>> expected;
+    for (const QString& query : queries) {
+        expected.append(index.search(query));
+    }
+    
+    // Varias búsquedas a la vez sobre el mismo índice deben dar lo mismo que en serie
+    QVector<int> rounds(64);
+    std::iota(rounds.begin(), rounds.end(), 0);
+    QAtomicInt mismatches(0);
+    QtConcurrent::blockingMap(rounds, [&](int& round) {
+        const int q = round % queries.size();
+        const QVector<TrigramIndex::Match> matches = index.search(queries[q]);
+        bool same = matches.size() == expected[q].size();
+        for (int i = 0; same && i < matches.size(); ++i) {
+            same = matches[i].componentId == expected[q][i].componentId;
+        }
+        if (!same) {
+            mismatches.fetchAndAddRelaxed(1);
+        }
+    });
+    QCOMPARE(mismatches.loadAcquire(), 0);
+}
+
+void TestTrigramIndex::benchmarkSearch() {
+    // Objetivo: < 10 ms por búsqueda con un millón de componentes
+    BENCHMARK_ONLY();
+    const int rows = benchmarkRows(1000000);
+    TrigramIndex index;
+    QElapsedTimer timer;
+    timer.start();
+    index.build(catalog(rows));
+    qDebug() << rows << "componentes indexados en" << timer.elapsed() << "ms";
+    
+    const QStringList queries = {"resistensia 4711", "capacitor ceramco", "sensr temperatura",
+                                 "cajon b4"};
+    for (const QString& query : queries) {
+        timer.start();
+        const int runs = 20;
+        for (int i = 0; i < runs; ++i) {
+            index.search(query);
+        }
+        qDebug() << query << ":" << double(timer.nsecsElapsed()) / runs / 1e6 << "ms por búsqueda";
+    }
+    
+    QBENCHMARK {
+        index.search("resistensia 4711");
+    }
+}
+
+QTEST_GUILESS_MAIN(TestTrigramIndex)
+#include "tst_trigramindex.moc"